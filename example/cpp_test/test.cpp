@@ -146,6 +146,24 @@ int main(int argc,char **argv){
    phiprof::print(MPI_COMM_WORLD);
    if(rank==0)   
       cout<< "Print time is "<<MPI_Wtime()-t1<<endl;
+
+   //timers are unchanged, so later prints reuse the print communicators
+   const int nPrints=10;
+   MPI_Barrier(MPI_COMM_WORLD);
+   t1=MPI_Wtime();
+   for(int i=0;i<nPrints;i++)
+      phiprof::print(MPI_COMM_WORLD);
+   if(rank==0)   
+      cout<< "Repeated print time is "<<(MPI_Wtime()-t1)/nPrints<<endl;
 //   phiprof::print(MPI_COMM_WORLD,0.1);
+
+   //print on a subset of the processes, the others do not take part
+   MPI_Comm halfComm;
+   MPI_Comm_split(MPI_COMM_WORLD, rank % 2, rank, &halfComm);
+   if(rank % 2 == 0)
+      phiprof::print(halfComm, "profile_even");
+   MPI_Comm_free(&halfComm);
+   phiprof::print(MPI_COMM_WORLD);
+   phiprof::finalize();
    MPI_Finalize();
 }
@@ -0,0 +1,796 @@
+/*
+  This file is part of the phiprof library
+
+  Copyright 2011, 2012 Finnish Meteorological Institute
+
+  Phiprof is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/*
+  Deterministic checks of phiprof. Run with any number of processes,
+  e.g. mpirun -np 2 ./unit_test. The exit status is 0 if all checks
+  pass.
+*/
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <filesystem>
+#include "mpi.h"
+#include "phiprof.hpp"
+#include "chunkedvector.hpp"
+#include "quantilesketch.hpp"
+#include "timerdump.hpp"
+#include "timerreport.hpp"
+#include "timerdiff.hpp"
+#include "rundatabase.hpp"
+#include "communicationmatrix.hpp"
+
+using namespace std;
+
+int nChecks = 0;
+int nFailed = 0;
+
+void check(bool condition, const string &name){
+   nChecks++;
+   if(!condition){
+      nFailed++;
+      cerr << "FAILED: " << name << endl;
+   }
+}
+
+bool isClose(double a, double b, double tolerance){
+   return fabs(a - b) <= tolerance;
+}
+
+/*timer of a synthetic dump with the same time on all threads*/
+struct SyntheticTimer {
+   int parent; //index in the dictionary, -1 for the root
+   string label;
+   double time;
+   vector<string> groups = {"Group"};
+};
+
+/*Write a dump with the same timers on all ranks, rank r on node r/2.
+  The exclusive time is the time not spent in the children, and the
+  times of rank r are multiplied by 1 + rankSkew * r. Returns the
+  dictionary index of each timer.*/
+vector<int> writeDump(const string &fileName, const vector<SyntheticTimer> &timers, int nRanks, double rankSkew = 0.0){
+   TimerDictionary dictionary;
+   vector<int> indices;
+   for(auto &timer: timers)
+      indices.push_back(dictionary.add(timer.parent, timer.label, timer.groups, ""));
+
+   vector<char> dictionaryBuffer;
+   dictionary.serialize(dictionaryBuffer);
+   TimerDump::Header header;
+   TimerDump::setHeader(header, nRanks, dictionaryBuffer.size());
+
+   vector<TimerDump::Record> records;
+   for(int rank = 0; rank < nRanks; rank++){
+      for(unsigned int t = 0; t < timers.size(); t++){
+         TimerDump::Record record;
+         memset(&record, 0, sizeof(record));
+         record.index = indices[t];
+         record.threads = 1;
+         record.count = t + 1;
+         record.time = record.timeMax = record.timeMin = timers[t].time * (1.0 + rankSkew * rank);
+         double exclusiveTime = timers[t].time;
+         for(auto &child: timers){
+            if(child.parent == indices[t])
+               exclusiveTime -= child.time;
+         }
+         record.exclusiveTime = record.exclusiveTimeMax = record.exclusiveTimeMin = exclusiveTime * (1.0 + rankSkew * rank);
+         records.push_back(record);
+      }
+   }
+
+   int64_t offset = sizeof(header) + dictionaryBuffer.size() + nRanks * sizeof(TimerDump::RankEntry);
+   ofstream output(fileName, ofstream::binary);
+   output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   output.write(dictionaryBuffer.data(), dictionaryBuffer.size());
+   for(int rank = 0; rank < nRanks; rank++){
+      TimerDump::RankEntry entry;
+      entry.offset = offset;
+      entry.nRecords = timers.size();
+      entry.node = rank / 2 * 2;
+      output.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+      offset += timers.size() * sizeof(TimerDump::Record);
+   }
+   output.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TimerDump::Record));
+   return indices;
+}
+
+template <typename T>
+T readValue(const string &fileName, int64_t offset){
+   T value = 0;
+   ifstream input(fileName, ifstream::binary);
+   input.seekg(offset);
+   input.read(reinterpret_cast<char*>(&value), sizeof(value));
+   return value;
+}
+
+/*overwrite a 4 or 8 byte integer in a file*/
+void writeValue(const string &fileName, int64_t offset, int64_t value, int bytes){
+   fstream file(fileName, fstream::binary | fstream::in | fstream::out);
+   file.seekp(offset);
+   if(bytes == 4){
+      const int32_t value32 = value;
+      file.write(reinterpret_cast<const char*>(&value32), sizeof(value32));
+   }
+   else {
+      file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+   }
+}
+
+bool readReport(const string &fileName, TimerReport &report){
+   TimerDump dump;
+   if(!dump.read(fileName))
+      return false;
+   report.collect(dump, vector<bool>(dump.getNumRanks(), true));
+   return true;
+}
+
+/*Dump of the library, collective over MPI_COMM_WORLD*/
+void testTimerDump(int rank, int nRanks){
+   const int nIterations = 10;
+   phiprof::start("dump");
+   for(int i = 0; i < nIterations; i++){
+      phiprof::start("iteration");
+      phiprof::stop("iteration");
+   }
+   phiprof::stop("dump");
+   const bool written = phiprof::dump(MPI_COMM_WORLD, "unit_test.dump");
+   if(rank != 0)
+      return;
+   check(written, "phiprof::dump");
+   TimerDump dump;
+   check(dump.read("unit_test.dump"), "TimerDump read");
+   check(dump.getNumRanks() == nRanks, "TimerDump ranks of phiprof::dump");
+   const TimerDictionary &dictionary = dump.getDictionary();
+   const int index = dictionary.find(dictionary.find(0, "dump"), "iteration");
+   check(index > 0, "TimerDump timer of phiprof::dump");
+   for(int r = 0; r < dump.getNumRanks(); r++){
+      bool found = false;
+      for(auto &record: dump.getRecords(r)){
+         if(record.index == index){
+            found = true;
+            check(record.count == nIterations, "TimerDump count of rank " + to_string(r));
+            check(record.time >= 0.0 && record.timeMin <= record.timeMax, "TimerDump times of rank " + to_string(r));
+         }
+      }
+      check(found, "TimerDump record of rank " + to_string(r));
+   }
+
+   //not a dump
+   ofstream("unit_test_invalid.dump") << "not a dump";
+   check(!dump.read("unit_test_invalid.dump"), "TimerDump rejects invalid files");
+}
+
+void testTimerDumpSynthetic(){
+   const int nRanks = 3;
+   vector<SyntheticTimer> timers = {{-1, "total", 10.0}, {0, "solve", 4.0}, {1, "halo", 1.5}, {0, "io", 2.0}};
+   vector<int> indices = writeDump("unit_test_synthetic.dump", timers, nRanks);
+   TimerDump dump;
+   check(dump.read("unit_test_synthetic.dump"), "TimerDump read synthetic");
+   check(dump.getNumRanks() == nRanks, "TimerDump ranks");
+   check(dump.getDictionary().size() == timers.size(), "TimerDump dictionary size");
+   check(dump.getDictionary().findFullLabel("/solve/halo") == indices[2], "TimerDump full label");
+   bool recordsMatch = true;
+   for(int rank = 0; rank < min(nRanks, dump.getNumRanks()); rank++){
+      check(dump.getNode(rank) == rank / 2 * 2, "TimerDump node of rank " + to_string(rank));
+      const vector<TimerDump::Record> &records = dump.getRecords(rank);
+      recordsMatch = recordsMatch && records.size() == timers.size();
+      for(unsigned int t = 0; t < min(records.size(), timers.size()); t++){
+         recordsMatch = recordsMatch && records[t].index == indices[t] && records[t].count == t + 1 &&
+            records[t].time == timers[t].time && records[t].timeMax == timers[t].time;
+      }
+   }
+   check(recordsMatch, "TimerDump records");
+
+   //corrupted sizes are rejected before anything is allocated
+   const int64_t dictionaryBytes = offsetof(TimerDump::Header, dictionaryBytes);
+   const int64_t rankEntries = sizeof(TimerDump::Header) + readValue<int64_t>("unit_test_synthetic.dump", dictionaryBytes);
+   //entries, parent, label and workunit label of the root come before its groups
+   const int64_t rootGroups = sizeof(TimerDump::Header) + 4 * sizeof(int32_t) + strlen("total");
+   const struct {
+      int64_t offset;
+      int64_t value;
+      int bytes;
+      const char *name;
+   } corruptions[] = {
+      {dictionaryBytes, (int64_t)1 << 40, 8, "dictionary size"},
+      {offsetof(TimerDump::Header, nRanks), 1 << 30, 4, "number of ranks"},
+      {rankEntries + 8, -5, 4, "number of records"},
+      {rankEntries + 8, 1 << 30, 4, "number of records beyond the file"},
+      {rankEntries, (int64_t)1 << 40, 8, "offset of records"},
+      {rootGroups, 1 << 30, 4, "number of groups"}};
+   for(auto &corruption: corruptions){
+      writeDump("unit_test_corrupt.dump", timers, nRanks);
+      writeValue("unit_test_corrupt.dump", corruption.offset, corruption.value, corruption.bytes);
+      check(!dump.read("unit_test_corrupt.dump"), string("TimerDump rejects corrupted ") + corruption.name);
+   }
+}
+
+/*Write a communication matrix as phiprof::print does, one entry per timer*/
+void writeCommunicationMatrix(const string &fileName, const vector<string> &labels,
+                              const vector<CommunicationMatrix::Entry> &entries){
+   vector<char> labelBuffer;
+   CommunicationMatrix::serializeLabels(labels, labelBuffer);
+   CommunicationMatrix::Header header;
+   CommunicationMatrix::setHeader(header, labels.size(), labelBuffer.size(), entries.size());
+   ofstream output(fileName, ofstream::binary);
+   output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   output.write(labelBuffer.data(), labelBuffer.size());
+   output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(CommunicationMatrix::Entry));
+}
+
+void testCommunicationMatrix(){
+   const vector<string> labels = {"/solve/halo", ""};
+   const vector<CommunicationMatrix::Entry> entries = {{0, 0, 1, 0, 10, 800.0}, {0, 1, 0, 0, 10, 800.0}, {1, 2, 3, 0, 1, 8.0}};
+   writeCommunicationMatrix("unit_test.comm", labels, entries);
+   CommunicationMatrix matrix;
+   check(matrix.read("unit_test.comm"), "CommunicationMatrix read");
+   check(matrix.getLabels() == labels, "CommunicationMatrix labels");
+   bool entriesMatch = matrix.getEntries().size() == entries.size();
+   for(unsigned int e = 0; entriesMatch && e < entries.size(); e++){
+      const CommunicationMatrix::Entry &entry = matrix.getEntries()[e];
+      entriesMatch = entry.timer == entries[e].timer && entry.source == entries[e].source &&
+         entry.destination == entries[e].destination && entry.count == entries[e].count && entry.bytes == entries[e].bytes;
+   }
+   check(entriesMatch, "CommunicationMatrix entries");
+
+   //corrupted sizes are rejected before anything is allocated
+   const struct {
+      int64_t offset;
+      int64_t value;
+      int bytes;
+      const char *name;
+   } corruptions[] = {
+      {offsetof(CommunicationMatrix::Header, nTimers), 1 << 30, 4, "number of timers"},
+      {offsetof(CommunicationMatrix::Header, labelBytes), (int64_t)1 << 40, 8, "label size"},
+      {offsetof(CommunicationMatrix::Header, nEntries), (int64_t)1 << 40, 8, "number of entries"},
+      {sizeof(CommunicationMatrix::Header), 1 << 30, 4, "label length"}};
+   for(auto &corruption: corruptions){
+      writeCommunicationMatrix("unit_test_corrupt.comm", labels, entries);
+      writeValue("unit_test_corrupt.comm", corruption.offset, corruption.value, corruption.bytes);
+      check(!matrix.read("unit_test_corrupt.comm"), string("CommunicationMatrix rejects corrupted ") + corruption.name);
+   }
+}
+
+/*Messages of the communication matrix printed by phiprof::print, each
+  rank sends one message to the next one in the timer exchange.
+  Collective over MPI_COMM_WORLD.*/
+void testCommunicationMatrixPrint(int rank, int nRanks){
+   vector<double> sendBuffer(100, rank), receiveBuffer(100);
+   phiprof::start("exchange");
+   MPI_Sendrecv(sendBuffer.data(), 100, MPI_DOUBLE, (rank + 1) % nRanks, 0,
+                receiveBuffer.data(), 100, MPI_DOUBLE, (rank + nRanks - 1) % nRanks, 0,
+                MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+   phiprof::stop("exchange");
+   setenv("PHIPROF_PRINTS", "comm-matrix", 1);
+   const bool printed = phiprof::print(MPI_COMM_WORLD, "unit_test_comm");
+   unsetenv("PHIPROF_PRINTS");
+   if(rank != 0)
+      return;
+   check(printed, "phiprof::print comm-matrix");
+   CommunicationMatrix matrix;
+   check(matrix.read("unit_test_comm_0.comm"), "CommunicationMatrix read print");
+   const vector<string> &labels = matrix.getLabels();
+   const int timer = find(labels.begin(), labels.end(), "/exchange") - labels.begin();
+   vector<int> destinations(nRanks, -1);
+   bool messagesMatch = timer < (int)labels.size();
+   for(auto &entry: matrix.getEntries()){
+      if(entry.timer != timer)
+         continue;
+      messagesMatch = messagesMatch && entry.source >= 0 && entry.source < nRanks && destinations[entry.source] == -1 &&
+         entry.count == 1 && entry.bytes == 100 * sizeof(double);
+      if(messagesMatch)
+         destinations[entry.source] = entry.destination;
+   }
+   for(int r = 0; r < nRanks; r++)
+      messagesMatch = messagesMatch && destinations[r] == (r + 1) % nRanks;
+   check(messagesMatch, "CommunicationMatrix messages of print");
+}
+
+/*Fields of the timer rows of a csv report by full label, empty if the
+  file does not exist*/
+map<string, map<string, string>> readCsv(const string &fileName){
+   map<string, map<string, string>> rows;
+   ifstream input(fileName);
+   vector<string> header;
+   string line;
+   while(getline(input, line)){
+      vector<string> fields(1);
+      bool quoted = false;
+      for(unsigned int c = 0; c < line.size(); c++){
+         if(line[c] == '"' && quoted && c + 1 < line.size() && line[c + 1] == '"')
+            fields.back() += line[++c];
+         else if(line[c] == '"')
+            quoted = !quoted;
+         else if(line[c] == ',' && !quoted)
+            fields.emplace_back();
+         else
+            fields.back() += line[c];
+      }
+      if(header.empty()) {
+         header = fields;
+         continue;
+      }
+      map<string, string> row;
+      for(unsigned int f = 0; f < min(fields.size(), header.size()); f++)
+         row[header[f]] = fields[f];
+      if(row["type"] == "timer")
+         rows[row["full_label"]] = row;
+   }
+   return rows;
+}
+
+/*Statistics reduced within nodes and then over node leaders. All
+  ranks make the same MPI calls, which the MPI wrappers add as timers.
+  Collective over MPI_COMM_WORLD.*/
+void testNodeReduction(int rank, int nRanks){
+   MPI_Comm nodeComm;
+   int nodeRank, nNodes;
+   MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+   MPI_Comm_rank(nodeComm, &nodeRank);
+   MPI_Comm_free(&nodeComm);
+   int isLeader = nodeRank == 0;
+   MPI_Allreduce(&isLeader, &nNodes, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+
+   //the timer is stopped rank + 1 times on each rank
+   for(int i = 0; i <= rank; i++){
+      phiprof::start("node");
+      phiprof::stop("node");
+   }
+   setenv("PHIPROF_PRINTS", "csv", 1);
+   const bool printed = phiprof::print(MPI_COMM_WORLD, "unit_test_node");
+   unsetenv("PHIPROF_PRINTS");
+   if(rank != 0)
+      return;
+   check(printed, "phiprof::print node reduction");
+   map<string, map<string, string>> rows = readCsv("unit_test_node_0.csv");
+   check(rows["/node"]["ranks"] == to_string(nRanks) && rows["/node"]["nodes"] == to_string(nNodes) &&
+         rows["/node"]["count_sum"] == to_string(nRanks * (nRanks + 1) / 2),
+         "csv ranks, nodes and count of the node reduction");
+}
+
+/*Reports of each phase and of the time since the previous print.
+  Collective over MPI_COMM_WORLD.*/
+void testPhases(int rank, int nRanks){
+   auto stopTimes = [](int n){
+      for(int i = 0; i < n; i++){
+         phiprof::start("phased");
+         phiprof::stop("phased");
+      }
+   };
+   setenv("PHIPROF_PRINTS", "csv", 1);
+   setenv("PHIPROF_PRINT_DELTA", "1", 1);
+   phiprof::setPhase("init");
+   stopTimes(1);
+   phiprof::setPhase("steady");
+   stopTimes(3);
+   //counts of the whole run, init, steady and since the previous print
+   const int counts[2][4] = {{4, 1, 3, 4}, {6, 1, 5, 2}};
+   for(int p = 0; p < 2; p++){
+      if(p == 1)
+         stopTimes(2);
+      const bool printed = phiprof::print(MPI_COMM_WORLD, "unit_test_phase");
+      if(rank != 0)
+         continue;
+      const char *files[4] = {"unit_test_phase_0.csv", "unit_test_phase_init_0.csv",
+                              "unit_test_phase_steady_0.csv", "unit_test_phase_delta_0.csv"};
+      bool countsMatch = printed;
+      for(int f = 0; f < 4; f++)
+         countsMatch = countsMatch && readCsv(files[f])["/phased"]["count_sum"] == to_string(counts[p][f] * nRanks);
+      check(countsMatch, "csv counts of the phases and deltas of print " + to_string(p + 1));
+   }
+   unsetenv("PHIPROF_PRINT_DELTA");
+   unsetenv("PHIPROF_PRINTS");
+}
+
+/*Repeated prints reuse the print communicator until a timer is added
+  on some processes, which then get a report of their own. Collective
+  over MPI_COMM_WORLD.*/
+void testPrintCache(int rank, int nRanks){
+   setenv("PHIPROF_PRINTS", "csv", 1);
+   for(int p = 1; p <= 2; p++){
+      phiprof::start("cache");
+      phiprof::stop("cache");
+      const bool printed = phiprof::print(MPI_COMM_WORLD, "unit_test_cache");
+      if(rank == 0)
+         check(printed && readCsv("unit_test_cache_0.csv")["/cache"]["count_sum"] == to_string(p * nRanks),
+               "csv count of print " + to_string(p) + " with the same timers");
+   }
+   if(nRanks > 1) {
+      if(rank % 2 == 1) {
+         phiprof::start("cache_odd");
+         phiprof::stop("cache_odd");
+      }
+      if(rank == 0) {
+         remove("unit_test_cache_0.csv");
+         remove("unit_test_cache_1.csv");
+      }
+      const bool printed = phiprof::print(MPI_COMM_WORLD, "unit_test_cache");
+      if(rank == 0) {
+         map<string, map<string, string>> even = readCsv("unit_test_cache_0.csv");
+         map<string, map<string, string>> odd = readCsv("unit_test_cache_1.csv");
+         if(even.count("/cache_odd"))
+            swap(even, odd);
+         check(printed && even["/cache"]["ranks"] == to_string((nRanks + 1) / 2) &&
+               even["/cache"]["count_sum"] == to_string(2 * ((nRanks + 1) / 2)) && even.count("/cache_odd") == 0 &&
+               odd["/cache_odd"]["ranks"] == to_string(nRanks / 2),
+               "csv reports after a timer was added on odd ranks");
+      }
+   }
+   unsetenv("PHIPROF_PRINTS");
+}
+
+/*Even and odd ranks have different timers, merged into one report.
+  Collective over MPI_COMM_WORLD.*/
+void testMergePrint(int rank, int nRanks){
+   phiprof::start(rank % 2 == 0 ? "merge_even" : "merge_odd");
+   phiprof::stop(rank % 2 == 0 ? "merge_even" : "merge_odd");
+   if(rank == 0)
+      remove("unit_test_merge_1.csv");
+   setenv("PHIPROF_PRINTS", "csv", 1);
+   setenv("PHIPROF_MERGE", "1", 1);
+   const bool printed = phiprof::print(MPI_COMM_WORLD, "unit_test_merge");
+   unsetenv("PHIPROF_MERGE");
+   unsetenv("PHIPROF_PRINTS");
+   if(rank != 0)
+      return;
+   check(printed, "phiprof::print merged");
+   map<string, map<string, string>> rows = readCsv("unit_test_merge_0.csv");
+   check(rows[""]["ranks"] == to_string(nRanks) && rows["/merge_even"]["ranks"] == to_string((nRanks + 1) / 2) &&
+         rows["/merge_even"]["count_sum"] == to_string((nRanks + 1) / 2) &&
+         (nRanks == 1 || rows["/merge_odd"]["ranks"] == to_string(nRanks / 2)),
+         "csv ranks of the merged timers");
+   check(!ifstream("unit_test_merge_1.csv").good(), "merged report in one file");
+}
+
+/*report settings from the environment fall back to the default unless positive*/
+void testReportSettings(){
+   setenv("PHIPROF_SELF_TIMERS", "0", 1);
+   check(TimerReport::getSelfTimers() == 20, "PHIPROF_SELF_TIMERS=0 uses the default");
+   setenv("PHIPROF_SELF_TIMERS", "5", 1);
+   check(TimerReport::getSelfTimers() == 5, "PHIPROF_SELF_TIMERS");
+   unsetenv("PHIPROF_SELF_TIMERS");
+   setenv("PHIPROF_IMBALANCE_TIMERS", "-1", 1);
+   check(TimerReport::getImbalanceTimers() == 20, "PHIPROF_IMBALANCE_TIMERS=-1 uses the default");
+   unsetenv("PHIPROF_IMBALANCE_TIMERS");
+}
+
+string printStyle(const TimerReport &report, const string &style){
+   stringstream output;
+   check(report.print(style, output), "print " + style);
+   return output.str();
+}
+
+bool contains(const string &text, const string &line){
+   return text.find(line) != string::npos;
+}
+
+/*check the version and the layout of an NPY file, and that the data starts with firstValues*/
+bool checkNpy(const string &npy, int version, const vector<float> &firstValues){
+   const size_t prefix = version == 1 ? 10 : 12;
+   if(npy.size() < prefix || npy.compare(0, 6, "\x93NUMPY") != 0 || npy[6] != version)
+      return false;
+   size_t headerLength = 0;
+   for(size_t b = prefix - 1; b >= 8; b--)
+      headerLength = headerLength * 256 + (unsigned char)npy[b];
+   const size_t dataOffset = prefix + headerLength;
+   if(dataOffset % 64 != 0 || npy.size() < dataOffset + firstValues.size() * sizeof(float) ||
+      npy[dataOffset - 1] != '\n' || npy.compare(prefix, 10, "{'descr': ") != 0)
+      return false;
+   return memcmp(npy.data() + dataOffset, firstValues.data(), firstValues.size() * sizeof(float)) == 0;
+}
+
+/*Cells of the first row of a table whose second cell is name*/
+vector<string> findTableRow(const string &text, const string &name){
+   stringstream lines(text);
+   string line;
+   while(getline(lines, line)){
+      vector<string> cells;
+      stringstream cellStream(line);
+      string cell;
+      getline(cellStream, cell, '|');
+      while(getline(cellStream, cell, '|')){
+         const size_t first = cell.find_first_not_of(' ');
+         cells.push_back(first == string::npos ? "" : cell.substr(first, cell.find_last_not_of(' ') - first + 1));
+      }
+      if(cells.size() > 1 && cells[1] == name) {
+         cells.pop_back(); //after the last separator
+         return cells;
+      }
+   }
+   return vector<string>();
+}
+
+/*print styles of a dump where rank r is 1 + r/2 times slower than rank 0*/
+void testReportStyles(){
+   const int nRanks = 4;
+   vector<SyntheticTimer> timers = {{-1, "total", 10.0}, {0, "solve", 4.0}, {1, "halo", 1.5}, {0, "io", 2.0}};
+   writeDump("unit_test_styles.dump", timers, nRanks, 0.5);
+   TimerDump dump;
+   TimerReport report;
+   check(dump.read("unit_test_styles.dump"), "TimerDump read styles");
+   report.collect(dump, vector<bool>(nRanks, true));
+   report.collectSlowestTimes(dump);
+
+   //exclusive time in microseconds, 1.75 times rank 0 on average and
+   //2.5 times on the slowest rank 3
+   const string flame = printStyle(report, "flame");
+   check(contains(flame, "total 7000000\n") && contains(flame, "total;solve 4375000\n") &&
+         contains(flame, "total;solve;halo 2625000\n") && contains(flame, "total;io 3500000\n"),
+         "flame stacks of the average process");
+   const string flameMax = printStyle(report, "flame-max");
+   check(contains(flameMax, "total 10000000\n") && contains(flameMax, "total;solve 6250000\n") &&
+         contains(flameMax, "total;solve;halo 3750000\n") && contains(flameMax, "total;io 5000000\n"),
+         "flame-max stacks of the slowest process");
+
+   //the imbalance cost is 3 times the time of rank 0, the ranking has
+   //the full labels of the timers
+   stringstream imbalance;
+   check(report.print("imbalance", imbalance, 0.3), "print imbalance");
+   check(contains(imbalance.str(), "/solve ") && contains(imbalance.str(), "/Other ") && contains(imbalance.str(), "| 12 ") &&
+         !contains(imbalance.str(), "/io ") && !contains(imbalance.str(), "/solve/halo "),
+         "imbalance ranking of timers with at least the minimum fraction");
+   setenv("PHIPROF_IMBALANCE_TIMERS", "1", 1);
+   const string imbalanceOne = printStyle(report, "imbalance");
+   unsetenv("PHIPROF_IMBALANCE_TIMERS");
+   check(contains(imbalanceOne, "/solve ") && !contains(imbalanceOne, "/Other ") && !contains(imbalanceOne, "/io "),
+         "imbalance ranking of PHIPROF_IMBALANCE_TIMERS timers");
+
+   //columns are the rank and the timers in decreasing order of time
+   report.collectRankTimes(dump, vector<bool>(nRanks, true));
+   const string heatmap = printStyle(report, "heatmap");
+   check(checkNpy(heatmap, 1, {0.0f, 10.0f, 4.0f, 2.0f, 1.5f, 1.0f, 15.0f}), "heatmap NPY 1.0");
+
+   //the header of the labels no longer fits in 64 kB
+   vector<SyntheticTimer> longTimers = {{-1, "total", 100.0}};
+   for(int t = 0; t < 40; t++)
+      longTimers.push_back({0, string(2000, 'a' + t % 26) + to_string(t), 1.0});
+   writeDump("unit_test_long.dump", longTimers, 2);
+   TimerDump longDump;
+   TimerReport longReport;
+   check(longDump.read("unit_test_long.dump"), "TimerDump read long labels");
+   longReport.collect(longDump, vector<bool>(2, true));
+   setenv("PHIPROF_HEATMAP_TIMERS", "64", 1);
+   longReport.collectRankTimes(longDump, vector<bool>(2, true));
+   unsetenv("PHIPROF_HEATMAP_TIMERS");
+   check(checkNpy(printStyle(longReport, "heatmap"), 2, {0.0f, 100.0f, 1.0f}), "heatmap NPY 2.0");
+
+   //interp is called from solve and io, flat aggregates it by label
+   writeDump("unit_test_flat.dump", {{-1, "total", 10.0}, {0, "solve", 4.0}, {1, "interp", 1.5},
+                                     {0, "io", 2.0}, {3, "interp", 0.5}}, 2);
+   TimerReport flat;
+   check(readReport("unit_test_flat.dump", flat), "TimerDump read flat");
+   const string flatText = printStyle(flat, "flat");
+   check(findTableRow(flatText, "interp") == vector<string>({"A", "interp", "2", "8", "2", "20", "2", "20", ""}) &&
+         findTableRow(flatText, "called from solve") == vector<string>({"", "called from solve", "", "", "1.5", "15", "", "", ""}) &&
+         findTableRow(flatText, "called from io") == vector<string>({"", "called from io", "", "", "0.5", "5", "", "", ""}) &&
+         findTableRow(flatText, "solve") == vector<string>({"A", "solve", "1", "2", "4", "40", "2.5", "25", ""}),
+         "flat profile of a label with two callers");
+
+   //labels and groups with quotes and separators
+   writeDump("unit_test_quoted.dump", {{-1, "total", 10.0}, {0, "say \"hi\", bye", 4.0, {"A\"B", "C"}}}, 2);
+   TimerReport quoted;
+   check(readReport("unit_test_quoted.dump", quoted), "TimerDump read quoted");
+   const string csv = printStyle(quoted, "csv");
+   check(contains(csv, "timer,1,0,1,0,1,\"say \"\"hi\"\", bye\",\"/say \"\"hi\"\", bye\",\"A\"\"B;C\",2,8,4,4,0,4,0,"),
+         "csv timer row");
+   const string json = printStyle(quoted, "json");
+   check(contains(json, "\"processes\": 2") &&
+         contains(json, "\"label\": \"say \\\"hi\\\", bye\", \"fullLabel\": \"/say \\\"hi\\\", bye\", \"groups\": [\"A\\\"B\", \"C\"], \"ranks\": 2"),
+         "json timer");
+
+   //ranks 0 and 1 are closer to each other than to ranks 2 and 3
+   setenv("PHIPROF_CLUSTERS", "2", 1);
+   report.collectClusters(dump, vector<bool>(nRanks, true));
+   unsetenv("PHIPROF_CLUSTERS");
+   const TimerReport::ClusterStatistics &clusters = report.clusterStats;
+   const int nRows = report.stats.id.size();
+   check(clusters.size == vector<int>({2, 2}) && clusters.representative == vector<int>({2, 0}) &&
+         clusters.timeSum.size() == 2 * nRows && clusters.timeSum[0] == 45.0 && clusters.timeSum[nRows] == 25.0,
+         "clusters of the dump");
+   check(contains(printStyle(report, "clusters"), "Representative rank"), "clusters table");
+}
+
+const TimerDiff::Entry* findEntry(const TimerDiff &diff, const string &fullLabel){
+   for(auto &entry: diff.getEntries()){
+      if(entry.fullLabel == fullLabel)
+         return &entry;
+   }
+   return NULL;
+}
+
+void testTimerDiff(){
+   //solve grows 5%, io 25%, tiny 400% of a very short time, zero from 0
+   writeDump("unit_test_base.dump",
+             {{-1, "total", 10.0}, {0, "solve", 1.0}, {0, "io", 2.0}, {0, "tiny", 0.0001},
+              {0, "stable", 3.0}, {0, "zero", 0.0}}, 2);
+   writeDump("unit_test_other.dump",
+             {{-1, "total", 10.0}, {0, "solve", 1.05}, {0, "io", 2.5}, {0, "tiny", 0.0005},
+              {0, "stable", 3.0}, {0, "zero", 0.002}, {0, "new", 1.0}}, 2);
+   TimerReport base, other;
+   check(readReport("unit_test_base.dump", base) && readReport("unit_test_other.dump", other),
+         "TimerDiff read reports");
+
+   const char *labels[] = {"/solve", "/io", "/tiny", "/stable", "/zero", "/new"};
+   const bool regressedBoth[] = {false, true, false, false, true, false};
+   const bool regressedEither[] = {true, true, true, false, true, false};
+   TimerDiff both(0.001, 0.1, true);
+   TimerDiff either(0.001, 0.1, false);
+   both.compare(base, other);
+   either.compare(base, other);
+   for(int t = 0; t < 6; t++){
+      const TimerDiff::Entry *entryBoth = findEntry(both, labels[t]);
+      const TimerDiff::Entry *entryEither = findEntry(either, labels[t]);
+      check(entryBoth != NULL && entryEither != NULL, string("TimerDiff entry ") + labels[t]);
+      if(entryBoth != NULL && entryEither != NULL){
+         check(entryBoth->regressed == regressedBoth[t], string("TimerDiff both thresholds ") + labels[t]);
+         check(entryEither->regressed == regressedEither[t], string("TimerDiff either threshold ") + labels[t]);
+      }
+   }
+   const TimerDiff::Entry *entry = findEntry(both, "/new");
+   check(entry != NULL && !entry->inBase && entry->inOther, "TimerDiff new timer");
+   entry = findEntry(both, "/io");
+   check(entry != NULL && isClose(entry->baseAverage, 2.0, 1e-12) && isClose(entry->average, 2.5, 1e-12),
+         "TimerDiff averages");
+   check(both.hasRegressions(), "TimerDiff has regressions");
+
+   TimerDiff same;
+   same.compare(base, base);
+   check(!same.hasRegressions(), "TimerDiff no regressions against itself");
+}
+
+void testRunDatabase(){
+   const string directory = "unit_test.db";
+   std::filesystem::remove_all(directory);
+   //labels with newlines and backslashes are escaped in labels.txt
+   const string oddLabel = "odd\\label\nwith newline";
+   writeDump("unit_test_run1.dump", {{-1, "total", 10.0}, {0, "solve", 1.0}, {1, oddLabel, 0.5}}, 2);
+   writeDump("unit_test_run2.dump", {{-1, "total", 12.0}, {0, "solve", 2.0}, {0, "io", 4.0}}, 2);
+   TimerReport report1, report2;
+   check(readReport("unit_test_run1.dump", report1) && readReport("unit_test_run2.dump", report2),
+         "RunDatabase read reports");
+
+   RunDatabase::Run run;
+   run.time = 1000;
+   run.nRanks = 2;
+   run.nThreads = 1;
+   run.gitHash = "abc123";
+   run.input = "case one";
+   {
+      RunDatabase database;
+      check(database.open(directory), "RunDatabase open new");
+      check(database.addRun(run, report1), "RunDatabase add first run");
+      run.time = 2000;
+      run.input = "case two";
+      check(database.addRun(run, report2), "RunDatabase add second run");
+   }
+
+   RunDatabase database;
+   check(database.open(directory), "RunDatabase reopen");
+   const vector<RunDatabase::Run> &runs = database.getRuns();
+   check(runs.size() == 2, "RunDatabase runs");
+   if(runs.size() == 2){
+      check(runs[0].time == 1000 && runs[1].time == 2000, "RunDatabase run times");
+      check(runs[0].nRanks == 2 && runs[0].nThreads == 1, "RunDatabase run sizes");
+      check(runs[0].gitHash == "abc123" && runs[0].input == "case one" && runs[1].input == "case two",
+            "RunDatabase run metadata");
+   }
+
+   vector<RunDatabase::TrendPoint> trend;
+   check(database.getTrend("/solve", "average", 3.0, trend), "RunDatabase trend of /solve");
+   check(trend.size() == 2 && trend[0].run == 0 && trend[1].run == 1 &&
+         trend[0].value == 1.0 && trend[1].value == 2.0, "RunDatabase averages of /solve");
+   check(database.getTrend("/io", "max", 3.0, trend) && trend.size() == 1 && trend[0].run == 1 &&
+         trend[0].value == 4.0, "RunDatabase timer of one run");
+   check(database.getTrend("/solve/" + oddLabel, "ranks", 3.0, trend) && trend.size() == 1 &&
+         trend[0].value == 2.0, "RunDatabase escaped label");
+   check(!database.getTrend("/missing", "average", 3.0, trend), "RunDatabase missing timer");
+   check(!database.getTrend("/solve", "missing", 3.0, trend), "RunDatabase missing metric");
+   std::filesystem::remove_all(directory);
+}
+
+void testQuantileSketch(){
+   //with at most capacity values the quantiles are exact
+   QuantileSketch a, b;
+   for(int i = 1; i <= 10; i++)
+      a.add(i);
+   for(int i = 11; i <= 20; i++)
+      b.add(i);
+   a.merge(b);
+   check(a.getWeight() == 20.0, "QuantileSketch weight after merge");
+   check(a.getQuantile(0.0) == 1.0, "QuantileSketch exact minimum");
+   check(a.getQuantile(1.0) == 20.0, "QuantileSketch exact maximum");
+   check(isClose(a.getQuantile(0.5), 10.5, 1e-12), "QuantileSketch exact median");
+
+   //merge of interleaved halves of 1..n, within 1% of the range
+   const int n = 10000;
+   QuantileSketch odd, even;
+   for(int i = 1; i <= n; i++)
+      (i % 2 ? odd : even).add(i);
+   odd.merge(even);
+   check(odd.getWeight() == n, "QuantileSketch weight of large merge");
+   check(odd.getQuantile(0.0) == 1.0 && odd.getQuantile(1.0) == n, "QuantileSketch extremes of large merge");
+   const double quantiles[] = {0.01, 0.1, 0.5, 0.9, 0.99};
+   for(double q: quantiles)
+      check(isClose(odd.getQuantile(q), q * n, 0.01 * n), "QuantileSketch quantile " + to_string(q));
+
+   QuantileSketch empty;
+   check(empty.getQuantile(0.5) == 0.0, "QuantileSketch empty");
+}
+
+/*Elements must stay in place while the vector grows over many chunks*/
+void testChunkedVector(){
+   ChunkedVector<int> vector;
+   std::vector<int*> addresses;
+   const int n = 100000;
+   for(int i = 0; i < n; i++)
+      addresses.push_back(&vector.emplace_back(i));
+   bool stable = true;
+   bool values = true;
+   for(int i = 0; i < n; i++){
+      stable = stable && &vector[i] == addresses[i];
+      values = values && vector[i] == i;
+   }
+   check(vector.size() == (size_t)n, "ChunkedVector size");
+   check(stable, "ChunkedVector addresses are stable");
+   check(values, "ChunkedVector values");
+   vector.clear();
+   check(vector.size() == 0, "ChunkedVector clear");
+}
+
+int main(int argc,char **argv){
+   int rank, nRanks;
+   MPI_Init(&argc,&argv);
+   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+   MPI_Comm_size(MPI_COMM_WORLD, &nRanks);
+   phiprof::initialize();
+
+   testTimerDump(rank, nRanks);
+   testCommunicationMatrixPrint(rank, nRanks);
+   testNodeReduction(rank, nRanks);
+   testPhases(rank, nRanks);
+   testPrintCache(rank, nRanks);
+   testMergePrint(rank, nRanks);
+   if(rank == 0){
+      testTimerDumpSynthetic();
+      testReportSettings();
+      testReportStyles();
+      testCommunicationMatrix();
+      testTimerDiff();
+      testRunDatabase();
+      testQuantileSketch();
+      testChunkedVector();
+      if(nFailed == 0)
+         cout << "unit_test: all " << nChecks << " checks passed" << endl;
+      else
+         cout << "unit_test: " << nFailed << " of " << nChecks << " checks failed" << endl;
+   }
+   MPI_Bcast(&nFailed, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   MPI_Finalize();
+   return nFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CHUNKEDVECTOR_H
+#define CHUNKEDVECTOR_H
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/*
+  Vector whose elements never move. Elements are stored in chunks that
+  double in size, chunk c holds firstChunkSize * 2^c elements, so a new
+  element never reallocates the existing ones and the directory of
+  chunks has a fixed size. Elements can be read by other threads while
+  one thread appends, as long as they only access elements that they
+  know exist, e.g. an index they got after it was added.
+*/
+template <typename T>
+class ChunkedVector {
+public:
+   ChunkedVector(){
+      for(auto &chunk : chunks)
+         chunk.store(NULL, std::memory_order_relaxed);
+   }
+   ChunkedVector(const ChunkedVector&) = delete;
+   ChunkedVector& operator=(const ChunkedVector&) = delete;
+   ~ChunkedVector(){
+      clear();
+   }
+
+   std::size_t size() const{
+      return count.load(std::memory_order_acquire);
+   }
+
+   T& operator[](std::size_t i){
+      std::size_t chunk, offset;
+      locate(i, chunk, offset);
+      return chunks[chunk].load(std::memory_order_acquire)[offset];
+   }
+
+   const T& operator[](std::size_t i) const{
+      std::size_t chunk, offset;
+      locate(i, chunk, offset);
+      return chunks[chunk].load(std::memory_order_acquire)[offset];
+   }
+
+   //construct a new element at the end, only one thread at a time
+   template <typename... Args>
+   T& emplace_back(Args&&... args){
+      const std::size_t i = count.load(std::memory_order_relaxed);
+      std::size_t chunk, offset;
+      locate(i, chunk, offset);
+      T *elements = chunks[chunk].load(std::memory_order_relaxed);
+      if(elements == NULL) {
+         elements = static_cast<T*>(::operator new(getChunkSize(chunk) * sizeof(T)));
+         chunks[chunk].store(elements, std::memory_order_release);
+      }
+      T *element = new (elements + offset) T(std::forward<Args>(args)...);
+      count.store(i + 1, std::memory_order_release);
+      return *element;
+   }
+
+   //destroy all elements and free the chunks, no other thread may access them
+   void clear(){
+      const std::size_t n = count.load(std::memory_order_relaxed);
+      for(std::size_t i = n; i > 0; i--)
+         (*this)[i - 1].~T();
+      count.store(0, std::memory_order_relaxed);
+      for(auto &chunk : chunks) {
+         ::operator delete(chunk.load(std::memory_order_relaxed));
+         chunk.store(NULL, std::memory_order_relaxed);
+      }
+   }
+
+private:
+   static const int firstChunkBits = 6;
+   static const std::size_t firstChunkSize = (std::size_t)1 << firstChunkBits;
+   static const int maxChunks = 48; //room for 2^54 elements
+
+   static std::size_t getChunkSize(std::size_t chunk){
+      return firstChunkSize << chunk;
+   }
+
+   //chunk c starts at element firstChunkSize * (2^c - 1)
+   static void locate(std::size_t i, std::size_t &chunk, std::size_t &offset){
+      const unsigned long long block = (i >> firstChunkBits) + 1;
+      chunk = 63 - __builtin_clzll(block);
+      offset = i - firstChunkSize * (((std::size_t)1 << chunk) - 1);
+   }
+
+   std::atomic<T*> chunks[maxChunks];
+   std::atomic<std::size_t> count{0};
+};
+
+#endif
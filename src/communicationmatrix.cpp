@@ -0,0 +1,113 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include "communicationmatrix.hpp"
+
+namespace {
+   const char magic[8] = {'P','H','I','P','C','O','M','M'};
+}
+
+void CommunicationMatrix::setHeader(Header &header, int nTimers, int64_t labelBytes, int64_t nEntries){
+   memcpy(header.magic, magic, sizeof(magic));
+   header.version = version;
+   header.nTimers = nTimers;
+   header.labelBytes = labelBytes;
+   header.nEntries = nEntries;
+}
+
+void CommunicationMatrix::serializeLabels(const std::vector<std::string> &labels, std::vector<char> &buffer){
+   buffer.clear();
+   for(const auto &label: labels) {
+      const int32_t length = label.size();
+      const char *bytes = reinterpret_cast<const char*>(&length);
+      buffer.insert(buffer.end(), bytes, bytes + sizeof(length));
+      buffer.insert(buffer.end(), label.begin(), label.end());
+   }
+}
+
+int CommunicationMatrix::getMaxTimers(){
+   const char *envVariable = getenv("PHIPROF_COMM_MATRIX_TIMERS");
+   if(envVariable != NULL && atoi(envVariable) > 0)
+      return atoi(envVariable);
+   return 8;
+}
+
+bool CommunicationMatrix::read(const std::string &fileName){
+   Header header;
+   std::ifstream input(fileName, std::ifstream::binary);
+   labels.clear();
+   entries.clear();
+
+   if(!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, magic, sizeof(magic)) != 0) {
+      std::cerr << "PHIPROF-ERROR: " << fileName << " is not a phiprof communication matrix" << std::endl;
+      return false;
+   }
+   if(header.version != version || header.nTimers < 0 || header.labelBytes < 0 || header.nEntries < 0) {
+      std::cerr << "PHIPROF-ERROR: Unsupported communication matrix version " << header.version << " in " << fileName << std::endl;
+      return false;
+   }
+
+   //sizes are checked against the file before anything is allocated
+   input.seekg(0, std::ifstream::end);
+   const int64_t fileSize = input.tellg();
+   input.seekg(sizeof(header));
+   if(header.labelBytes > fileSize - (int64_t)sizeof(header) ||
+      header.nTimers > header.labelBytes / (int64_t)sizeof(int32_t) ||
+      header.nEntries > (fileSize - (int64_t)sizeof(header) - header.labelBytes) / (int64_t)sizeof(Entry)) {
+      std::cerr << "PHIPROF-ERROR: Malformed header in " << fileName << std::endl;
+      return false;
+   }
+
+   for(int i = 0; i < header.nTimers; i++) {
+      int32_t length;
+      std::string label;
+      if(!input.read(reinterpret_cast<char*>(&length), sizeof(length)) || length < 0 ||
+         length > header.labelBytes) {
+         std::cerr << "PHIPROF-ERROR: Malformed labels in " << fileName << std::endl;
+         return false;
+      }
+      label.resize(length);
+      if(!input.read(&label[0], length)) {
+         std::cerr << "PHIPROF-ERROR: Malformed labels in " << fileName << std::endl;
+         return false;
+      }
+      labels.push_back(label);
+   }
+
+   entries.resize(header.nEntries);
+   input.seekg(sizeof(header) + header.labelBytes);
+   if(!input.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(Entry))) {
+      std::cerr << "PHIPROF-ERROR: Could not read entries from " << fileName << std::endl;
+      return false;
+   }
+   for(const auto &entry: entries) {
+      if(entry.timer < 0 || entry.timer >= header.nTimers) {
+         std::cerr << "PHIPROF-ERROR: Invalid timer index in entries of " << fileName << std::endl;
+         return false;
+      }
+   }
+   return true;
+}
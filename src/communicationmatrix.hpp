@@ -0,0 +1,99 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef COMMUNICATIONMATRIX_H
+#define COMMUNICATIONMATRIX_H
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+/*
+  Point-to-point messages sent in the timers with most communication,
+  written by phiprof::print() when PHIPROF_PRINTS contains
+  comm-matrix. The messages are recorded by the PMPI wrappers in
+  libphiprof_mpi and attributed to the timer that was active when the
+  send was made. The file is written with native byte order and has
+  the layout
+
+    Header
+    full label of each timer: int32 length followed by the characters,
+      e.g. /solve/halo, the root timer has an empty label
+    Entries of timer 0, timer 1, ...
+
+  The entries of each timer are a sparse matrix in coordinate format,
+  grouped by source. Sources and destinations are ranks in
+  MPI_COMM_WORLD. Timers are in decreasing order of bytes sent.
+*/
+class CommunicationMatrix {
+public:
+   static const int32_t version = 1;
+
+   struct Header {
+      char magic[8];  //"PHIPCOMM"
+      int32_t version;
+      int32_t nTimers;
+      int64_t labelBytes;
+      int64_t nEntries;
+   };
+
+   struct Entry {
+      int32_t timer;       //index of the timer in the file
+      int32_t source;
+      int32_t destination;
+      int32_t reserved;
+      int64_t count;       //messages sent
+      double bytes;        //bytes sent
+   };
+
+   /**
+    * Fill in a header for a file with nTimers timers and nEntries entries
+    */
+   static void setHeader(Header &header, int nTimers, int64_t labelBytes, int64_t nEntries);
+
+   /**
+    * Serialize the full labels of the timers, the buffer is overwritten
+    */
+   static void serializeLabels(const std::vector<std::string> &labels, std::vector<char> &buffer);
+
+   /**
+    * @return
+    *   Number of timers written, set with PHIPROF_COMM_MATRIX_TIMERS
+    *   (default 8)
+    */
+   static int getMaxTimers();
+
+   /**
+    * Read a communication matrix file
+    *
+    * @return
+    *   Returns false if the file could not be read or is not valid
+    */
+   bool read(const std::string &fileName);
+
+   const std::vector<std::string>& getLabels() const { return labels;}
+   const std::vector<Entry>& getEntries() const { return entries;}
+
+private:
+   std::vector<std::string> labels;
+   std::vector<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+/*
+  Interface for libraries that add timers automatically, e.g., the
+  PMPI wrappers in libphiprof_mpi. Not part of the public API.
+*/
+namespace phiprof
+{
+   namespace instrumentation
+   {
+      /**
+       * @return
+       *   True if timers may be added automatically: phiprof has been
+       *   initialized and is not itself communicating (print, dump)
+       */
+      bool isEnabled();
+
+      /**
+       * @return
+       *   Id of the active timer of the calling thread, the parent of
+       *   any timer started now
+       */
+      int getCurrentId();
+
+      /**
+       * Record a point-to-point message for the communication matrix
+       *
+       * @param id
+       *   Id of the timer the message is attributed to
+       * @param destination
+       *   Rank of the destination in MPI_COMM_WORLD
+       * @param bytes
+       *   Size of the message
+       */
+      void addMessage(int id, int destination, double bytes);
+
+      /**
+       * Disables automatic timers while in scope, used around the MPI
+       * communication of phiprof itself
+       */
+      class Pause {
+      public:
+         Pause();
+         ~Pause();
+         Pause(const Pause&) = delete;
+         Pause& operator=(const Pause&) = delete;
+      };
+   }
+}
+
+#endif
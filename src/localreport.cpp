@@ -0,0 +1,278 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <signal.h>
+#include <sys/stat.h>
+#include "localreport.hpp"
+#include "prettyprinttable.hpp"
+
+namespace {
+   //set by the signal handler, cleared by the helper thread
+   volatile sig_atomic_t signalReceived = 0;
+
+   void onSignal(int){
+      signalReceived = 1;
+   }
+
+   //how often the helper thread checks the flag and the trigger file
+   const std::chrono::milliseconds pollInterval(200);
+
+   //copy of what the report shows of a timer
+   struct TimerSnapshot {
+      int id;
+      int level;
+      std::string label;
+      std::vector<int> childIds;
+      double ave = 0.0, max = 0.0, elapsed = 0.0;
+      int nTimed = 0, nActive = 0;
+      int64_t averageCount = 0;
+   };
+
+   //copy of the timer a thread is in now
+   struct ActiveSnapshot {
+      int thread;
+      double elapsed;
+      std::string fullLabel;
+   };
+}
+
+LocalReport::~LocalReport(){
+   stop();
+}
+
+//signal number, or 0 if PHIPROF_SIGNAL_REPORT is not set. Accepts
+//USR1, SIGUSR1, USR2, SIGUSR2 and signal numbers.
+int LocalReport::getSignal(){
+   const char *value = getenv("PHIPROF_SIGNAL_REPORT");
+   if(value == NULL || strlen(value) == 0)
+      return 0;
+   std::string name(value);
+   if(name.compare(0, 3, "SIG") == 0)
+      name = name.substr(3);
+   if(name == "USR1")
+      return SIGUSR1;
+   if(name == "USR2")
+      return SIGUSR2;
+   const int number = atoi(value);
+   if(number <= 0) {
+      std::cerr << "PHIPROF-ERROR: Invalid signal " << value << " in PHIPROF_SIGNAL_REPORT" << std::endl;
+      return 0;
+   }
+   return number;
+}
+
+std::string LocalReport::getTriggerFile(){
+   const char *value = getenv("PHIPROF_TRIGGER_FILE");
+   return value != NULL ? value : "";
+}
+
+std::string LocalReport::getPrefix(){
+   const char *value = getenv("PHIPROF_LOCAL_PREFIX");
+   return value != NULL ? value : "phiprof_local";
+}
+
+bool LocalReport::start(const TimerTree &reportTree, int reportRank){
+   if(helper.joinable())
+      return true;
+   const int signalNumber = getSignal();
+   triggerFile = getTriggerFile();
+   if(signalNumber == 0 && triggerFile.empty())
+      return true;
+
+   tree = &reportTree;
+   rank = reportRank;
+   prefix = getPrefix();
+   stopping = false;
+   if(!triggerFile.empty())
+      isTriggerFileTouched(); //only later changes trigger a report
+   if(signalNumber != 0) {
+      struct sigaction action;
+      memset(&action, 0, sizeof(action));
+      action.sa_handler = onSignal;
+      action.sa_flags = SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      if(sigaction(signalNumber, &action, NULL) != 0) {
+         std::cerr << "PHIPROF-ERROR: Could not install handler for signal " << signalNumber << std::endl;
+         return false;
+      }
+   }
+   helper = std::thread(&LocalReport::run, this);
+   return true;
+}
+
+void LocalReport::stop(){
+   if(!helper.joinable())
+      return;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+   }
+   wakeup.notify_one();
+   helper.join();
+}
+
+void LocalReport::run(){
+   std::unique_lock<std::mutex> lock(mutex);
+   while(!wakeup.wait_for(lock, pollInterval, [this]{ return stopping; })) {
+      if(signalReceived) {
+         signalReceived = 0;
+         write("signal");
+      }
+      if(!triggerFile.empty() && isTriggerFileTouched())
+         write("trigger file " + triggerFile);
+   }
+}
+
+//true if the trigger file has been created or modified since the
+//previous call
+bool LocalReport::isTriggerFileTouched(){
+   struct stat status;
+   double modificationTime = -1.0;
+   if(stat(triggerFile.c_str(), &status) == 0)
+      modificationTime = status.st_mtim.tv_sec + 1.0e-9 * status.st_mtim.tv_nsec;
+   const bool touched = modificationTime >= 0.0 && modificationTime != triggerTime;
+   triggerTime = modificationTime;
+   return touched;
+}
+
+bool LocalReport::write(const std::string &reason){
+   std::stringstream fname;
+   fname << prefix << "_" << rank << "_" << nReports++ << ".txt";
+   std::ofstream output(fname.str());
+   if(!output.good()) {
+      std::cerr << "PHIPROF-ERROR: Could not open " << fname.str() << " for writing" << std::endl;
+      return false;
+   }
+   print(*tree, rank, reason, output);
+   return true;
+}
+
+
+void LocalReport::print(const TimerTree &tree, int rank, const std::string &reason, std::ostream &output){
+   //Copy the timers in the same critical region in which they are
+   //created, so that the child lists and labels do not change while
+   //they are read. The values are still updated by the other threads.
+   std::vector<TimerSnapshot> timers;
+   std::vector<ActiveSnapshot> activeTimers;
+   double initTime;
+#pragma omp critical(phiprof)
+   {
+      const int nTimers = tree.size();
+      const int nThreads = tree.getNumThreads();
+      initTime = tree[0].getElapsedTime(0);
+      for(int thread = 0; thread < nThreads; thread++) {
+         const int id = tree.getCurrentId(thread);
+         if(id >= 0 && id < nTimers)
+            activeTimers.push_back({thread, tree[id].getElapsedTime(thread), tree.getFullLabel(id)});
+      }
+      timers.resize(nTimers);
+      for(int id = 0; id < nTimers; id++) {
+         const TimerData &timer = tree[id];
+         TimerSnapshot &snapshot = timers[id];
+         double min;
+         snapshot.id = id;
+         snapshot.level = timer.getLevel();
+         snapshot.label = timer.getLabel();
+         snapshot.childIds = timer.getChildIds();
+         timer.getTimeStatistics(snapshot.ave, snapshot.max, min, snapshot.nTimed);
+         snapshot.averageCount = timer.getAverageCount();
+         for(int thread = 0; thread < nThreads; thread++) {
+            const double threadElapsed = timer.getElapsedTime(thread);
+            if(threadElapsed >= 0.0) {
+               snapshot.nActive++;
+               snapshot.elapsed = std::max(snapshot.elapsed, threadElapsed);
+            }
+         }
+      }
+   }
+   std::stringstream buffer;
+
+   //where each thread is now
+   PrettyPrintTable active;
+   buffer << "Active timers of rank " << rank << " (" << reason << "), "
+          << initTime << " s after initialization";
+   active.addTitle(buffer.str());
+   active.addHorizontalLine();
+   active.addElement("Thread");
+   active.addElement("Elapsed (s)");
+   active.addElement("Timer");
+   active.addHorizontalLine();
+   for(const auto &a : activeTimers) {
+      active.addRow();
+      active.addElement(a.thread);
+      active.addElement(a.elapsed);
+      active.addElement(a.fullLabel);
+   }
+   active.addHorizontalLine();
+   active.print(output);
+   output << std::endl;
+
+   //all timers, the time of running intervals is included
+   PrettyPrintTable table;
+   table.addTitle("All timers, time includes running intervals");
+   table.addHorizontalLine();
+   table.addElement("", 3);
+   table.addElement("Threads", 2);
+   table.addElement("Count", 1);
+   table.addElement("Thread time", 3);
+   table.addHorizontalLine();
+   table.addElement("Id");
+   table.addElement("Lvl");
+   table.addElement("Name");
+   table.addElement("No");
+   table.addElement("Active");
+   table.addElement("Avg");
+   table.addElement("Avg (s)");
+   table.addElement("Max (s)");
+   table.addElement("Elapsed (s)");
+   table.addHorizontalLine();
+
+   //depth-first order of the tree
+   std::vector<int> stack(1, 0);
+   while(!stack.empty()) {
+      const TimerSnapshot &timer = timers[stack.back()];
+      stack.pop_back();
+      for(auto child = timer.childIds.rbegin(); child != timer.childIds.rend(); ++child)
+         stack.push_back(*child);
+
+      table.addRow();
+      table.addElement(timer.id);
+      table.addElement(timer.level);
+      table.addElement(timer.label, 1, timer.level);
+      table.addElement(timer.nTimed);
+      table.addElement(timer.nActive);
+      table.addElement(timer.averageCount);
+      table.addElement(timer.nTimed > 0 ? timer.ave : 0.0);
+      table.addElement(timer.nTimed > 0 ? timer.max : 0.0);
+      if(timer.nActive > 0)
+         table.addElement(timer.elapsed);
+      else
+         table.addElement("");
+   }
+   table.addHorizontalLine();
+   table.print(output);
+}
@@ -0,0 +1,92 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef LOCALREPORT_H
+#define LOCALREPORT_H
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include "timertree.hpp"
+
+/*
+  Report of the timers of one process, written on request without any
+  MPI communication, e.g. to see where a stuck job is. A helper thread
+  writes the report into prefix_rank_n.txt when the process receives
+  the signal in PHIPROF_SIGNAL_REPORT (e.g. USR1), or when the file
+  in PHIPROF_TRIGGER_FILE is created or touched. The prefix is set with
+  PHIPROF_LOCAL_PREFIX (default phiprof_local).
+
+  The signal handler only sets a flag that the helper thread polls.
+  The helper thread copies the timers under the lock in which timers
+  are created, and writes the report from the copy. The other threads
+  keep updating the values meanwhile, so a value can miss an interval
+  that ends while the copy is made.
+*/
+class LocalReport {
+public:
+   ~LocalReport();
+
+   /**
+    * Start the helper thread if a signal or a trigger file has been
+    * set in the environment. Does nothing if already started.
+    *
+    * @param tree
+    *   Timers that are reported, have to outlive the helper thread
+    * @param rank
+    *   Rank of the process, used in the file names
+    * @return
+    *   Returns false if the signal handler could not be installed.
+    */
+   bool start(const TimerTree &tree, int rank);
+
+   /**
+    * Stop and join the helper thread.
+    */
+   void stop();
+
+   /**
+    * Write the report of the timers of this process.
+    */
+   static void print(const TimerTree &tree, int rank, const std::string &reason, std::ostream &output);
+
+private:
+   void run();
+   bool isTriggerFileTouched();
+   bool write(const std::string &reason);
+
+   static int getSignal();
+   static std::string getTriggerFile();
+   static std::string getPrefix();
+
+   const TimerTree *tree = NULL;
+   int rank = 0;
+   int nReports = 0;
+   std::string triggerFile;
+   std::string prefix;
+   double triggerTime = -1.0; //modification time of the trigger file when last seen, -1 if missing
+   std::thread helper;
+   std::mutex mutex;
+   std::condition_variable wakeup;
+   bool stopping = false;
+};
+
+#endif
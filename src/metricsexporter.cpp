@@ -0,0 +1,218 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include "metricsexporter.hpp"
+#include "common.hpp"
+
+namespace {
+   //label value with backslash, double quote and newline escaped
+   std::string escape(const std::string &value){
+      std::string escaped;
+      for(char c : value) {
+         if(c == '\\' || c == '"')
+            escaped += '\\';
+         if(c == '\n')
+            escaped += "\\n";
+         else
+            escaped += c;
+      }
+      return escaped;
+   }
+
+   //path of the timer as in the reports, /solve/halo, the root is /
+   std::string getPathLabel(const NodeCounters::Path &path){
+      std::string label;
+      for(unsigned int i = 1; i < path.size(); i++)
+         label += "/" + path[i];
+      return label.empty() ? "/" : label;
+   }
+
+   void printFamily(const std::string &name, const std::string &type, const std::string &unit,
+                    const std::string &help, std::ostream &output){
+      output << "# TYPE " << name << " " << type << "\n";
+      if(!unit.empty())
+         output << "# UNIT " << name << " " << unit << "\n";
+      output << "# HELP " << name << " " << help << "\n";
+   }
+}
+
+MetricsExporter::~MetricsExporter(){
+   stop();
+}
+
+std::string MetricsExporter::getFileName(){
+   const char *value = getenv("PHIPROF_METRICS_FILE");
+   return value != NULL ? value : "";
+}
+
+double MetricsExporter::getInterval(){
+   const char *value = getenv("PHIPROF_METRICS_INTERVAL");
+   const double interval = value != NULL ? atof(value) : 0.0;
+   return interval > 0.0 ? interval : 15.0;
+}
+
+bool MetricsExporter::isEnabled(){
+   return !getFileName().empty();
+}
+
+void MetricsExporter::start(const std::string &jobId){
+   if(helper.joinable() || !isEnabled())
+      return;
+   fileName = getFileName();
+   job = jobId;
+   node.setJob(job);
+   stopping = false;
+   helper = std::thread(&MetricsExporter::run, this);
+}
+
+void MetricsExporter::stop(){
+   if(helper.joinable()) {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stopping = true;
+      }
+      wakeup.notify_one();
+      helper.join();
+   }
+   if(lockDescriptor >= 0) {
+      close(lockDescriptor);
+      lockDescriptor = -1;
+   }
+}
+
+//The process holding the lock file writes the metrics. The lock is
+//released when the process exits, and another process takes over.
+bool MetricsExporter::isWriter(){
+   if(lockDescriptor >= 0)
+      return true;
+   const std::string lockName = fileName + ".lock";
+   const int descriptor = open(lockName.c_str(), O_CREAT | O_RDWR, 0644);
+   if(descriptor < 0)
+      return false;
+   if(flock(descriptor, LOCK_EX | LOCK_NB) != 0) {
+      close(descriptor);
+      return false;
+   }
+   lockDescriptor = descriptor;
+   return true;
+}
+
+void MetricsExporter::run(){
+   const std::chrono::duration<double> interval(getInterval());
+   std::map<NodeCounters::Path, NodeCounters::Totals> previous, current;
+   double previousTime = -1.0;
+   std::unique_lock<std::mutex> lock(mutex);
+   while(!wakeup.wait_for(lock, interval, [this]{ return stopping; })) {
+      if(!isWriter())
+         continue;
+      const int nProcesses = node.sample(current);
+      const double now = wTime();
+      //the first sample of a new writer is only used for the rates
+      if(previousTime >= 0.0)
+         write(current, previous, nProcesses, now - previousTime);
+      previous.swap(current);
+      previousTime = now;
+   }
+}
+
+bool MetricsExporter::write(const std::map<NodeCounters::Path, NodeCounters::Totals> &totals,
+                            const std::map<NodeCounters::Path, NodeCounters::Totals> &previous,
+                            int nProcesses, double interval){
+   //rename is atomic within the file system of the file
+   const std::string temporaryName = fileName + ".tmp." + std::to_string(getpid());
+   std::ofstream output(temporaryName);
+   if(!output.good()) {
+      std::cerr << "PHIPROF-ERROR: Could not open " << temporaryName << " for writing" << std::endl;
+      return false;
+   }
+   print(totals, previous, nProcesses, interval, job, output);
+   output.close();
+   if(!output.good() || rename(temporaryName.c_str(), fileName.c_str()) != 0) {
+      std::cerr << "PHIPROF-ERROR: Could not write " << fileName << std::endl;
+      remove(temporaryName.c_str());
+      return false;
+   }
+   return true;
+}
+
+void MetricsExporter::print(const std::map<NodeCounters::Path, NodeCounters::Totals> &totals,
+                            const std::map<NodeCounters::Path, NodeCounters::Totals> &previous,
+                            int nProcesses, double interval, const std::string &job, std::ostream &output){
+   const std::string jobLabel = "job=\"" + escape(job) + "\"";
+   std::map<NodeCounters::Path, std::string> labels;
+   for(const auto &t : totals) {
+      labels[t.first] = "{" + jobLabel + ",path=\"" + escape(getPathLabel(t.first)) +
+         "\",group=\"" + escape(t.second.groups) + "\"";
+   }
+   output.precision(12);
+
+   printFamily("phiprof_processes", "gauge", "", "Processes of the job on this node that publish their timers.", output);
+   output << "phiprof_processes{" << jobLabel << "} " << nProcesses << "\n";
+
+   printFamily("phiprof_timer_seconds", "counter", "seconds",
+               "Time in the timer, summed over the processes of the average over their threads.", output);
+   for(const auto &t : totals)
+      output << "phiprof_timer_seconds_total" << labels[t.first] << "} " << t.second.time << "\n";
+
+   printFamily("phiprof_timer_max_seconds", "gauge", "seconds",
+               "Time in the timer of the slowest process.", output);
+   for(const auto &t : totals)
+      output << "phiprof_timer_max_seconds" << labels[t.first] << "} " << t.second.timeMax << "\n";
+
+   printFamily("phiprof_timer_calls", "counter", "",
+               "Stopped intervals of the timer, summed over the processes and threads.", output);
+   for(const auto &t : totals)
+      output << "phiprof_timer_calls_total" << labels[t.first] << "} " << t.second.count << "\n";
+
+   printFamily("phiprof_timer_active_threads", "gauge", "", "Threads that are in the timer now.", output);
+   for(const auto &t : totals)
+      output << "phiprof_timer_active_threads" << labels[t.first] << "} " << t.second.active << "\n";
+
+   //workunits only for the timers that have them
+   printFamily("phiprof_timer_workunits", "counter", "",
+               "Workunits of the timer, summed over the processes and threads.", output);
+   for(const auto &t : totals) {
+      if(!t.second.workUnitLabel.empty())
+         output << "phiprof_timer_workunits_total" << labels[t.first] << ",unit=\""
+                << escape(t.second.workUnitLabel) << "\"} " << t.second.workUnits << "\n";
+   }
+
+   printFamily("phiprof_timer_workunit_rate", "gauge", "",
+               "Workunits per second of the timer over the last export interval.", output);
+   for(const auto &t : totals) {
+      if(t.second.workUnitLabel.empty())
+         continue;
+      auto before = previous.find(t.first);
+      const double previousWorkUnits = before != previous.end() ? before->second.workUnits : 0.0;
+      output << "phiprof_timer_workunit_rate" << labels[t.first] << ",unit=\""
+             << escape(t.second.workUnitLabel) << "\"} "
+             << std::max(t.second.workUnits - previousWorkUnits, 0.0) / interval << "\n";
+   }
+   output << "# EOF\n";
+}
@@ -0,0 +1,93 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef METRICSEXPORTER_H
+#define METRICSEXPORTER_H
+#include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+#include "sharedcounters.hpp"
+
+/*
+  Periodic export of the timers of the processes of a job on this node
+  into a file in the OpenMetrics text format, e.g. for the textfile
+  collector of the Prometheus node exporter. Enabled by setting
+  PHIPROF_METRICS_FILE, the interval is PHIPROF_METRICS_INTERVAL
+  seconds (default 15).
+
+  Every process starts a helper thread, and the one that holds the lock
+  file <file>.lock writes the file. It sums the shared counters (see
+  SharedCounters) of all processes of the same job on the node by timer
+  path, without any MPI communication. The file is written into a
+  temporary file and renamed, so readers never see a partial file.
+*/
+class MetricsExporter {
+public:
+   ~MetricsExporter();
+
+   static bool isEnabled();
+
+   /**
+    * Start the helper thread if PHIPROF_METRICS_FILE is set. Does
+    * nothing if already started. The counters of this process have to
+    * be published in shared memory.
+    *
+    * @param job
+    *   Job id of this process, processes of other jobs are left out
+    */
+   void start(const std::string &job);
+
+   /**
+    * Stop and join the helper thread, and release the lock file.
+    */
+   void stop();
+
+   /**
+    * Write the metrics of a sample. Rates are computed from the
+    * previous sample, interval seconds earlier.
+    */
+   static void print(const std::map<NodeCounters::Path, NodeCounters::Totals> &totals,
+                     const std::map<NodeCounters::Path, NodeCounters::Totals> &previous,
+                     int nProcesses, double interval, const std::string &job, std::ostream &output);
+
+private:
+   void run();
+   bool isWriter();
+   bool write(const std::map<NodeCounters::Path, NodeCounters::Totals> &totals,
+              const std::map<NodeCounters::Path, NodeCounters::Totals> &previous,
+              int nProcesses, double interval);
+
+   static std::string getFileName();
+   static double getInterval();
+
+   std::string fileName;
+   std::string job;
+   int lockDescriptor = -1; //open while this process writes the file
+   NodeCounters node;
+   std::thread helper;
+   std::mutex mutex;
+   std::condition_variable wakeup;
+   bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,170 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <cstring>
+#include <iostream>
+#include "nodereducer.hpp"
+#include "mpi.h"
+
+NodeReducer::NodeReducer() : nodeComm(MPI_COMM_NULL), leaderComm(MPI_COMM_NULL), flatComm(MPI_COMM_NULL),
+                             window(MPI_WIN_NULL), slot(NULL), slotBytes(0), useWindow(true),
+                             nodeRank(0), nodeSize(1), nNodes(1) {}
+
+bool NodeReducer::initialize(MPI_Comm comm){
+   int rank;
+   int success = 1;
+   MPI_Comm_rank(comm, &rank);
+
+   //key is the rank in comm, so that rank 0 in comm is also the
+   //leader (rank 0) of its node and rank 0 among the leaders
+   if(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm) != MPI_SUCCESS) {
+      nodeComm = MPI_COMM_NULL;
+      success = 0;
+   }
+   //all processes have to take the same path, the two modes use
+   //different collectives
+   MPI_Allreduce(MPI_IN_PLACE, &success, 1, MPI_INT, MPI_MIN, comm);
+   if(success) {
+      MPI_Comm_rank(nodeComm, &nodeRank);
+      MPI_Comm_size(nodeComm, &nodeSize);
+      if(MPI_Comm_split(comm, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &leaderComm) != MPI_SUCCESS) {
+         leaderComm = MPI_COMM_NULL;
+         success = 0;
+      }
+      MPI_Allreduce(MPI_IN_PLACE, &success, 1, MPI_INT, MPI_MIN, comm);
+   }
+   if(success) {
+      if(nodeRank == 0)
+         MPI_Comm_size(leaderComm, &nNodes);
+      MPI_Bcast(&nNodes, 1, MPI_INT, 0, nodeComm);
+   }
+   else {
+      //flat reductions over comm, each process is a node of its own
+      finalize();
+      flatComm = comm;
+      MPI_Comm_size(comm, &nNodes);
+      if(rank == 0)
+         std::cerr << "PHIPROF-ERROR: Error splitting communicator into nodes, reducing without the node level" << std::endl;
+   }
+   return success;
+}
+
+void NodeReducer::finalize(){
+   freeWindow();
+   if(leaderComm != MPI_COMM_NULL)
+      MPI_Comm_free(&leaderComm);
+   if(nodeComm != MPI_COMM_NULL)
+      MPI_Comm_free(&nodeComm);
+   flatComm = MPI_COMM_NULL; //not owned
+   nodeBuffer.clear();
+   useWindow = true;
+   nodeRank = 0;
+   nodeSize = 1;
+   nNodes = 1;
+}
+
+//make sure each process has at least bytes in its slot of the shared
+//window. Collective over nodeComm, all processes in node have to ask for the
+//same size. Returns false if the window could not be allocated, then
+//the node uses messages instead.
+bool NodeReducer::reserveWindow(MPI_Aint bytes){
+   if(!useWindow)
+      return false;
+   if(bytes <= slotBytes)
+      return true;
+   freeWindow();
+   int success = MPI_Win_allocate_shared(bytes, 1, MPI_INFO_NULL, nodeComm, &slot, &window) == MPI_SUCCESS;
+   MPI_Allreduce(MPI_IN_PLACE, &success, 1, MPI_INT, MPI_MIN, nodeComm);
+   if(!success) {
+      //the window may exist on some processes only, it is left as is
+      window = MPI_WIN_NULL;
+      slot = NULL;
+      useWindow = false;
+      if(nodeRank == 0)
+         std::cerr << "PHIPROF-ERROR: Error allocating shared memory window, reducing with messages within the node" << std::endl;
+      return false;
+   }
+   MPI_Win_lock_all(MPI_MODE_NOCHECK, window);
+   slotBytes = bytes;
+   return true;
+}
+
+void NodeReducer::freeWindow(){
+   if(window != MPI_WIN_NULL) {
+      MPI_Win_unlock_all(window);
+      MPI_Win_free(&window);
+   }
+   slot = NULL;
+   slotBytes = 0;
+}
+
+void NodeReducer::reduceInNode(const void *sendbuf, void *nodebuf, int count, MPI_Datatype datatype, MPI_Op op){
+   MPI_Aint lb, extent;
+   MPI_Type_get_extent(datatype, &lb, &extent);
+   MPI_Aint bytes = extent * count;
+
+   if(nodeSize == 1) {
+      memcpy(nodebuf, sendbuf, bytes);
+      return;
+   }
+   if(!reserveWindow(bytes)) {
+      MPI_Reduce(sendbuf, nodeRank == 0 ? nodebuf : NULL, count, datatype, op, 0, nodeComm);
+      return;
+   }
+   //publish own values in the shared window
+   memcpy(slot, sendbuf, bytes);
+   MPI_Win_sync(window);
+   MPI_Barrier(nodeComm);
+   MPI_Win_sync(window);
+
+   if(nodeRank == 0) {
+      //leader reduces directly from the slots of the other processes,
+      //in rank order as MPI_Reduce does for non-commutative operators:
+      //MPI_Reduce_local puts the lower rank on the left
+      for(int r = nodeSize - 1; r >= 0; r--) {
+         MPI_Aint otherBytes;
+         int dispUnit;
+         char *otherSlot;
+         MPI_Win_shared_query(window, r, &otherBytes, &dispUnit, &otherSlot);
+         if(r == nodeSize - 1)
+            memcpy(nodebuf, otherSlot, bytes);
+         else
+            MPI_Reduce_local(otherSlot, nodebuf, count, datatype, op);
+      }
+   }
+   //slots may not be overwritten before the leader has read them
+   MPI_Barrier(nodeComm);
+}
+
+void NodeReducer::reduceOverLeaders(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op){
+   const MPI_Comm comm = flatComm != MPI_COMM_NULL ? flatComm : leaderComm;
+   int leaderRank;
+   MPI_Comm_rank(comm, &leaderRank);
+   MPI_Reduce(sendbuf, leaderRank == 0 ? recvbuf : NULL, count, datatype, op, 0, comm);
+}
+
+void NodeReducer::reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op){
+   MPI_Aint lb, extent;
+   MPI_Type_get_extent(datatype, &lb, &extent);
+   nodeBuffer.resize(extent * count);
+   reduceInNode(sendbuf, nodeBuffer.data(), count, datatype, op);
+   if(nodeRank == 0)
+      reduceOverLeaders(nodeBuffer.data(), recvbuf, count, datatype, op);
+}
@@ -0,0 +1,97 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef NODEREDUCER_H
+#define NODEREDUCER_H
+#include <vector>
+#include "mpi.h"
+
+/*
+  Two-level reduction over a communicator. Values are first reduced
+  within each shared-memory node through an MPI shared-memory window,
+  and then over the node leaders only. The root of all reductions is
+  rank 0 of the communicator given to initialize(). If the node
+  communicators cannot be created, all reductions are done with
+  MPI_Reduce over that communicator instead, and if the shared window
+  cannot be allocated, the node level uses MPI_Reduce over the node.
+*/
+class NodeReducer {
+public:
+   NodeReducer();
+
+   /**
+    * Split the communicator into node and node-leader communicators.
+    * Collective over comm.
+    *
+    * @return
+    *   Returns true if the communicators were created successfully.
+    *   If not, the reducer still works without the node level, and
+    *   every process counts as a node of its own.
+    */
+   bool initialize(MPI_Comm comm);
+
+   /**
+    * Free the shared-memory window and the communicators. Collective
+    * over the communicator given to initialize().
+    */
+   void finalize();
+
+   /**
+    * Reduce count elements to rank 0 of the communicator, with the
+    * same semantics as MPI_Reduce. recvbuf is only used on rank 0.
+    * Non-commutative operators are applied in the order of the ranks
+    * within a node, and of the node leaders over the nodes.
+    */
+   void reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op);
+
+   /**
+    * First level of reduce(). Reduces count elements within the node,
+    * result is only written into nodebuf on the node leader.
+    */
+   void reduceInNode(const void *sendbuf, void *nodebuf, int count, MPI_Datatype datatype, MPI_Op op);
+
+   /**
+    * Second level of reduce(). Reduces over node leaders to rank 0,
+    * only node leaders may call this function.
+    */
+   void reduceOverLeaders(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op);
+
+   bool isLeader() const { return nodeRank == 0;}
+   int getNodeSize() const { return nodeSize;}
+   int getNumNodes() const { return nNodes;}
+
+private:
+   bool reserveWindow(MPI_Aint bytes);
+   void freeWindow();
+
+   MPI_Comm nodeComm;   //processes sharing memory
+   MPI_Comm leaderComm; //rank 0 of each nodeComm, MPI_COMM_NULL elsewhere
+   MPI_Comm flatComm;   //communicator given to initialize() if splitting it failed, not owned
+   MPI_Win window;      //shared window with one slot per process in node
+   char *slot;          //slot of this process in window
+   MPI_Aint slotBytes;
+   bool useWindow;      //false if allocating the window failed
+   std::vector<char> nodeBuffer;
+   int nodeRank;
+   int nodeSize;
+   int nNodes;
+};
+
+#endif
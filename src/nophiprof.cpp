@@ -44,6 +44,12 @@ namespace phiprof
    int initializeTimer([[maybe_unused]] const string &label, [[maybe_unused]] const string &group1, [[maybe_unused]] const string &group2, [[maybe_unused]]const string &group3){return 0;}
 
    bool print([[maybe_unused]] MPI_Comm comm, [[maybe_unused]] std::string fileNamePrefix){return true;}
+   bool dump([[maybe_unused]] MPI_Comm comm, [[maybe_unused]] std::string fileName){return true;}
+   bool finalize(){return true;}
+   bool reset(){return true;}
+   bool pause(){return true;}
+   bool resume(){return true;}
+   bool setPhase([[maybe_unused]] const std::string &name){return true;}
    
 
 }
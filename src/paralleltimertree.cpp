@@ -27,9 +27,9 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <set>
 #include <limits>
 #include <algorithm>
+#include <functional>
 #include <time.h>
 #include "paralleltimertree.hpp"
-#include "prettyprinttable.hpp"
 #include "common.hpp"
 
 #ifdef _OPENMP
@@ -43,6 +43,48 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 ////-------------------------------------------------------------------------
 ///  Collect statistics functions
 ////-------------------------------------------------------------------------            
+
+namespace {
+   //quantiles of the time over processes, set PHIPROF_QUANTILES=0 to
+   //leave out their reductions
+   bool isQuantilesEnabled(){
+      const char *quantilesVariable = getenv("PHIPROF_QUANTILES");
+      return quantilesVariable == NULL || strcmp(quantilesVariable, "0") != 0;
+   }
+
+   //MPI operator merging arrays of quantile sketches
+   void mergeQuantileSketches(void *in, void *inout, int *len, MPI_Datatype *){
+      const QuantileSketch *inSketches = static_cast<const QuantileSketch*>(in);
+      QuantileSketch *inoutSketches = static_cast<QuantileSketch*>(inout);
+      for(int i = 0; i < *len; i++)
+         inoutSketches[i].merge(inSketches[i]);
+   }
+
+   //Write the blocks of all processes into a file with one collective
+   //write, through a file view with a block for each part. Returns 1
+   //if the local write succeeded.
+   int writeBlocks(MPI_Comm comm, const std::string &fileName, const std::vector<char> &buffer,
+                   const std::vector<int> &blockLengths, const std::vector<MPI_Aint> &blockOffsets){
+      int success = 1;
+      MPI_Datatype fileType;
+      MPI_File file;
+      MPI_Type_create_hindexed(blockLengths.size(), blockLengths.data(), blockOffsets.data(), MPI_BYTE, &fileType);
+      MPI_Type_commit(&fileType);
+      if(MPI_File_open(comm, fileName.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) == MPI_SUCCESS) {
+         //remove old contents if the file existed
+         MPI_File_set_size(file, 0);
+         MPI_File_set_view(file, 0, MPI_BYTE, fileType, "native", MPI_INFO_NULL);
+         if(MPI_File_write_at_all(file, 0, buffer.data(), buffer.size(), MPI_BYTE, MPI_STATUS_IGNORE) != MPI_SUCCESS)
+            success = 0;
+         MPI_File_close(&file);
+      }
+      else {
+         success = 0;
+      }
+      MPI_Type_free(&fileType);
+      return success;
+   }
+}
      
       
 // reportRank is the rank to be used in the report, not the rank in the printComm communicator      
@@ -52,28 +94,31 @@ void ParallelTimerTree::collectGroupStats(int reportRank){
    std::vector<doubleRankPair> timeRank;
    std::map<std::string,std::vector<int> > groups;
    doubleRankPair in;
-   int totalIndex=0; //where we store the group for total time (called Total, in timer id=0)
 
 
-   //construct std::map from groups to timers in group 
-   for(unsigned int id=0;id < size();id++){
-      for(auto &group: (*this)[id].getGroups() ){
-         groups[group].push_back(id);
+   //construct std::map from groups to timers in group. The dictionary
+   //is used so that all processes have the same groups also when
+   //trees are merged
+   for(unsigned int index=0;index < report.dictionary.size();index++){
+      for(auto &group: report.dictionary[index].groups ){
+         groups[group].push_back(index);
       }
    }
 
    int nGroups=groups.size();
-   groupStats.name.clear(); // we will use push_back to add names to this std::vector
+   report.groupStats.name.clear(); // we will use push_back to add names to this std::vector
+   for(auto &group: groups)
+      report.groupStats.name.push_back(group.first);
+   //bits of the groups in the timers, resolved once for the report
+   std::vector<uint64_t> groupBits;
+   TimerData::getGroupBits(report.groupStats.name, groupBits);
    
    //collect data for groups
-   for(std::map<std::string, std::vector<int> >::iterator group=groups.begin();
-       group!=groups.end();++group){
+   for(int group = 0; group < nGroups; group++){
       double groupTime=0.0;
-      if(group->first=="Total")
-         totalIndex=groupStats.name.size();
-      
-      groupTime=getGroupTime(group->first, 0);
-      groupStats.name.push_back(group->first);
+      //no timer is in a group that has never been used here
+      if(groupBits[group] != 0)
+         groupTime=getGroupTime(report.groupStats.name[group], groupBits[group], 0);
       time.push_back(groupTime);
       in.val=groupTime;
       in.rank=reportRank;
@@ -83,186 +128,238 @@ void ParallelTimerTree::collectGroupStats(int reportRank){
    //Compute statistics using reduce operations
    if(rankInPrint==0){
       //reserve space for reduce operations output
-      groupStats.timeSum.resize(nGroups);
-      groupStats.timeMax.resize(nGroups);
-      groupStats.timeMin.resize(nGroups);
-      groupStats.timeTotalFraction.resize(nGroups);
-
-      MPI_Reduce(&(time[0]),&(groupStats.timeSum[0]),nGroups,MPI_DOUBLE,MPI_SUM,0,printComm);
-      MPI_Reduce(&(timeRank[0]),&(groupStats.timeMax[0]),nGroups,MPI_DOUBLE_INT,MPI_MAXLOC,0,printComm);
-      MPI_Reduce(&(timeRank[0]),&(groupStats.timeMin[0]),nGroups,MPI_DOUBLE_INT,MPI_MINLOC,0,printComm);
-
-      for(int i = 0; i < nGroups; i++){
-         if(groupStats.timeSum[totalIndex] > 0)
-            groupStats.timeTotalFraction[i] = groupStats.timeSum[i] / groupStats.timeSum[totalIndex];
-         else 
-            groupStats.timeTotalFraction[i] = 0.0;
-      }
-   }
-   else{
-      //not masterank, we do not resize and use groupStats std::vectors
-      MPI_Reduce(&(time[0]),NULL,nGroups,MPI_DOUBLE,MPI_SUM,0,printComm);
-      MPI_Reduce(&(timeRank[0]),NULL,nGroups,MPI_DOUBLE_INT,MPI_MAXLOC,0,printComm);
-      MPI_Reduce(&(timeRank[0]),NULL,nGroups,MPI_DOUBLE_INT,MPI_MINLOC,0,printComm);            
+      report.groupStats.timeSum.resize(nGroups);
+      report.groupStats.timeMax.resize(nGroups);
+      report.groupStats.timeMin.resize(nGroups);
    }
-
+   //output std::vectors are only used on rank 0 of printComm
+   reducer.reduce(&(time[0]),report.groupStats.timeSum.data(),nGroups,MPI_DOUBLE,MPI_SUM);
+   reducer.reduce(&(timeRank[0]),report.groupStats.timeMax.data(),nGroups,MPI_DOUBLE_INT,MPI_MAXLOC);
+   reducer.reduce(&(timeRank[0]),report.groupStats.timeMin.data(),nGroups,MPI_DOUBLE_INT,MPI_MINLOC);
 }
 
       
-//collect timer stats, call children recursively. In original code this should be called for the first id=0
+//collect timer stats, call children recursively. In original code this should be called for the first index=0
 // reportRank is the rank to be used in the report, not the rank in the printComm communicator
-void ParallelTimerTree::collectTimerStats(int reportRank, int id, int parentIndex){
+// index is the index of the timer in the report.dictionary. When trees are merged the timer may not exist on this process.
+void ParallelTimerTree::collectTimerStats(int reportRank, int index, int parentIndex){
    //per process info. updated in collectStats
    static std::vector<double> time;
    static std::vector<doubleRankPair> timeRank;
+   static std::vector<doubleRankPair> timeRankMin;
    static std::vector<double> workUnits;
    static std::vector<int64_t> count;
    static std::vector<int> threads;
+   static std::vector<int> ranks;
    static std::vector<double> threadImbalance;
    static std::vector<doubleRankPair> threadImbalanceRank;
-   static std::vector<int> parentIndices;
+   static std::vector<doubleRankPair> threadImbalanceRankMin;
+   static std::vector<double> exclusiveTime;
+   static std::vector<doubleRankPair> exclusiveTimeRank;
+   static std::vector<double> exclusiveThreadImbalance;
+   static std::vector<doubleRankPair> exclusiveThreadImbalanceRank;
    int currentIndex;
    doubleRankPair in;
 
+   //Processes that do not have the timer add values that are ignored
+   //in the MAXLOC and MINLOC reductions, and zero to sums. Exclusive
+   //time is negative for "other", which is not a timer
+   auto addValues = [&](bool present, double timerTime, int64_t timerCount, int timerThreads,
+                        double timerThreadImbalance, double timerWorkUnits, int timerParentIndex,
+                        double timerExclusiveTime, double timerExclusiveThreadImbalance) {
+      in.rank = reportRank;
+      ranks.push_back(present ? 1 : 0);
+      time.push_back(timerTime);
+      in.val = present ? timerTime : -1.0;
+      timeRank.push_back(in);
+      in.val = present ? timerTime : std::numeric_limits<double>::max();
+      timeRankMin.push_back(in);
+      count.push_back(timerCount);
+      threads.push_back(timerThreads);
+      threadImbalance.push_back(present ? timerThreadImbalance : 0.0);
+      in.val = present ? timerThreadImbalance : -1.0;
+      threadImbalanceRank.push_back(in);
+      in.val = present ? timerThreadImbalance : std::numeric_limits<double>::max();
+      threadImbalanceRankMin.push_back(in);
+      workUnits.push_back(timerWorkUnits);
+      report.stats.parentIndex.push_back(timerParentIndex);
+      const bool hasExclusive = present && timerExclusiveTime >= 0.0;
+      exclusiveTime.push_back(hasExclusive ? timerExclusiveTime : 0.0);
+      in.val = hasExclusive ? timerExclusiveTime : -1.0;
+      exclusiveTimeRank.push_back(in);
+      exclusiveThreadImbalance.push_back(hasExclusive ? timerExclusiveThreadImbalance : 0.0);
+      in.val = hasExclusive ? timerExclusiveThreadImbalance : -1.0;
+      exclusiveThreadImbalanceRank.push_back(in);
+   };
 
    //first time we call  this function
-   if(id==0){
+   if(index==0){
       time.clear();
       timeRank.clear();
+      timeRankMin.clear();
       count.clear();
       threads.clear();
+      ranks.clear();
       threadImbalance.clear();
       threadImbalanceRank.clear();
+      threadImbalanceRankMin.clear();
       workUnits.clear();
-      parentIndices.clear();
-      stats.id.clear();
-      stats.level.clear();
+      exclusiveTime.clear();
+      exclusiveTimeRank.clear();
+      exclusiveThreadImbalance.clear();
+      exclusiveThreadImbalanceRank.clear();
+      report.stats.id.clear();
+      report.stats.level.clear();
+      report.stats.parentIndex.clear();
    }
          
    //collect statistics
+   const int id = localIds[index];
+   const bool present = id >= 0;
+   currentIndex=report.stats.id.size();         
+   double currentTime = present ? getTime(id) : 0.0;
+   double currentExclusiveTime = 0.0;
+   double currentExclusiveImbalance = 0.0;
+   report.stats.id.push_back(index);
+   report.stats.level.push_back(report.dictionary[index].level);
+   if(present) {
+      double max, min;
+      int nThreads;
+      getExclusiveTimeStatistics(id, currentExclusiveTime, max, min, nThreads);
+      currentExclusiveImbalance = getExclusiveTimeImbalance(id);
+      addValues(true, currentTime, (*this)[id].getAverageCount(), (*this)[id].getThreads(),
+                (*this)[id].getTimeImbalance(), (*this)[id].getAverageWorkUnits(), parentIndex,
+                currentExclusiveTime, currentExclusiveImbalance);
+   }
+   else
+      addValues(false, 0.0, 0, 0, 0.0, 0.0, parentIndex, -1.0, -1.0);
 
-   currentIndex=stats.id.size();         
-   double currentTime=getTime(id);
-   stats.id.push_back(id);
-   stats.level.push_back((*this)[id].getLevel());   
-   time.push_back(currentTime);
-   in.val=currentTime;
-   in.rank=reportRank;
-   timeRank.push_back(in);
-   count.push_back((*this)[id].getAverageCount());
-   threads.push_back((*this)[id].getThreads());
-   in.val = (*this)[id].getTimeImbalance();
-   in.rank = reportRank;
-   threadImbalance.push_back(in.val);
-   threadImbalanceRank.push_back(in);
-   workUnits.push_back((*this)[id].getAverageWorkUnits());
-   parentIndices.push_back(parentIndex);
-         
    double childTime=0;
    //collect data for children. Also compute total time spent in children
-   for(auto &childId: (*this)[id].getChildIds()) {
-      childTime+=(*this)[childId].getAverageTime();
-      collectTimerStats(reportRank, childId, currentIndex);
+   for(auto &childIndex: report.dictionary[index].childIndices) {
+      if(present && localIds[childIndex] >= 0)
+         childTime+=(*this)[localIds[childIndex]].getAverageTime();
+      collectTimerStats(reportRank, childIndex, currentIndex);
    }
    
-   if((*this)[id].getChildIds().size()>0){
+   if(report.dictionary[index].childIndices.size()>0){
       //Added timings for other time. These are assigned id=-1
-      stats.id.push_back(-1);
-      stats.level.push_back((*this)[(*this)[id].getChildIds()[0]].getLevel()); //same level as children
-      time.push_back(currentTime-childTime);
-      in.val=currentTime-childTime;
-      in.rank=reportRank;
-      timeRank.push_back(in);
-      count.push_back((*this)[id].getAverageCount());
-      threads.push_back((*this)[id].getThreads());
-      //TODO - cannot yet compute thread imbalance for other timer 
-      in.val = -1.0;
-      in.rank = reportRank;
-      threadImbalance.push_back(in.val);
-      threadImbalanceRank.push_back(in);
-      workUnits.push_back(-1.0);
-      parentIndices.push_back(currentIndex);
+      report.stats.id.push_back(-1);
+      report.stats.level.push_back(report.dictionary[index].level + 1); //same level as children
+      //the thread imbalance of other time is that of the exclusive
+      //time of the parent
+      if(present)
+         addValues(true, currentTime-childTime, (*this)[id].getAverageCount(), (*this)[id].getThreads(),
+                   currentExclusiveImbalance, -1.0, currentIndex, -1.0, -1.0);
+      else
+         addValues(false, 0.0, 0, 0, 0.0, 0.0, currentIndex, -1.0, -1.0);
    }
          
-   //End of function for id=0, we have now collected all timer data.
+   //End of function for index=0, we have now collected all timer data.
    //compute statistics now
-   if(id==0){
+   if(index==0){
       int nTimers=time.size(); //note, this also includes the "other"
                                //timers
+      std::vector<double> workUnitsMin;
       if(rankInPrint == 0){
-         std::vector<double> workUnitsMin;
-         stats.timeSum.resize(nTimers);
-         stats.timeMax.resize(nTimers);
-         stats.timeMin.resize(nTimers);
-         stats.workUnitsSum.resize(nTimers);
-         stats.hasWorkUnits.resize(nTimers);
+         report.stats.ranksSum.resize(nTimers);
+         report.stats.timeSum.resize(nTimers);
+         report.stats.timeMax.resize(nTimers);
+         report.stats.timeMin.resize(nTimers);
+         report.stats.timeSketch.resize(nTimers);
+         report.stats.nodesSum.resize(nTimers);
+         report.stats.nodeTimeSum.resize(nTimers);
+         report.stats.nodeTimeMax.resize(nTimers);
+         report.stats.workUnitsSum.resize(nTimers);
          workUnitsMin.resize(nTimers);
-         stats.countSum.resize(nTimers);
-         stats.threadsSum.resize(nTimers);
-         stats.threadImbalanceSum.resize(nTimers);
-         stats.threadImbalanceMax.resize(nTimers);
-         stats.threadImbalanceMin.resize(nTimers);
-
-
-         stats.timeTotalFraction.resize(nTimers);
-         stats.timeParentFraction.resize(nTimers);
+         report.stats.countSum.resize(nTimers);
+         report.stats.threadsSum.resize(nTimers);
+         report.stats.threadImbalanceSum.resize(nTimers);
+         report.stats.threadImbalanceMax.resize(nTimers);
+         report.stats.threadImbalanceMin.resize(nTimers);
+         report.stats.exclusiveTimeSum.resize(nTimers);
+         report.stats.exclusiveTimeMax.resize(nTimers);
+         report.stats.exclusiveThreadImbalanceSum.resize(nTimers);
+         report.stats.exclusiveThreadImbalanceMax.resize(nTimers);
+      }
 
+      //Time and participating processes are first summed within each
+      //node, the node sums then give both the total sums and the
+      //per-node averages. Output std::vectors are only used on rank 0
+      //of printComm
+      std::vector<double> nodeTime(nTimers);
+      std::vector<int> nodeRanks(nTimers);
+      reducer.reduceInNode(&(time[0]),&(nodeTime[0]),nTimers,MPI_DOUBLE,MPI_SUM);
+      reducer.reduceInNode(&(ranks[0]),&(nodeRanks[0]),nTimers,MPI_INT,MPI_SUM);
+      if(reducer.isLeader()) {
+         std::vector<double> nodeAverage(nTimers);
+         std::vector<doubleRankPair> nodeAverageRank(nTimers);
+         std::vector<int> nodes(nTimers);
+         for(int i = 0; i < nTimers; i++){
+            nodes[i] = nodeRanks[i] > 0 ? 1 : 0;
+            nodeAverage[i] = nodeRanks[i] > 0 ? nodeTime[i] / nodeRanks[i] : 0.0;
+            nodeAverageRank[i].val = nodeRanks[i] > 0 ? nodeAverage[i] : -1.0;
+            nodeAverageRank[i].rank = reportRank; //node is identified by its leader
+         }
+         reducer.reduceOverLeaders(&(nodeTime[0]),report.stats.timeSum.data(),nTimers,MPI_DOUBLE,MPI_SUM);
+         reducer.reduceOverLeaders(&(nodeRanks[0]),report.stats.ranksSum.data(),nTimers,MPI_INT,MPI_SUM);
+         reducer.reduceOverLeaders(&(nodes[0]),report.stats.nodesSum.data(),nTimers,MPI_INT,MPI_SUM);
+         reducer.reduceOverLeaders(&(nodeAverage[0]),report.stats.nodeTimeSum.data(),nTimers,MPI_DOUBLE,MPI_SUM);
+         reducer.reduceOverLeaders(&(nodeAverageRank[0]),report.stats.nodeTimeMax.data(),nTimers,MPI_DOUBLE_INT,MPI_MAXLOC);
+      }
 
+      reducer.reduce(&(timeRank[0]),report.stats.timeMax.data(),nTimers,MPI_DOUBLE_INT,MPI_MAXLOC);
+      reducer.reduce(&(timeRankMin[0]),report.stats.timeMin.data(),nTimers,MPI_DOUBLE_INT,MPI_MINLOC);
 
-         MPI_Reduce(&(time[0]),&(stats.timeSum[0]),nTimers,MPI_DOUBLE,MPI_SUM,0,printComm);
-         MPI_Reduce(&(timeRank[0]),&(stats.timeMax[0]),nTimers,MPI_DOUBLE_INT,MPI_MAXLOC,0,printComm);
-         MPI_Reduce(&(timeRank[0]),&(stats.timeMin[0]),nTimers,MPI_DOUBLE_INT,MPI_MINLOC,0,printComm);
-         
-         MPI_Reduce(&(workUnits[0]),&(stats.workUnitsSum[0]),nTimers,MPI_DOUBLE,MPI_SUM,0,printComm);
-         MPI_Reduce(&(workUnits[0]),&(workUnitsMin[0]),nTimers,MPI_DOUBLE,MPI_MIN,0,printComm);
-         MPI_Reduce(&(count[0]),&(stats.countSum[0]),nTimers,MPI_INT64_T,MPI_SUM,0,printComm);
-         MPI_Reduce(&(threads[0]),&(stats.threadsSum[0]),nTimers,MPI_INT,MPI_SUM,0,printComm);
-
-         MPI_Reduce(&(threadImbalance[0]),&(stats.threadImbalanceSum[0]), nTimers, MPI_DOUBLE, MPI_SUM, 0, printComm);
-         MPI_Reduce(&(threadImbalanceRank[0]),&(stats.threadImbalanceMax[0]), nTimers, MPI_DOUBLE_INT, MPI_MAXLOC, 0, printComm);
-         MPI_Reduce(&(threadImbalanceRank[0]),&(stats.threadImbalanceMin[0]), nTimers, MPI_DOUBLE_INT, MPI_MINLOC, 0, printComm);
-               
-         for(int i=0;i<nTimers;i++){
-            if(stats.workUnitsSum[i] <= 0)
-               stats.hasWorkUnits[i] = false;
-            else
-               stats.hasWorkUnits[i] = true;
-                  
-            if(stats.timeSum[0]>0)
-               stats.timeTotalFraction[i]=stats.timeSum[i]/stats.timeSum[0];
-            else
-               stats.timeTotalFraction[i]=0.0;
-                  
-            if(stats.timeSum[parentIndices[i]]>0)
-               stats.timeParentFraction[i]=stats.timeSum[i]/stats.timeSum[parentIndices[i]];
-            else
-               stats.timeParentFraction[i]=0.0;
+      //the distribution of time over processes is reduced as
+      //fixed-size sketches. Merging is only approximately commutative,
+      //so the operator is registered as non-commutative to get the same
+      //result every time. Left empty if disabled.
+      if(isQuantilesEnabled()) {
+         std::vector<QuantileSketch> timeSketch(nTimers);
+         for(int i = 0; i < nTimers; i++){
+            if(ranks[i] > 0)
+               timeSketch[i].add(time[i]);
          }
+         if(sketchType == MPI_DATATYPE_NULL) {
+            MPI_Type_contiguous(sizeof(QuantileSketch), MPI_BYTE, &sketchType);
+            MPI_Type_commit(&sketchType);
+            MPI_Op_create(mergeQuantileSketches, 0, &sketchOp);
+         }
+         reducer.reduce(&(timeSketch[0]),report.stats.timeSketch.data(),nTimers,sketchType,sketchOp);
       }
-      else{
-         //not masterank, we do not resize and use stats std::vectors
-         MPI_Reduce(&(time[0]),NULL,nTimers,MPI_DOUBLE,MPI_SUM,0,printComm);
-         MPI_Reduce(&(timeRank[0]),NULL,nTimers,MPI_DOUBLE_INT,MPI_MAXLOC,0,printComm);
-         MPI_Reduce(&(timeRank[0]),NULL,nTimers,MPI_DOUBLE_INT,MPI_MINLOC,0,printComm);
-               
-         MPI_Reduce(&(workUnits[0]),NULL,nTimers,MPI_DOUBLE,MPI_SUM,0,printComm);
-         MPI_Reduce(&(workUnits[0]),NULL,nTimers,MPI_DOUBLE,MPI_MIN,0,printComm);
-         MPI_Reduce(&(count[0]),NULL,nTimers,MPI_INT64_T,MPI_SUM,0,printComm);               
-         MPI_Reduce(&(threads[0]),NULL,nTimers,MPI_INT,MPI_SUM,0,printComm);
-
-         MPI_Reduce(&(threadImbalance[0]), NULL, nTimers, MPI_DOUBLE, MPI_SUM, 0, printComm);
-         MPI_Reduce(&(threadImbalanceRank[0]), NULL, nTimers, MPI_DOUBLE_INT, MPI_MAXLOC, 0, printComm);
-         MPI_Reduce(&(threadImbalanceRank[0]), NULL, nTimers, MPI_DOUBLE_INT, MPI_MINLOC, 0, printComm);
-      }
+         
+      reducer.reduce(&(workUnits[0]),report.stats.workUnitsSum.data(),nTimers,MPI_DOUBLE,MPI_SUM);
+      reducer.reduce(&(workUnits[0]),workUnitsMin.data(),nTimers,MPI_DOUBLE,MPI_MIN);
+      reducer.reduce(&(count[0]),report.stats.countSum.data(),nTimers,MPI_INT64_T,MPI_SUM);
+      reducer.reduce(&(threads[0]),report.stats.threadsSum.data(),nTimers,MPI_INT,MPI_SUM);
+
+      reducer.reduce(&(threadImbalance[0]),report.stats.threadImbalanceSum.data(), nTimers, MPI_DOUBLE, MPI_SUM);
+      reducer.reduce(&(threadImbalanceRank[0]),report.stats.threadImbalanceMax.data(), nTimers, MPI_DOUBLE_INT, MPI_MAXLOC);
+      reducer.reduce(&(threadImbalanceRankMin[0]),report.stats.threadImbalanceMin.data(), nTimers, MPI_DOUBLE_INT, MPI_MINLOC);
+
+      reducer.reduce(&(exclusiveTime[0]),report.stats.exclusiveTimeSum.data(), nTimers, MPI_DOUBLE, MPI_SUM);
+      reducer.reduce(&(exclusiveTimeRank[0]),report.stats.exclusiveTimeMax.data(), nTimers, MPI_DOUBLE_INT, MPI_MAXLOC);
+      reducer.reduce(&(exclusiveThreadImbalance[0]),report.stats.exclusiveThreadImbalanceSum.data(), nTimers, MPI_DOUBLE, MPI_SUM);
+      reducer.reduce(&(exclusiveThreadImbalanceRank[0]),report.stats.exclusiveThreadImbalanceMax.data(), nTimers, MPI_DOUBLE_INT, MPI_MAXLOC);
+
       //clear temporary data structures
+      localTime = time;
+      localRanks = ranks;
       time.clear();
       timeRank.clear();
+      timeRankMin.clear();
       count.clear();
       threads.clear();
+      ranks.clear();
       threadImbalance.clear();
       threadImbalanceRank.clear();
+      threadImbalanceRankMin.clear();
       workUnits.clear();
-      parentIndices.clear();
+      exclusiveTime.clear();
+      exclusiveTimeRank.clear();
+      exclusiveThreadImbalance.clear();
+      exclusiveThreadImbalanceRank.clear();
    }
 }
 
@@ -270,364 +367,458 @@ void ParallelTimerTree::collectTimerStats(int reportRank, int id, int parentInde
 
 
 
-////-------------------------------------------------------------------------
-///  PRINT functions
-
-////-------------------------------------------------------------------------      
-
-// Creating std::map of group names to group one-letter ID
-// We assume same timers exists in all timer std::vectors, so can use just one here
-void ParallelTimerTree::getGroupIds(std::map<std::string, std::string> &groupIds){
-   groupIds.clear();
-   //add groups to std::map
-   for(unsigned int id=0; id< size(); id++) {
-      for(auto &group : (*this)[id].getGroups()){
-         groupIds[group] = group;
+namespace {
+   //live counters are published into shared memory if PHIPROF_SHM is
+   //set, and not 0, or if the metrics file is written from them
+   bool isSharedCounters(){
+      if(MetricsExporter::isEnabled())
+         return true;
+      const char *shmVariable = getenv("PHIPROF_SHM");
+      return shmVariable != NULL && strcmp(shmVariable, "0") != 0;
+   }
+
+   //number of timers published, PHIPROF_SHM_TIMERS (default 1024)
+   int getSharedTimers(){
+      const char *timersVariable = getenv("PHIPROF_SHM_TIMERS");
+      const int timers = timersVariable != NULL ? atoi(timersVariable) : 0;
+      return timers > 0 ? timers : 1024;
+   }
+
+   //reports of the time since the previous print are written if
+   //PHIPROF_PRINT_DELTA is set, and not 0
+   bool isPrintDelta(){
+      const char *deltaVariable = getenv("PHIPROF_PRINT_DELTA");
+      return deltaVariable != NULL && strcmp(deltaVariable, "0") != 0;
+   }
+
+   //sum += a - b for the counters of each timer, timers missing from b
+   //(created later) are taken as zero
+   void addCounters(std::vector<TimerData::Counters> &sum, const std::vector<TimerData::Counters> &a,
+                    const std::vector<TimerData::Counters> &b){
+      sum.resize(std::max(sum.size(), a.size()));
+      for(unsigned int id = 0; id < a.size(); id++) {
+         sum[id].add(a[id], 1);
+         if(id < b.size())
+            sum[id].add(b[id], -1);
       }
    }
-   //assign letters
-   int character = 65; // ASCII A, TODO skip after Z to a, see ascii table
-   for(std::map<std::string, std::string>::const_iterator group = groupIds.begin();
-       group != groupIds.end(); ++group) {
-      groupIds[group->first] = character++;
+}
+
+//readers of the shared counters follow the profile clock
+void ParallelTimerTree::publishClock(){
+   double pauseTime, pausedTime;
+   TimerData::getClockState(pauseTime, pausedTime);
+   sharedSegment.setClock(pauseTime, pausedTime);
+}
+
+bool ParallelTimerTree::initialize(){
+   const bool success = TimerTree::initialize();
+   //numThreads is set in TimerTree::initialize
+#pragma omp single
+   {
+      messages.resize(numThreads);
+      //the rank is only used in the file names of the local reports
+      int mpiInitialized, worldRank = 0;
+      MPI_Initialized(&mpiInitialized);
+      if(mpiInitialized)
+         MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+      localReport.start(*this, worldRank);
+      if(isSharedCounters() && !sharedSegment.isOpen() &&
+         sharedSegment.create(worldRank, SharedCounters::getJobId(), getSharedTimers(), numThreads, TimerData::getTime()))
+         setSharedCounters(&sharedSegment);
+      if(sharedSegment.isOpen())
+         metricsExporter.start(SharedCounters::getJobId());
    }
+   return success;
 }
 
+ParallelTimerTree::~ParallelTimerTree(){
+   //timers stop publishing before the segment is removed
+   setSharedCounters(NULL);
+}
 
+bool ParallelTimerTree::reset(){
+   if(!isInitialized())
+      return false;
+   resetTime(TimerData::getTime());
+   for(auto &phase : phases)
+      phase.counters.clear();
+   //cleared counters are taken as zero
+   phaseStartCounters.clear();
+   printCounters.clear();
+   for(auto &threadMessages : messages)
+      threadMessages.clear();
+   return true;
+}
 
+bool ParallelTimerTree::pause(){
+   if(!TimerData::pause()) {
+      std::cerr << "PHIPROF-ERROR: phiprof is already paused" << std::endl;
+      return false;
+   }
+   publishClock();
+   return true;
+}
 
-//print groups
-bool ParallelTimerTree::printGroupStatistics(double minFraction,
-                                             const std::map<std::string, std::string> &groupIds,
-                                             std::ofstream &output){
-   
-   PrettyPrintTable table;
-   table.addTitle("Groups");
-   
-   
-   //print heders
-   table.addHorizontalLine();      
-   //row1
-   table.addElement("",2);
-   table.addElement("Time (s)",6);
-   table.addHorizontalLine();
-   //row2
-   table.addElement("Group",1);
-   table.addElement("Name",1);
-   table.addElement("Avg",1);      
-   table.addElement("% of total",1);      
-   table.addElement("Max time,rank",2);      
-   table.addElement("Min time,rank",2);      
-   table.addHorizontalLine();
-
-   for(unsigned int i=0;i<groupStats.name.size();i++){            
-      if(minFraction<=groupStats.timeTotalFraction[i]){
-         std::string groupId= groupIds.count(groupStats.name[i]) ? groupIds.find(groupStats.name[i])->second : std::string();
-         table.addRow();
-         table.addElement(groupId);
-         table.addElement(groupStats.name[i]);
-         if (nProcessesInPrint > 0)
-            table.addElement(groupStats.timeSum[i]/nProcessesInPrint);
-         else
-            table.addElement(0.0);
-         table.addElement(100.0*groupStats.timeTotalFraction[i]);
-         table.addElement(groupStats.timeMax[i].val);
-         table.addElement(groupStats.timeMax[i].rank);
-         table.addElement(groupStats.timeMin[i].val);
-         table.addElement(groupStats.timeMin[i].rank);
-      }
+bool ParallelTimerTree::resume(){
+   if(!TimerData::resume()) {
+      std::cerr << "PHIPROF-ERROR: phiprof is not paused" << std::endl;
+      return false;
    }
-   table.addHorizontalLine();
-   table.print(output);
+   publishClock();
    return true;
 }
-         
-      
-      
-//print out global timers
-//If any labels differ, then this print will deadlock. Only call it with a communicator that is guaranteed to be consistent on all processes.
-bool ParallelTimerTree::printTimers(double minFraction, const std::map<std::string, std::string>& groupIds, std::ofstream &output){
-   if(rankInPrint==0){
-      PrettyPrintTable table;
-      //print Title
-      std::stringstream buffer;
-      if(minFraction > 0.0 ) {
-         
-         buffer << "Timers with more than " << minFraction * 100 <<"% of total time. ";
-         buffer <<  "Set of identical timers has "<< nProcessesInPrint << " processes";
-         
-#ifdef _OPENMP
-         buffer << " with up to " << omp_get_max_threads() << " threads each";
-#endif
-         buffer << ".";
+
+//The counters of a phase are the sum of the differences of the
+//counters at the start and end of each of its windows, so that the
+//timers themselves keep accumulating over all phases
+bool ParallelTimerTree::setPhase(const std::string &name){
+   if(!isInitialized())
+      return false;
+   if(name.empty()) {
+      std::cerr << "PHIPROF-ERROR: empty phase name" << std::endl;
+      return false;
+   }
+   std::vector<TimerData::Counters> counters;
+   closeActiveIntervals();
+   getCounters(counters);
+   if(currentPhase >= 0)
+      addCounters(phases[currentPhase].counters, counters, phaseStartCounters);
+   phaseStartCounters.swap(counters);
+
+   for(currentPhase = 0; currentPhase < (int)phases.size(); currentPhase++) {
+      if(phases[currentPhase].name == name)
+         return true;
+   }
+   phases.push_back(Phase{name, {}});
+   return true;
+}
+
+
+//Write the messages sent in the timers with most bytes sent into a
+//CommunicationMatrix file with one collective MPI-IO write. Collective
+//over printComm.
+bool ParallelTimerTree::printCommunicationMatrix(const std::string &fileName){
+   const int nIndices = report.dictionary.size();
+   int worldRank, nTimers;
+   int mySuccess, success;
+   MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+
+   //sum the messages of all threads, (dictionary index, destination) -> messages
+   std::vector<int> indices(size(), -1);
+   std::map<std::pair<int, int>, Messages> localMessages;
+   std::vector<double> bytes(nIndices, 0.0);
+   std::vector<double> totalBytes(nIndices, 0.0);
+   for(int index = 0; index < nIndices; index++) {
+      if(localIds[index] >= 0)
+         indices[localIds[index]] = index;
+   }
+   for(const auto &threadMessages: messages) {
+      for(const auto &sent: threadMessages) {
+         //timers without an index in the report dictionary are left out
+         const size_t id = sent.first >> 32;
+         const int index = id < indices.size() ? indices[id] : -1;
+         if(index < 0)
+            continue;
+         const int destination = static_cast<int32_t>(sent.first & 0xffffffff);
+         Messages &sum = localMessages[std::make_pair(index, destination)];
+         sum.count += sent.second.count;
+         sum.bytes += sent.second.bytes;
+         bytes[index] += sent.second.bytes;
       }
-      else{
-         buffer << "All timers. Set of identical timers has "<< nProcessesInPrint <<" processes";
-#ifdef _OPENMP
-         buffer << " with up to " << omp_get_max_threads() << " threads each";
-#endif
-         buffer << ".";
+   }
+
+   //timers with most bytes sent over all processes
+   std::vector<int> timerIndices;
+   reducer.reduce(bytes.data(), totalBytes.data(), nIndices, MPI_DOUBLE, MPI_SUM);
+   if(rankInPrint == 0) {
+      for(int index = 0; index < nIndices; index++) {
+         if(totalBytes[index] > 0.0)
+            timerIndices.push_back(index);
       }
-      table.addTitle(buffer.str());
-      buffer.str("");
-      
-      //print heders
-      table.addHorizontalLine();      
-      //row1
-      table.addElement("",4);
-      table.addElement("Count",1);
-      table.addElement("Process time",3);
-      table.addElement("Thread imbalances",3);
-      table.addElement("Workunits",1);      
-      table.addHorizontalLine();
-      //row2
-      table.addElement("Id",1);
-      table.addElement("Lvl",1);
-      table.addElement("Grp",1);
-      table.addElement("Name",1);
-      table.addElement("Avg",1);
-      table.addElement("Avg (s)",1);      
-      table.addElement("Time %",1);      
-      table.addElement("Imb %",1);
-      table.addElement("No",1);            
-      table.addElement("Avg %",1);
-      table.addElement("Max %",1);
-
-      table.addElement("Avg",1);       
-      table.addHorizontalLine();
-
-      //print out all labels recursively
-      for(unsigned int i = 1; i < stats.id.size(); i++){
-         int id = stats.id[i];
-         if(stats.timeTotalFraction[i] >= minFraction){
-            //print timer if enough time is spent in it
-            if(id != -1) 
-               table.addElement(id);
-            else
-               table.addElement("");
-            
-            table.addElement(stats.level[i]);
-            if(id != -1) {
-               //normal timer, not "other" timer
-               //get and print group ids
-               buffer.str("");
-               for(auto &group : (*this)[id].getGroups()){
-                  std::string groupId=groupIds.count(group) ? groupIds.find(group)->second : std::string();
-                  buffer << groupId;
-               }
-               table.addElement(buffer.str());
-               table.addElement((*this)[id].getLabel(), 1, stats.level[i]-1);
-            }
-            else{
-               table.addElement(""); // no groups
-               table.addElement("Other", 1, stats.level[i]-1);
-            }
+      std::stable_sort(timerIndices.begin(), timerIndices.end(),
+                       [&](int a, int b) { return totalBytes[a] > totalBytes[b]; });
+      if(timerIndices.size() > (size_t)CommunicationMatrix::getMaxTimers())
+         timerIndices.resize(CommunicationMatrix::getMaxTimers());
+      nTimers = timerIndices.size();
+   }
+   MPI_Bcast(&nTimers, 1, MPI_INT, 0, printComm);
+   timerIndices.resize(nTimers);
+   MPI_Bcast(timerIndices.data(), nTimers, MPI_INT, 0, printComm);
 
-	    
-            if(nProcessesInPrint>0)
-               table.addElement(stats.countSum[i] / nProcessesInPrint);
-            else
-               table.addElement(0.0);
-            
-            if(nProcessesInPrint>0)
-               table.addElement(stats.timeSum[i] / nProcessesInPrint);
-            else
-               table.addElement(0.0);
-            
-            table.addElement(100.0 * stats.timeParentFraction[i]);
-            
-            if(nProcessesInPrint > 1 && stats.timeMax[i].val != 0.0) {
-               double imbTime = stats.timeMax[i].val - stats.timeSum[i]/nProcessesInPrint;
-               table.addElement(100 * imbTime / stats.timeMax[i].val  * ( nProcessesInPrint /(nProcessesInPrint - 1 )));
-            }
-            else{
-               table.addElement(0.0);
-            }
+   std::vector<int> timers(nIndices, -1);
+   std::vector<std::string> labels;
+   for(int timer = 0; timer < nTimers; timer++) {
+      timers[timerIndices[timer]] = timer;
+      labels.push_back(report.dictionary.getFullLabel(timerIndices[timer]));
+   }
+   std::vector<std::vector<CommunicationMatrix::Entry>> entries(nTimers);
+   for(const auto &sent: localMessages) {
+      const int timer = timers[sent.first.first];
+      if(timer >= 0) {
+         CommunicationMatrix::Entry entry;
+         entry.timer = timer;
+         entry.source = worldRank;
+         entry.destination = sent.first.second;
+         entry.reserved = 0;
+         entry.count = sent.second.count;
+         entry.bytes = sent.second.bytes;
+         entries[timer].push_back(entry);
+      }
+   }
 
-            if(nProcessesInPrint>0)
-               table.addElement(stats.threadsSum[i]/nProcessesInPrint);
-            else
-               table.addElement(0.0);
-            
-            if(stats.threadsSum[i]/nProcessesInPrint > 1.0 && stats.threadImbalanceMax[i].val >= 0.0) {
-               table.addElement(100.0 * stats.threadImbalanceSum[i]/nProcessesInPrint);
-               table.addElement(100.0 * stats.threadImbalanceMax[i].val);
-            }
-            else {
-               //not threaded or an "other" counter for which thread
-               //imbalance is not computed
-               table.addElement("");
-               table.addElement("");
-            }
-            if(stats.hasWorkUnits[i] && id != -1){
-               buffer.str("");
-               
-               //print if units defined for all processes
-               //note how the total rate is computed. This is to avoid one process with little data to     
-               //skew results one way or the other                        
-               if(stats.timeSum[i]>0){
-                  buffer << std::setprecision(4) << stats.workUnitsSum[i]/stats.timeSum[i];
-               }
-               else if (stats.workUnitsSum[i]>0){
-                  //time is zero
-                  buffer << "inf";
-               }
-               else {
-                  //zero time zero units
-                  buffer << 0;
-               }
-               buffer << " "<< (*this)[id].getWorkUnitLabel()<<"/s";                     
-               table.addElement(buffer.str());
+   //the entries of a timer are stored in the rank order of printComm,
+   //after the entries of the previous timers
+   std::vector<int64_t> nEntries(nTimers), entryOffsets(nTimers, 0), totalEntries(nTimers);
+   for(int timer = 0; timer < nTimers; timer++)
+      nEntries[timer] = entries[timer].size();
+   MPI_Exscan(nEntries.data(), entryOffsets.data(), nTimers, MPI_INT64_T, MPI_SUM, printComm);
+   if(rankInPrint == 0)
+      entryOffsets.assign(nTimers, 0); //undefined on rank 0 after exscan
+   MPI_Allreduce(nEntries.data(), totalEntries.data(), nTimers, MPI_INT64_T, MPI_SUM, printComm);
 
-            }
-            table.addRow();
-         }
-      }
-      
-      table.addHorizontalLine();
-      table.print(output);
+   CommunicationMatrix::Header header;
+   std::vector<char> labelBuffer;
+   CommunicationMatrix::serializeLabels(labels, labelBuffer);
+   int64_t timerOffset = 0;
+   for(int timer = 0; timer < nTimers; timer++)
+      timerOffset += totalEntries[timer];
+   CommunicationMatrix::setHeader(header, nTimers, labelBuffer.size(), timerOffset);
+
+   std::vector<char> buffer;
+   std::vector<int> blockLengths;
+   std::vector<MPI_Aint> blockOffsets;
+   auto addBlock = [&](MPI_Aint offset, const void *data, size_t blockBytes) {
+      const char *bytePointer = static_cast<const char*>(data);
+      blockOffsets.push_back(offset);
+      blockLengths.push_back(blockBytes);
+      buffer.insert(buffer.end(), bytePointer, bytePointer + blockBytes);
+   };
+   if(rankInPrint == 0) {
+      addBlock(0, &header, sizeof(header));
+      addBlock(sizeof(header), labelBuffer.data(), labelBuffer.size());
    }
-   return true;
+   timerOffset = 0;
+   for(int timer = 0; timer < nTimers; timer++) {
+      addBlock(sizeof(header) + labelBuffer.size() +
+               (timerOffset + entryOffsets[timer]) * sizeof(CommunicationMatrix::Entry),
+               entries[timer].data(), entries[timer].size() * sizeof(CommunicationMatrix::Entry));
+      timerOffset += totalEntries[timer];
+   }
+
+   mySuccess = writeBlocks(printComm, fileName, buffer, blockLengths, blockOffsets);
+   MPI_Allreduce(&mySuccess, &success, 1, MPI_INT, MPI_MIN, printComm);
+   if(!success && rankInPrint == 0)
+      std::cerr << "PHIPROF-ERROR: Could not write communication matrix into " << fileName << std::endl;
+   return success;
 }
 
 
-//print out global timers
-//If any labels differ, then this print will deadlock. Only call it with a communicator that is guaranteed to be consistent on all processes.
-bool ParallelTimerTree::printTimersDetailed(double minFraction, const std::map<std::string, std::string>& groupIds, std::ofstream &output){
-   if(rankInPrint==0){
-      PrettyPrintTable table;
+//Select the timers with most time on rank 0 of printComm, and share
+//them with all processes. Collective over printComm.
+void ParallelTimerTree::selectRankTimesRows(){
+   int nColumns;
+   if(rankInPrint == 0) {
+      report.selectRankTimesRows(TimerReport::getHeatmapTimers());
+      nColumns = report.rankTimesRows.size();
+   }
+   MPI_Bcast(&nColumns, 1, MPI_INT, 0, printComm);
+   report.rankTimesRows.resize(nColumns);
+   MPI_Bcast(report.rankTimesRows.data(), nColumns, MPI_INT, 0, printComm);
+}
 
-      //print Title
-      std::stringstream buffer;
-      if(minFraction > 0.0 ) {
-         
-         buffer << "Timers with more than " << minFraction * 100 <<"% of total time. ";
-         buffer <<  "Set of identical timers has "<< nProcessesInPrint << " processes";
-         
-#ifdef _OPENMP
-         buffer << " with up to " << omp_get_max_threads() << " threads each";
-#endif
-         buffer << ".";
+//Gather the time of each process in the timers with most time into
+//the report, for the heatmap prints. Collective over printComm.
+void ParallelTimerTree::collectRankTimes(int reportRank){
+   selectRankTimesRows();
+   const int nColumns = report.rankTimesRows.size();
+
+   //first column is the rank
+   std::vector<float> rankTimes;
+   rankTimes.push_back(reportRank);
+   for(auto row: report.rankTimesRows)
+      rankTimes.push_back(localTime[row]);
+   if(rankInPrint == 0)
+      report.rankTimes.resize(nProcessesInPrint * (nColumns + 1));
+   MPI_Gather(rankTimes.data(), nColumns + 1, MPI_FLOAT,
+              report.rankTimes.data(), nColumns + 1, MPI_FLOAT, 0, printComm);
+}
+
+
+//Gather the time of the process with most total time into the
+//report, for flame-max. Only that process contributes to the sum.
+//Collective over printComm.
+void ParallelTimerTree::collectSlowestTimes(int reportRank){
+   const int nRows = localTime.size();
+   int slowestRank;
+   if(rankInPrint == 0)
+      slowestRank = report.stats.timeMax[0].rank;
+   MPI_Bcast(&slowestRank, 1, MPI_INT, 0, printComm);
+   std::vector<double> time(nRows, 0.0);
+   if(reportRank == slowestRank)
+      time = localTime;
+   report.slowestTime.resize(nRows);
+   MPI_Reduce(time.data(), report.slowestTime.data(), nRows, MPI_DOUBLE, MPI_SUM, 0, printComm);
+}
+
+
+//Cluster the processes by their time in the timers with most time
+//(rankTimesRows) with k-means. Each iteration is one allreduce of the
+//cluster sums, so the cost does not depend on the number of
+//processes beyond the reductions. Collective over printComm.
+void ParallelTimerTree::collectClusters(int reportRank){
+   const int maxIterations = 50;
+   selectRankTimesRows();
+   const int nColumns = report.rankTimesRows.size();
+   const int nRows = localTime.size();
+   int nClusters = std::min(TimerReport::getClusters(), nProcessesInPrint);
+
+   std::vector<double> point(nColumns);
+   for(int c = 0; c < nColumns; c++)
+      point[c] = localTime[report.rankTimesRows[c]];
+   auto distance = [&](const double *centroid){
+      double d = 0.0;
+      for(int c = 0; c < nColumns; c++)
+         d += (point[c] - centroid[c]) * (point[c] - centroid[c]);
+      return d;
+   };
+
+   //deterministic farthest-point initialization, the first centroid is
+   //the process with most time in the selected timers
+   std::vector<double> centroids;
+   double minDistance = std::numeric_limits<double>::max();
+   for(int k = 0; k < nClusters; k++){
+      doubleRankPair in, out;
+      if(k == 0) {
+         in.val = 0.0;
+         for(int c = 0; c < nColumns; c++)
+            in.val += point[c];
       }
-      else{
-         buffer << "All timers. Set of identical timers has "<< nProcessesInPrint <<" processes";
-#ifdef _OPENMP
-         buffer << " with up to " << omp_get_max_threads() << " threads each";
-#endif
-         buffer << ".";
+      else {
+         minDistance = std::min(minDistance, distance(centroids.data() + (k - 1) * nColumns));
+         in.val = minDistance;
       }
-      table.addTitle(buffer.str());
-      buffer.str("");
-         
+      in.rank = rankInPrint;
+      MPI_Allreduce(&in, &out, 1, MPI_DOUBLE_INT, MPI_MAXLOC, printComm);
+      if(k > 0 && out.val <= 0.0) {
+         //fewer distinct processes than clusters
+         nClusters = k;
+         break;
+      }
+      centroids.insert(centroids.end(), point.begin(), point.end());
+      MPI_Bcast(centroids.data() + k * nColumns, nColumns, MPI_DOUBLE, out.rank, printComm);
+   }
 
-      
-      //print heders
-      table.addHorizontalLine();      
-      //row1
-      table.addElement("",4);
-      table.addElement("Threads",1);
-      table.addElement("Time (s)",6);
-      table.addElement("Calls",1);
-      table.addElement("Workunit-rate",3);      
-      table.addHorizontalLine();
-      //row2
-      table.addElement("Id",1);
-      table.addElement("Lvl",1);
-      table.addElement("Grp",1);
-      table.addElement("Label",1);
-      table.addElement("Avg",1);
-      table.addElement("Avg",1);      
-      table.addElement("%",1);      
-      table.addElement("Max time,rank",2);      
-      table.addElement("Min time,rank",2);      
-      table.addElement("Avg",1);      
-      table.addElement("Total",1);     
-      table.addElement("Per process",1);       
-      table.addElement("Unit",1);       
-      table.addHorizontalLine();
-
-      //print out all labels recursively
-      for(unsigned int i = 1; i < stats.id.size(); i++){
-         int id = stats.id[i];
-         if(stats.timeTotalFraction[i] >= minFraction){
-            //print timer if enough time is spent in it
-            if(id != -1) 
-               table.addElement(id);
-            else
-               table.addElement("");
-
-            table.addElement(stats.level[i]);
-            if(id != -1) {
-               //normal timer, not "other" timer
-               //get and print group ids
-               buffer.str("");
-               for(auto &group : (*this)[id].getGroups()){
-                  std::string groupId=groupIds.count(group) ? groupIds.find(group)->second : std::string();
-                  buffer << groupId;
-               }
-               table.addElement(buffer.str());
-               table.addElement((*this)[id].getLabel(), 1, stats.level[i]-1);
-            }
-            else{
-               table.addElement(""); // no groups
-               table.addElement("Other", 1, stats.level[i]-1);
-            }
-            if(nProcessesInPrint > 0)
-               table.addElement(stats.threadsSum[i]/nProcessesInPrint);
-            else
-               table.addElement(0.0);
-            if(nProcessesInPrint > 0)
-               table.addElement(stats.timeSum[i]/nProcessesInPrint);
-            else
-               table.addElement(0.0);
-            table.addElement(100.0*stats.timeParentFraction[i]);
-            table.addElement(stats.timeMax[i].val);            
-            table.addElement(stats.timeMax[i].rank);
-            table.addElement(stats.timeMin[i].val);
-            table.addElement(stats.timeMin[i].rank);
-            if(nProcessesInPrint > 0)
-               table.addElement(stats.countSum[i]/nProcessesInPrint);
-            else
-               table.addElement(0.0);
-
-            if(stats.hasWorkUnits[i]){
-               //print if units defined for all processes
-               //note how the total rate is computed. This is to avoid one process with little data to     
-               //skew results one way or the other                        
-               if(stats.timeSum[i]>0){
-                  table.addElement(nProcessesInPrint*(stats.workUnitsSum[i]/stats.timeSum[i]));
-                  table.addElement(stats.workUnitsSum[i]/stats.timeSum[i]);
-               }
-               else if (stats.workUnitsSum[i]>0){
-                  //time is zero
-                  table.addElement("inf");
-                  table.addElement("inf");
-               }
-               else {
-                  //zero time zero units
-                  table.addElement(0);
-                  table.addElement(0);
-               }
-               buffer.str("");
-               buffer << (*this)[id].getWorkUnitLabel()<<"/s";                     
-               table.addElement(buffer.str());
-            }
-            table.addRow();
+   int cluster = -1;
+   std::vector<double> sums((nColumns + 1) * nClusters);
+   std::vector<double> globalSums((nColumns + 1) * nClusters);
+   for(int iteration = 0; iteration < maxIterations; iteration++){
+      int nearest = 0;
+      for(int k = 1; k < nClusters; k++){
+         if(distance(centroids.data() + k * nColumns) < distance(centroids.data() + nearest * nColumns))
+            nearest = k;
+      }
+      int changed = nearest != cluster;
+      int anyChanged;
+      cluster = nearest;
+      MPI_Allreduce(&changed, &anyChanged, 1, MPI_INT, MPI_MAX, printComm);
+      if(!anyChanged)
+         break;
+
+      //sum of the points and number of processes in each cluster
+      std::fill(sums.begin(), sums.end(), 0.0);
+      for(int c = 0; c < nColumns; c++)
+         sums[cluster * (nColumns + 1) + c] = point[c];
+      sums[cluster * (nColumns + 1) + nColumns] = 1.0;
+      MPI_Allreduce(sums.data(), globalSums.data(), sums.size(), MPI_DOUBLE, MPI_SUM, printComm);
+      for(int k = 0; k < nClusters; k++){
+         const double size = globalSums[k * (nColumns + 1) + nColumns];
+         if(size > 0.0) {
+            for(int c = 0; c < nColumns; c++)
+               centroids[k * nColumns + c] = globalSums[k * (nColumns + 1) + c] / size;
          }
       }
-      
-      table.addHorizontalLine();
-      table.print(output);
    }
-   return true;
+
+   //representative is the process closest to the centroid of its cluster
+   std::vector<doubleRankPair> closest(nClusters);
+   std::vector<int> size(nClusters, 0);
+   for(int k = 0; k < nClusters; k++){
+      closest[k].val = k == cluster ? distance(centroids.data() + k * nColumns) : std::numeric_limits<double>::max();
+      closest[k].rank = reportRank;
+   }
+   size[cluster] = 1;
+
+   //time of all timers summed within each cluster
+   std::vector<double> time(nClusters * nRows, 0.0);
+   std::vector<int> ranks(nClusters * nRows, 0);
+   for(int i = 0; i < nRows; i++){
+      time[cluster * nRows + i] = localTime[i];
+      ranks[cluster * nRows + i] = localRanks[i];
+   }
+
+   if(rankInPrint == 0) {
+      report.clusterStats.size.resize(nClusters);
+      report.clusterStats.representative.resize(nClusters);
+      report.clusterStats.timeSum.resize(nClusters * nRows);
+      report.clusterStats.ranksSum.resize(nClusters * nRows);
+   }
+   std::vector<doubleRankPair> representative(nClusters);
+   reducer.reduce(size.data(), report.clusterStats.size.data(), nClusters, MPI_INT, MPI_SUM);
+   reducer.reduce(closest.data(), representative.data(), nClusters, MPI_DOUBLE_INT, MPI_MINLOC);
+   reducer.reduce(time.data(), report.clusterStats.timeSum.data(), nClusters * nRows, MPI_DOUBLE, MPI_SUM);
+   reducer.reduce(ranks.data(), report.clusterStats.ranksSum.data(), nClusters * nRows, MPI_INT, MPI_SUM);
+   if(rankInPrint == 0) {
+      for(int k = 0; k < nClusters; k++)
+         report.clusterStats.representative[k] = representative[k].rank;
+   }
+}
+
+
+//Check that all processes in printComm have the same 64 bit
+//hash. If the 31 bit colors collided, printComm is split further
+//with the upper bits of the hash. Collective over printComm.
+int ParallelTimerTree::verifyPrintCommunicator(uint64_t hash){
+   uint64_t minHash, maxHash;
+   MPI_Allreduce(&hash, &minHash, 1, MPI_UINT64_T, MPI_MIN, printComm);
+   MPI_Allreduce(&hash, &maxHash, 1, MPI_UINT64_T, MPI_MAX, printComm);
+   if(minHash != maxHash) {
+      MPI_Comm splitComm;
+      int result = MPI_Comm_split(printComm, (int)(hash >> 33), 0, &splitComm);
+      if(result != MPI_SUCCESS)
+         return result;
+      MPI_Comm_free(&printComm);
+      printComm = splitComm;
+      MPI_Allreduce(&hash, &minHash, 1, MPI_UINT64_T, MPI_MIN, printComm);
+      MPI_Allreduce(&hash, &maxHash, 1, MPI_UINT64_T, MPI_MAX, printComm);
+   }
+   return minHash == maxHash ? MPI_SUCCESS : MPI_ERR_OTHER;
 }
 
 
 bool ParallelTimerTree::getPrintCommunicator(int &printIndex,int &timersHash){
    int mySuccess=1;
    int success;
-   timersHash=getHash();
+   if(mergeTrees) {
+      //all processes print into the same file, no need to split by hash
+      timersHash = 0;
+      printIndex = 0;
+      MPI_Comm_dup(comm, &printComm);
+      MPI_Comm_rank(printComm,&rankInPrint);
+      MPI_Comm_size(printComm,&nProcessesInPrint);
+      return true;
+   }
+
+   //MPI_Comm_split needs a non-negative color, use 31 bits of the 64
+   //bit hash. Zero is avoided as the communicator of print masters
+   //uses that
+   const uint64_t hash = getHash();
+   timersHash = hash % std::numeric_limits<int>::max();
+   if(timersHash == 0)
+      timersHash = 1;
    int result = MPI_Comm_split(comm, timersHash, 0, &printComm);
+   if(result == MPI_SUCCESS)
+      result = verifyPrintCommunicator(hash);
          
    if (result != MPI_SUCCESS) {
       int error_string_len = MPI_MAX_ERROR_STRING;
@@ -675,75 +866,459 @@ bool ParallelTimerTree::getPrintCommunicator(int &printIndex,int &timersHash){
 
 
 
+//Reuse the print communicators of the previous print if the
+//communicator and the timers are unchanged on all processes. The hash
+//changes whenever timers are added. Collective over comm.
+bool ParallelTimerTree::getCachedPrintCommunicator(int &printIndex){
+   int local[2] = {0, 0}; //same communicator, and also unchanged timers
+   int all[2];
+   if(printCache.valid && printCache.comm == comm) {
+      //the handle may have been freed and reused for another communicator
+      MPI_Group group;
+      int result;
+      MPI_Comm_group(comm, &group);
+      MPI_Group_compare(group, printCache.group, &result);
+      MPI_Group_free(&group);
+      local[0] = result == MPI_IDENT;
+      local[1] = local[0] && printCache.hash == getHash() && printCache.mergeTrees == mergeTrees;
+   }
+   MPI_Allreduce(local, all, 2, MPI_INT, MPI_MIN, comm);
+   if(all[1]) {
+      printIndex = printCache.printIndex;
+      return true;
+   }
+   //The old printComm is a subset of the communicator it was created
+   //from. If that is comm on all processes, all its members are here
+   //and can free it collectively. Otherwise some of them may not take
+   //part in this print, and it is kept until finalize.
+   if(all[0])
+      freePrintCommunicator();
+   else
+      retirePrintCommunicator();
+   return false;
+}
+
+void ParallelTimerTree::cachePrintCommunicator(int printIndex){
+   printCache.valid = true;
+   printCache.comm = comm;
+   MPI_Comm_group(comm, &printCache.group);
+   printCache.hash = getHash();
+   printCache.mergeTrees = mergeTrees;
+   printCache.printIndex = printIndex;
+}
+
+//Collective over the cached printComm
+void ParallelTimerTree::freePrintCommunicator(){
+   if(!printCache.valid)
+      return;
+   reducer.finalize();
+   MPI_Comm_free(&printComm);
+   MPI_Group_free(&printCache.group);
+   printCache.valid = false;
+}
+
+//Keep the cached printComm and its reducer without freeing them, local
+void ParallelTimerTree::retirePrintCommunicator(){
+   if(!printCache.valid)
+      return;
+   retiredPrintCommunicators.push_back(RetiredPrintCommunicator{printComm, reducer});
+   reducer = NodeReducer();
+   MPI_Group_free(&printCache.group);
+   printCache.valid = false;
+}
+
+//The communicators are freed in the order they were created, which is
+//consistent over the processes
+bool ParallelTimerTree::finalize(){
+   for(auto &retired : retiredPrintCommunicators) {
+      retired.reducer.finalize();
+      MPI_Comm_free(&retired.printComm);
+   }
+   retiredPrintCommunicators.clear();
+   freePrintCommunicator();
+   if(sketchType != MPI_DATATYPE_NULL) {
+      MPI_Op_free(&sketchOp);
+      MPI_Type_free(&sketchType);
+   }
+   if(dumpNodeCache.valid) {
+      MPI_Group_free(&dumpNodeCache.group);
+      dumpNodeCache.valid = false;
+   }
+   return true;
+}
+
+//Build the report.dictionary of timers used in the print. Without merging it
+//is the local tree, otherwise the union of the trees of all processes
+//in printComm. Collective over printComm, returns false on all
+//processes if merging failed.
+bool ParallelTimerTree::buildDictionary(){
+   std::vector<int> indices;
+   bool success = true;
+   report.dictionary.clear();
+   report.dictionary.add(*this, indices);
+
+   if(mergeTrees) {
+      success = mergeDictionaries(report.dictionary, printComm);
+      //union contains all local timers, this only returns their indices
+      report.dictionary.add(*this, indices);
+   }
+
+   localIds.assign(report.dictionary.size(), -1);
+   for(unsigned int id = 0; id < indices.size(); id++)
+      localIds[indices[id]] = id;
+   return success;
+}
+
+//Merge dictionaries of all processes with a binomial tree to rank 0
+//of mergeComm, the union is then broadcasted to all. The size of the
+//messages is bounded by the number of unique timer paths. Returns
+//false on all processes if a dictionary could not be deserialized.
+bool ParallelTimerTree::mergeDictionaries(TimerDictionary &mergeDictionary, MPI_Comm mergeComm){
+   const int tag = 12345;
+   int mergeRank, mergeProcesses;
+   //merged without errors, and without timers whose groups or
+   //workunit labels differ between processes
+   int local[2] = {1, 1};
+   std::vector<char> buffer;
+   MPI_Comm_rank(mergeComm, &mergeRank);
+   MPI_Comm_size(mergeComm, &mergeProcesses);
+   for(int step = 1; step < mergeProcesses; step *= 2){
+      if(mergeRank % (2 * step) == step) {
+         mergeDictionary.serialize(buffer);
+         MPI_Send(buffer.data(), buffer.size(), MPI_CHAR, mergeRank - step, tag, mergeComm);
+         break;
+      }
+      else if(mergeRank + step < mergeProcesses) {
+         MPI_Status status;
+         int bufferSize;
+         TimerDictionary other;
+         MPI_Probe(mergeRank + step, tag, mergeComm, &status);
+         MPI_Get_count(&status, MPI_CHAR, &bufferSize);
+         buffer.resize(bufferSize);
+         MPI_Recv(buffer.data(), bufferSize, MPI_CHAR, mergeRank + step, tag, mergeComm, MPI_STATUS_IGNORE);
+         //a malformed part is left out, the protocol has to go on
+         if(!other.deserialize(buffer.data(), buffer.size()))
+            local[0] = 0;
+         else if(mergeDictionary.merge(other) > 0)
+            local[1] = 0;
+      }
+   }
+
+   int bufferSize;
+   if(mergeRank == 0) {
+      mergeDictionary.serialize(buffer);
+      bufferSize = buffer.size();
+   }
+   MPI_Bcast(&bufferSize, 1, MPI_INT, 0, mergeComm);
+   buffer.resize(bufferSize);
+   MPI_Bcast(buffer.data(), bufferSize, MPI_CHAR, 0, mergeComm);
+   if(mergeRank != 0 && !mergeDictionary.deserialize(buffer.data(), buffer.size()))
+      local[0] = 0;
+
+   int all[2];
+   MPI_Allreduce(local, all, 2, MPI_INT, MPI_MIN, mergeComm);
+   if(mergeRank == 0) {
+      if(!all[0])
+         std::cerr << "PHIPROF-ERROR: Could not merge the timers of all processes" << std::endl;
+      if(!all[1])
+         std::cerr << "phiprof warning: some timers have different groups or workunit labels "
+                   << "on different processes, the ones of the lowest rank are used" << std::endl;
+   }
+   return all[0];
+}
+
+
+//Collect the statistics of the current counters and write the
+//reports of the print styles into fileNamePrefix_printIndex.*
+bool ParallelTimerTree::printReport(const std::vector<std::string> &prints, const std::string &fileNamePrefix, int printIndex){
+   bool success = true;
+   collectTimerStats(rank);
+   collectGroupStats(rank);
+   if(std::find(prints.begin(), prints.end(), "heatmap") != prints.end() ||
+      std::find(prints.begin(), prints.end(), "heatmap-image") != prints.end())
+      collectRankTimes(rank);
+   if(std::find(prints.begin(), prints.end(), "clusters") != prints.end())
+      collectClusters(rank);
+   if(std::find(prints.begin(), prints.end(), "flame-max") != prints.end())
+      collectSlowestTimes(rank);
+   if(rankInPrint == 0){
+      std::map<std::string, std::ofstream> outputs; //one file per extension
+      
+      report.nProcesses = nProcessesInPrint;
+      report.nNodes = reducer.getNumNodes();
+#ifdef _OPENMP
+      report.maxThreads = omp_get_max_threads();
+#else
+      report.maxThreads = 0;
+#endif
+      report.mergeTrees = mergeTrees;
+      report.computeFractions();
+      for(const auto& p: prints) {
+         if(!success)
+            break;
+         if(TimerReport::isPrintStyle(p)) {
+            //files are opened when the first style printed into them is encountered
+            const std::string extension = TimerReport::getFileExtension(p);
+            std::ofstream &output = outputs[extension];
+            if(!output.is_open()) {
+               std::stringstream fname;
+               fname << fileNamePrefix << "_" << printIndex << "." << extension;
+               output.open(fname.str(), std::fstream::out | std::fstream::binary);
+               if (output.good() == false) {
+                  std::cerr << "PHIPROF-ERROR: Could not open " << fname.str() << " for writing" << std::endl;
+                  success = false;
+                  break;
+               }
+            }
+            report.print(p, output);
+         }
+         else if(p != "comm-matrix")
+            if(rank == 0)
+               //Only really need the warning from one process
+               std::cerr <<"phiprof warning: nonexistent print style " << p << " in PHIPROF_PRINTS" << std::endl;
+      }
+      for(auto& output: outputs)
+         output.second.close();
+   }
+   return success;
+}
+
+
 bool ParallelTimerTree::print(MPI_Comm communicator, std::string fileNamePrefix){
    int timersHash,printIndex;
    
    //printStartTime defined in namespace, used to correct timings for open timers
-   printStartTime = wTime();
+   printStartTime = TimerData::getTime();
    comm = communicator; //no dup, we will only use it without
    MPI_Comm_rank(comm, &rank);
    MPI_Comm_size(comm, &nProcesses);
    MPI_Barrier(comm);
 
-   //get hash value of timers and the print communicator
-   if(getPrintCommunicator(printIndex, timersHash)) {
-      //generate file name
-      std::stringstream fname;
-      fname << fileNamePrefix << "_" << printIndex << ".txt";
-      collectTimerStats(rank);
-      collectGroupStats(rank);
-      
-      if(rankInPrint == 0){
-         char *envVariable;
-         std::vector<std::string> prints;
-         std::ofstream output;
-         std::map<std::string, std::string> groupIds;
-
-         /*read from environment variable what to print**/
-         envVariable = getenv("PHIPROF_PRINTS");
-         if(envVariable != NULL) {
-            char *substring;
-            substring = strtok(envVariable, ",");
-            while(substring != NULL) {
-               prints.push_back(std::string(substring));
-               substring = strtok(NULL, ",");
-            }
+   //merge trees of all processes into one report instead of one
+   //report per unique set of timers
+   const char *mergeVariable = getenv("PHIPROF_MERGE");
+   mergeTrees = mergeVariable != NULL && strcmp(mergeVariable, "0") != 0;
+
+   //get hash value of timers and the print communicator, reuse the
+   //previous ones if nothing has changed
+   bool reducerSuccess = true;
+   bool success = getCachedPrintCommunicator(printIndex);
+   if(!success) {
+      success = getPrintCommunicator(printIndex, timersHash);
+      if(success) {
+         //if this fails, the reports are still printed with flat reductions
+         reducerSuccess = reducer.initialize(printComm);
+         success = buildDictionary();
+         if(success) {
+            cachePrintCommunicator(printIndex);
          }
          else {
-            //set default print
-            prints.push_back("groups");
-            prints.push_back("compact");
+            reducer.finalize();
+            MPI_Comm_free(&printComm);
          }
-         
-         getGroupIds(groupIds);
-         output.open(fname.str(), std::fstream::out);
-         if (output.good() == false)
-            return false;
-         
-         for(const auto& p: prints) {
-            if(p == "groups")
-               printGroupStatistics(0.0, groupIds, output);
-            else if(p=="compact")
-               printTimers(0.01, groupIds, output);
-            else if(p=="full")
-               printTimers(0.0, groupIds, output);
-            else if(p=="detailed")
-               printTimersDetailed(0.0, groupIds, output);
-            else
+      }
+      else {
+         MPI_Comm_free(&printComm);
+      }
+   }
+
+   if(success) {
+      std::vector<std::string> prints;
+      const char *envVariable;
+
+      /*read from environment variable what to print**/
+      envVariable = getenv("PHIPROF_PRINTS");
+      if(envVariable != NULL) {
+         //parse a copy, the environment has to stay intact for later prints
+         std::stringstream printsVariable(envVariable);
+         std::string substring;
+         while(std::getline(printsVariable, substring, ',')) {
+            if(substring.size() > 0)
+               prints.push_back(substring);
+         }
+      }
+      else {
+         //set default print
+         prints.push_back("groups");
+         prints.push_back("compact");
+      }
+
+      if(std::find(prints.begin(), prints.end(), "comm-matrix") != prints.end()) {
+         std::stringstream fname;
+         fname << fileNamePrefix << "_" << printIndex << ".comm";
+         success = printCommunicationMatrix(fname.str());
+      }
+      //the reports are printed even if the communication matrix failed
+      success = printReport(prints, fileNamePrefix, printIndex) && success;
+
+      //reports of each phase, and of the time since the previous print,
+      //are printed by temporarily replacing the counters of the timers.
+      //All processes of comm take part, whether or not their earlier
+      //reports succeeded.
+      //Phases are set in the same order on all processes, a phase is
+      //printed once all processes have reached it, and only if it has
+      //the same name on all processes.
+      const bool printDelta = isPrintDelta();
+      int nPhases = phases.size();
+      MPI_Allreduce(MPI_IN_PLACE, &nPhases, 1, MPI_INT, MPI_MIN, comm);
+      std::vector<uint64_t> minHashes(nPhases), maxHashes(nPhases);
+      for(int phase = 0; phase < nPhases; phase++)
+         minHashes[phase] = std::hash<std::string>{}(phases[phase].name);
+      MPI_Allreduce(minHashes.data(), maxHashes.data(), nPhases, MPI_UINT64_T, MPI_MAX, comm);
+      MPI_Allreduce(MPI_IN_PLACE, minHashes.data(), nPhases, MPI_UINT64_T, MPI_MIN, comm);
+      if(nPhases > 0 || printDelta) {
+         std::vector<TimerData::Counters> liveCounters;
+         std::vector<TimerData::Counters> windowCounters;
+         closeActiveIntervals();
+         getCounters(liveCounters);
+         for(int phase = 0; phase < nPhases; phase++) {
+            if(minHashes[phase] != maxHashes[phase]) {
                if(rank == 0)
-                  //Only really need the warning from one process
-                  std::cerr <<"phiprof warning: nonexistent print style " << p << " in PHIPROF_PRINTS" << std::endl;
+                  std::cerr << "phiprof warning: phase " << phase << " (" << phases[phase].name
+                            << " on rank 0) has different names on different processes, it is not printed"
+                            << std::endl;
+               continue;
+            }
+            windowCounters = phases[phase].counters;
+            if(phase == currentPhase)
+               addCounters(windowCounters, liveCounters, phaseStartCounters);
+            setCounters(windowCounters);
+            success = printReport(prints, fileNamePrefix + "_" + phases[phase].name, printIndex) && success;
          }
-         output.close();
+         if(printDelta) {
+            windowCounters.clear();
+            addCounters(windowCounters, liveCounters, printCounters);
+            setCounters(windowCounters);
+            success = printReport(prints, fileNamePrefix + "_delta", printIndex) && success;
+         }
+         setCounters(liveCounters);
       }
-      MPI_Comm_free(&printComm);
    }
 
    MPI_Barrier(comm);   
-   double endPrintTime = wTime();
+   double endPrintTime = TimerData::getTime();
    shiftActiveStartTime(endPrintTime - printStartTime);
+   if(isPrintDelta()) {
+      closeActiveIntervals();
+      getCounters(printCounters);
+   }
    
    
-   return true;
+   return success && reducerSuccess;
 }
    
+
+
+//Node of this process in a dump over communicator, identified by its
+//lowest rank so that offline tools can compute node statistics. It is
+//cached for the group of the communicator, as repeated dumps usually
+//use the same one. Collective over communicator.
+int ParallelTimerTree::getDumpNode(MPI_Comm communicator){
+   MPI_Group group;
+   int cached = 0;
+   int allCached;
+   MPI_Comm_group(communicator, &group);
+   if(dumpNodeCache.valid) {
+      int result;
+      MPI_Group_compare(group, dumpNodeCache.group, &result);
+      cached = result == MPI_IDENT;
+   }
+   MPI_Allreduce(&cached, &allCached, 1, MPI_INT, MPI_MIN, communicator);
+   if(allCached) {
+      MPI_Group_free(&group);
+      return dumpNodeCache.node;
+   }
+
+   MPI_Comm nodeComm;
+   int node;
+   MPI_Comm_rank(communicator, &node);
+   MPI_Comm_split_type(communicator, MPI_COMM_TYPE_SHARED, node, MPI_INFO_NULL, &nodeComm);
+   MPI_Bcast(&node, 1, MPI_INT, 0, nodeComm);
+   MPI_Comm_free(&nodeComm);
+   if(dumpNodeCache.valid)
+      MPI_Group_free(&dumpNodeCache.group);
+   dumpNodeCache.valid = true;
+   dumpNodeCache.group = group;
+   dumpNodeCache.node = node;
+   return node;
+}
+
+bool ParallelTimerTree::dump(MPI_Comm communicator, std::string fileName){
+   int dumpRank, dumpProcesses;
+   int mySuccess;
+   int success;
+   //printStartTime is used to correct timings for open timers
+   printStartTime = TimerData::getTime();
+   MPI_Comm_rank(communicator, &dumpRank);
+   MPI_Comm_size(communicator, &dumpProcesses);
+
+   //union of the timers of all processes, all processes refer to
+   //timers with their index in it
+   TimerDictionary dumpDictionary;
+   std::vector<int> indices;
+   std::vector<char> dictionaryBuffer;
+   dumpDictionary.add(*this, indices);
+   if(!mergeDictionaries(dumpDictionary, communicator)) {
+      shiftActiveStartTime(TimerData::getTime() - printStartTime);
+      return false;
+   }
+   dumpDictionary.add(*this, indices);
+   dumpDictionary.serialize(dictionaryBuffer);
+
+   std::vector<TimerDump::Record> records(size());
+   for(unsigned int id = 0; id < size(); id++) {
+      int threads;
+      records[id].index = indices[id];
+      (*this)[id].getTimeStatistics(records[id].time, records[id].timeMax, records[id].timeMin, threads);
+      if(threads == 0)
+         records[id].timeMin = 0.0;
+      records[id].threads = threads;
+      records[id].count = (*this)[id].getAverageCount();
+      records[id].workUnits = (*this)[id].getAverageWorkUnits();
+      getExclusiveTimeStatistics(id, records[id].exclusiveTime, records[id].exclusiveTimeMax,
+                                 records[id].exclusiveTimeMin, threads);
+      if(threads == 0)
+         records[id].exclusiveTimeMin = 0.0;
+   }
+
+   //records of the ranks are stored after each other in rank order
+   //after the header, the report.dictionary and the offset table
+   TimerDump::Header header;
+   TimerDump::RankEntry rankEntry;
+   TimerDump::setHeader(header, dumpProcesses, dictionaryBuffer.size());
+   const MPI_Offset tableOffset = sizeof(header) + dictionaryBuffer.size();
+   int64_t recordBytes = records.size() * sizeof(TimerDump::Record);
+   int64_t recordOffset = 0;
+   MPI_Exscan(&recordBytes, &recordOffset, 1, MPI_INT64_T, MPI_SUM, communicator);
+   if(dumpRank == 0)
+      recordOffset = 0; //undefined on rank 0 after exscan
+   rankEntry.offset = tableOffset + dumpProcesses * sizeof(rankEntry) + recordOffset;
+   rankEntry.nRecords = records.size();
+   rankEntry.node = getDumpNode(communicator);
+
+   //all data of this process is written with one collective write
+   std::vector<char> buffer;
+   std::vector<int> blockLengths;
+   std::vector<MPI_Aint> blockOffsets;
+   auto addBlock = [&](MPI_Aint offset, const void *data, size_t bytes) {
+      const char *bytePointer = static_cast<const char*>(data);
+      blockOffsets.push_back(offset);
+      blockLengths.push_back(bytes);
+      buffer.insert(buffer.end(), bytePointer, bytePointer + bytes);
+   };
+   if(dumpRank == 0) {
+      addBlock(0, &header, sizeof(header));
+      addBlock(sizeof(header), dictionaryBuffer.data(), dictionaryBuffer.size());
+   }
+   addBlock(tableOffset + dumpRank * sizeof(rankEntry), &rankEntry, sizeof(rankEntry));
+   addBlock(rankEntry.offset, records.data(), recordBytes);
+
+   mySuccess = writeBlocks(communicator, fileName, buffer, blockLengths, blockOffsets);
+   MPI_Allreduce(&mySuccess, &success, 1, MPI_INT, MPI_MIN, communicator);
+   if(!success && dumpRank == 0)
+      std::cerr << "PHIPROF-ERROR: Could not write dump into " << fileName << std::endl;
+
+   double endDumpTime = TimerData::getTime();
+   shiftActiveStartTime(endDumpTime - printStartTime);
+   return success;
+}
@@ -24,14 +24,69 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <fstream>
 
 #include "mpi.h"
 #include "timertree.hpp"
+#include "nodereducer.hpp"
+#include "timerdictionary.hpp"
+#include "timerdump.hpp"
+#include "timerreport.hpp"
+#include "communicationmatrix.hpp"
+#include "localreport.hpp"
+#include "metricsexporter.hpp"
 
 class ParallelTimerTree: public TimerTree  {
 public:
 
+   /**
+    * Initialize the timertree and the message storage of each thread
+    */
+   bool initialize();
+   ~ParallelTimerTree();
+
+   /**
+    * Record a point-to-point message sent by the calling thread
+    *
+    * @param id
+    *   Id of the timer the message is attributed to
+    * @param destination
+    *   Rank of the destination in MPI_COMM_WORLD
+    * @param bytes
+    *   Size of the message
+    */
+   void addMessage(int id, int destination, double bytes){
+      Messages &sent = messages[thread][(static_cast<uint64_t>(id) << 32) | static_cast<uint32_t>(destination)];
+      sent.count++;
+      sent.bytes += bytes;
+   }
+
+   /**
+    * Reset the time, counts and workunits of all timers and phases to
+    * zero. Active timers continue from zero. Call outside parallel
+    * regions.
+    */
+   bool reset();
+
+   /**
+    * Pause and resume the clock of all timers, call outside parallel
+    * regions. Timers started and stopped while paused are counted but
+    * get no time.
+    *
+    * @return
+    *   Returns false if already paused (resumed)
+    */
+   bool pause();
+   bool resume();
+
+   /**
+    * End the current phase and start the phase name. Time of a phase
+    * entered several times is summed. Call outside parallel regions,
+    * in the same order on all processes.
+    */
+   bool setPhase(const std::string &name);
+
    /**
     * Print the  current timer state in a human readable file
     *
@@ -53,7 +108,14 @@ public:
     *   The first part of the filename where the profile is printed. Each
     *   unique set of timers (label, hierarchy, workunits) will be
     *   assigned a unique hash number and the profile will be written
-    *   out into a file called fileprefix_hash.txt
+    *   out into a file called fileprefix_hash.txt. If the environment
+    *   variable PHIPROF_MERGE is set (and not 0), the timers of all
+    *   processes are instead merged by their full label path and
+    *   written out into one file called fileprefix_0.txt. The
+    *   statistics of each phase are written into
+    *   fileprefix_phase_hash.txt, and if the environment variable
+    *   PHIPROF_PRINT_DELTA is set (and not 0) the statistics since the
+    *   previous print into fileprefix_delta_hash.txt
     * @param minFraction
     *   (optional) Default value is to print all timers
     *   minFraction can be used to filter the timers being printed so
@@ -64,69 +126,113 @@ public:
     *   Returns true if pofile printed successfully.
     */
    bool print(MPI_Comm comm, std::string fileNamePrefix="profile");
+
+   /**
+    * Write the raw timer data of all processes into one binary file
+    *
+    * Every process writes the inclusive and exclusive time, count, workunits and
+    * thread statistics of each of its timers. The layout of the file is
+    * described in TimerDump. Collective over comm.
+    *
+    * @param comm
+    *   Communicator for processes that dump their timers.
+    * @param fileName
+    *   Name of the file
+    * @return
+    *   Returns true if the timers were dumped successfully.
+    */
+   bool dump(MPI_Comm comm, std::string fileName);
+
+   /**
+    * Free the communicators that are kept between prints. Collective
+    * over all processes that have called print, call before
+    * MPI_Finalize.
+    */
+   bool finalize();
    
 private:
 
    //used with MPI reduction operator
-   struct doubleRankPair {
-      double val;
-      int rank;
-   };
-
-   struct TimerStatistics {
-      std::vector<int> id; //id of the timer at this index in the statistics vectors
-      std::vector<int> level;
-      std::vector<double> timeSum;
-      std::vector<doubleRankPair> timeMax;
-      std::vector<doubleRankPair> timeMin;
-      std::vector<double> timeTotalFraction;
-      std::vector<double> timeParentFraction;
-      std::vector<bool> hasWorkUnits;
-      std::vector<double> workUnitsSum;
-      std::vector<int64_t> countSum;
-      
-      std::vector<int> threadsSum;
-      std::vector<double> threadImbalanceSum;
-      std::vector<doubleRankPair> threadImbalanceMax;
-      std::vector<doubleRankPair> threadImbalanceMin;
-   };
-   TimerStatistics stats;
-   
-      
-   struct GroupStatistics {
-      std::vector<std::string> name; 
-      std::vector<double> timeSum;
-      std::vector<doubleRankPair> timeMax;
-      std::vector<doubleRankPair> timeMin;
-      std::vector<double> timeTotalFraction;
-   };
-   GroupStatistics groupStats;
+   typedef TimerReport::doubleRankPair doubleRankPair;
 
    void collectGroupStats(int reportRank);
-   void getGroupIds(std::map<std::string, std::string>  &groupIds);
-   void collectTimerStats(int reportRank,int id=0,int parentIndex=0);
-
-   
-   bool printTimers(double minFraction, 
-                    const std::map<std::string, std::string> &groupIds,                  
-                    std::ofstream &output);   
-   bool printTimersDetailed(double minFraction, 
-                    const std::map<std::string, std::string> &groupIds,                  
-                    std::ofstream &output);   
-   
-   bool printGroupStatistics(double minFraction,
-                             const std::map<std::string, std::string> &groupIds,
-                             std::ofstream &output);
+   void collectTimerStats(int reportRank,int index=0,int parentIndex=0);
+   void selectRankTimesRows();
+   void collectRankTimes(int reportRank);
+   void collectSlowestTimes(int reportRank);
+   void collectClusters(int reportRank);
+   bool printCommunicationMatrix(const std::string &fileName);
+   bool printReport(const std::vector<std::string> &prints, const std::string &fileNamePrefix, int printIndex);
+   void publishClock();
+   bool buildDictionary();
+   bool mergeDictionaries(TimerDictionary &mergeDictionary, MPI_Comm mergeComm);
 
    bool getPrintCommunicator(int &printIndex, int &timersHash);
+   int verifyPrintCommunicator(uint64_t hash);
+   bool getCachedPrintCommunicator(int &printIndex);
+   int getDumpNode(MPI_Comm communicator);
+   void cachePrintCommunicator(int printIndex);
+   void freePrintCommunicator();
+   void retirePrintCommunicator();
 
    MPI_Comm comm;
    MPI_Comm printComm;
+   //printComm, reducer and dictionary are reused while these are unchanged
+   struct PrintCommunicatorCache {
+      bool valid = false;
+      MPI_Comm comm;   //communicator given to print
+      MPI_Group group; //group of comm
+      uint64_t hash;   //hash of the timers
+      bool mergeTrees;
+      int printIndex;
+   };
+   PrintCommunicatorCache printCache;
+   NodeReducer reducer; //two-level reductions over printComm
+   //print communicators of earlier communicators given to print, not
+   //all of their members may take part in a later print. Freed in finalize.
+   struct RetiredPrintCommunicator {
+      MPI_Comm printComm;
+      NodeReducer reducer;
+   };
+   std::vector<RetiredPrintCommunicator> retiredPrintCommunicators;
+   //datatype and operator of the quantile sketch reductions, created
+   //by the first print and freed in finalize
+   MPI_Datatype sketchType = MPI_DATATYPE_NULL;
+   MPI_Op sketchOp = MPI_OP_NULL;
+   //node of this process in the last dump, reused for the same group
+   struct DumpNodeCache {
+      bool valid = false;
+      MPI_Group group;
+      int node;
+   };
+   DumpNodeCache dumpNodeCache;
+   bool mergeTrees; //print union of all trees into one report
+   TimerReport report; //statistics and dictionary, only complete on rank 0 of printComm
+   std::vector<int> localIds; //local timer id for each dictionary index, -1 if it does not exist
+   std::vector<double> localTime; //time of this process for each row of the statistics
+   std::vector<int> localRanks; //1 if this process has the timer of each row of the statistics
+   struct Messages {
+      int64_t count = 0;
+      double bytes = 0.0;
+   };
+   //messages sent by each thread, (timer id << 32 | destination) -> messages
+   std::vector<std::unordered_map<uint64_t, Messages>> messages;
+   struct Phase {
+      std::string name;
+      std::vector<TimerData::Counters> counters; //sum over the ended windows of the phase
+   };
+   std::vector<Phase> phases;
+   int currentPhase = -1;
+   std::vector<TimerData::Counters> phaseStartCounters; //counters when the current phase started
+   std::vector<TimerData::Counters> printCounters; //counters at the end of the previous print
    int rank;
    int nProcesses;
    int rankInPrint;
    int nProcessesInPrint;
    double printStartTime;
+   SharedCounters sharedSegment; //live counters in /dev/shm if PHIPROF_SHM is set
+   MetricsExporter metricsExporter; //node metrics file if PHIPROF_METRICS_FILE is set
+   LocalReport localReport; //last, so that its helper thread is stopped first
    
    // Updated in collectStats, only valid on root rank
    
@@ -28,8 +28,10 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <map>
 #include <fstream>
 #include <sstream>
+#include <atomic>
 #include "paralleltimertree.hpp"
 #include "phiprof.hpp"
+#include "instrumentation.hpp"
 
 #include "mpi.h"
 #ifdef _OPENMP
@@ -42,6 +44,37 @@ namespace phiprof
    namespace 
    {
       ParallelTimerTree parallelTimerTree; 
+      std::atomic<int> instrumentationPauses(0);
+      //disables automatic timers for good at exit, before
+      //parallelTimerTree is destroyed (reverse order of construction)
+      struct ExitPause {
+         ~ExitPause(){
+            instrumentationPauses++;
+         }
+      } exitPause;
+   }
+
+   namespace instrumentation
+   {
+      bool isEnabled(){
+         return TimerTree::isInitialized() && instrumentationPauses.load(std::memory_order_relaxed) == 0;
+      }
+
+      int getCurrentId(){
+         return parallelTimerTree.getCurrentId();
+      }
+
+      void addMessage(int id, int destination, double bytes){
+         parallelTimerTree.addMessage(id, destination, bytes);
+      }
+
+      Pause::Pause(){
+         instrumentationPauses++;
+      }
+
+      Pause::~Pause(){
+         instrumentationPauses--;
+      }
    }
 
    bool initialize(){
@@ -117,8 +150,41 @@ namespace phiprof
       return parallelTimerTree.stop(id);
    }
    bool print(MPI_Comm comm, std::string fileNamePrefix){
+      instrumentation::Pause pause;
       return parallelTimerTree.print(comm, fileNamePrefix);
    }
+
+   bool dump(MPI_Comm comm, std::string fileName){
+      instrumentation::Pause pause;
+      return parallelTimerTree.dump(comm, fileName);
+   }
+
+   bool finalize(){
+      return parallelTimerTree.finalize();
+   }
+
+   bool reset(){
+      return parallelTimerTree.reset();
+   }
+
+   //automatic timers are not started while paused
+   bool pause(){
+      const bool success = parallelTimerTree.pause();
+      if(success)
+         instrumentationPauses++;
+      return success;
+   }
+
+   bool resume(){
+      const bool success = parallelTimerTree.resume();
+      if(success)
+         instrumentationPauses--;
+      return success;
+   }
+
+   bool setPhase(const std::string &name){
+      return parallelTimerTree.setPhase(name);
+   }
    
 
    int getChildId(const string &label){
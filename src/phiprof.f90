@@ -124,6 +124,51 @@ module phiprof
        character(kind=C_CHAR), intent(in) :: fileNamePrefix(*)
        integer(kind=C_INT) :: stat
      end function phiprof_print_from_fortran_c
+
+     function phiprof_dump_from_fortran_c(comm, fileName) bind(C,name='phiprof_dump_from_fortran') result(stat)
+       ! the C interface is int phiprof_dump(MPI_Comm comm, char *fileName);
+       use, intrinsic :: ISO_C_BINDING
+       implicit none
+       integer(c_int), value, intent(in) :: comm 
+       character(kind=C_CHAR), intent(in) :: fileName(*)
+       integer(kind=C_INT) :: stat
+     end function phiprof_dump_from_fortran_c
+
+     function phiprof_finalize_c() bind(C,name='phiprof_finalize') result(stat)
+       ! the C interface is int phiprof_finalize();
+       use, intrinsic :: ISO_C_BINDING
+       implicit none
+       integer(kind=C_INT) :: stat
+     end function phiprof_finalize_c
+
+     function phiprof_reset_c() bind(C,name='phiprof_reset') result(stat)
+       ! the C interface is int phiprof_reset();
+       use, intrinsic :: ISO_C_BINDING
+       implicit none
+       integer(kind=C_INT) :: stat
+     end function phiprof_reset_c
+
+     function phiprof_pause_c() bind(C,name='phiprof_pause') result(stat)
+       ! the C interface is int phiprof_pause();
+       use, intrinsic :: ISO_C_BINDING
+       implicit none
+       integer(kind=C_INT) :: stat
+     end function phiprof_pause_c
+
+     function phiprof_resume_c() bind(C,name='phiprof_resume') result(stat)
+       ! the C interface is int phiprof_resume();
+       use, intrinsic :: ISO_C_BINDING
+       implicit none
+       integer(kind=C_INT) :: stat
+     end function phiprof_resume_c
+
+     function phiprof_setPhase_c(name) bind(C,name='phiprof_setPhase') result(stat)
+       ! the C interface is int phiprof_setPhase(char *name);
+       use, intrinsic :: ISO_C_BINDING
+       implicit none
+       character(kind=C_CHAR), intent(in) :: name(*)
+       integer(kind=C_INT) :: stat
+     end function phiprof_setPhase_c
   end interface
   
 contains
@@ -286,6 +331,75 @@ contains
     end if
   end subroutine phiprof_print
 
+  subroutine phiprof_dump(comm, fileName, error) 
+    implicit none
+    integer, intent(in) :: comm
+    character(len=*), intent(in) :: fileName
+    integer, intent(out), optional:: error
+    integer error_
+    
+    error_ = phiprof_dump_from_fortran_c(comm, trim(fileName)//C_NULL_CHAR)    
+    if (present(error)) then
+       error = error_
+    end if
+  end subroutine phiprof_dump
+
+  subroutine phiprof_finalize(error)
+    implicit none
+    integer, intent(out), optional:: error
+    integer error_
+
+    error_ = phiprof_finalize_c()
+    if (present(error)) then
+       error = error_
+    end if
+  end subroutine phiprof_finalize
+
+  subroutine phiprof_reset(error)
+    implicit none
+    integer, intent(out), optional:: error
+    integer error_
+
+    error_ = phiprof_reset_c()
+    if (present(error)) then
+       error = error_
+    end if
+  end subroutine phiprof_reset
+
+  subroutine phiprof_pause(error)
+    implicit none
+    integer, intent(out), optional:: error
+    integer error_
+
+    error_ = phiprof_pause_c()
+    if (present(error)) then
+       error = error_
+    end if
+  end subroutine phiprof_pause
+
+  subroutine phiprof_resume(error)
+    implicit none
+    integer, intent(out), optional:: error
+    integer error_
+
+    error_ = phiprof_resume_c()
+    if (present(error)) then
+       error = error_
+    end if
+  end subroutine phiprof_resume
+
+  subroutine phiprof_setPhase(name, error)
+    implicit none
+    character(len=*), intent(in) :: name
+    integer, intent(out), optional:: error
+    integer error_
+
+    error_ = phiprof_setPhase_c(trim(name)//C_NULL_CHAR)
+    if (present(error)) then
+       error = error_
+    end if
+  end subroutine phiprof_setPhase
+
 
 
   
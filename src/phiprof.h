@@ -46,6 +46,13 @@ int phiprof_stopId(int id);
 int phiprof_stopIdUnits(int id,double units,char *unitName);
 
 int phiprof_print(MPI_Comm comm, char *fileNamePrefix);
+int phiprof_dump(MPI_Comm comm, char *fileName);
+
+int phiprof_finalize();
+int phiprof_reset();
+int phiprof_pause();
+int phiprof_resume();
+int phiprof_setPhase(char *name);
 
 
 #endif
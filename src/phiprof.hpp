@@ -161,12 +161,85 @@ namespace phiprof
     *   The first part of the filename where the profile is printed. Each
     *   unique set of timers (label, hierarchy, workunits) will be
     *   assigned a unique hash number and the profile will be written
-    *   out into a file called fileprefix_hash.txt
+    *   out into a file called fileprefix_hash.txt. If the environment
+    *   variable PHIPROF_MERGE is set (and not 0), the timers of all
+    *   processes are instead merged by their full label path and
+    *   written out into one file called fileprefix_0.txt. If phases
+    *   have been set, the statistics of each phase are also written
+    *   into fileprefix_phase_hash.txt, and if the environment variable
+    *   PHIPROF_PRINT_DELTA is set (and not 0) the statistics since the
+    *   previous print into fileprefix_delta_hash.txt
     * @return
     *   Returns true if pofile printed successfully.
     */
    bool print(MPI_Comm comm, std::string fileNamePrefix="profile");
 
+   /**
+    * Dump the raw timer data of all processes into one binary file
+    *
+    * Unlike print, no statistics are computed. Every process writes the
+    * inclusive time, count, workunits and thread statistics of each of
+    * its timers, so that the data can be analyzed offline. All data is
+    * written with a single collective MPI-IO write. Like print, it can
+    * be called multiple times and corrects for the time spent in it.
+    *
+    * @param comm
+    *   Communicator for processes that dump their timers.
+    * @param fileName
+    *   Name of the dump file, it is overwritten if it exists
+    * @return
+    *   Returns true if the timers were dumped successfully.
+    */
+   bool dump(MPI_Comm comm, std::string fileName);
+
+   /**
+    * Free the MPI communicators that phiprof keeps between prints.
+    * Collective over all processes that have called print, call before
+    * MPI_Finalize. Otherwise they are released by MPI_Finalize.
+    *
+    * @return
+    *   Returns true if the communicators were freed.
+    */
+   bool finalize();
+
+   /**
+    * Reset the time, count and workunits of all timers and phases to
+    * zero, e.g. to leave out initialization from the profile. Active
+    * timers stay active and continue from zero. Call outside parallel
+    * regions.
+    *
+    * @return
+    *   Returns true if the timers were reset.
+    */
+   bool reset();
+
+   /**
+    * Pause and resume profiling, e.g. around checkpoints. While paused
+    * the clock of all timers is stopped: timers can still be started
+    * and stopped, they are counted but get no time. Call outside
+    * parallel regions.
+    *
+    * @return
+    *   Returns false if phiprof was already paused (not paused).
+    */
+   bool pause();
+   bool resume();
+
+   /**
+    * End the current phase and start a new one, e.g. "init", "steady"
+    * and "output". The time until the next call is attributed to the
+    * phase, and the time of a phase entered several times is summed.
+    * Each print also writes the statistics of each phase into a
+    * separate file. Call outside parallel regions, in the same order on
+    * all processes.
+    *
+    * @param name
+    *   Name of the phase, used in the file names of its reports
+    * @return
+    *   Returns true if the phase was set.
+    */
+   bool setPhase(const std::string &name);
+
    class Timer {
       public:
          explicit Timer(const int id);
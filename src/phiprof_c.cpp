@@ -104,3 +104,31 @@ extern "C" int phiprof_print_from_fortran(int comm, char *fileNamePrefix){
    return (int)phiprof::print(MPI_Comm_f2c(comm),string(fileNamePrefix));
 }
 
+extern "C" int phiprof_dump(MPI_Comm comm, char *fileName){
+  return (int)phiprof::dump(comm,string(fileName));
+}
+
+extern "C" int phiprof_dump_from_fortran(int comm, char *fileName){
+   return (int)phiprof::dump(MPI_Comm_f2c(comm),string(fileName));
+}
+
+extern "C" int phiprof_finalize(){
+  return (int)phiprof::finalize();
+}
+
+extern "C" int phiprof_reset(){
+  return (int)phiprof::reset();
+}
+
+extern "C" int phiprof_pause(){
+  return (int)phiprof::pause();
+}
+
+extern "C" int phiprof_resume(){
+  return (int)phiprof::resume();
+}
+
+extern "C" int phiprof_setPhase(char *name){
+  return (int)phiprof::setPhase(string(name));
+}
+
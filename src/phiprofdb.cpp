@@ -0,0 +1,143 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include "timerdump.hpp"
+#include "timerreport.hpp"
+#include "rundatabase.hpp"
+
+/*
+  phiprof-db keeps the history of runs in a RunDatabase. Runs are added
+  from dumps written by phiprof::dump, and the trend of a timer over
+  the runs can be queried.
+*/
+
+namespace {
+   void usage(const char *name){
+      std::cerr << "Usage: " << name << " add [options] database dumpfile" << std::endl
+                << "         -g hash      git hash of the code" << std::endl
+                << "         -i input     name of the input or case" << std::endl
+                << "         -t seconds   time of the run since epoch (default now)" << std::endl
+                << "       " << name << " runs database" << std::endl
+                << "       " << name << " trend [options] database timer" << std::endl
+                << "         -k metric    average (default), max, imbalance, count or ranks" << std::endl
+                << "         -n value     outlier threshold in median absolute deviations (default 3.5)" << std::endl
+                << "Timers are given with their full label, e.g. /solve/halo, / is the total time." << std::endl
+                << "Exit status of trend is 2 if the latest run is an outlier." << std::endl;
+   }
+
+   std::string formatTime(int64_t seconds){
+      char buffer[32];
+      time_t t = seconds;
+      strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M", localtime(&t));
+      return buffer;
+   }
+
+   void printRun(const RunDatabase::Run &run){
+      std::cout << formatTime(run.time) << "  " << std::setw(6) << run.nRanks << " ranks  "
+                << std::setw(3) << run.nThreads << " threads  " << run.gitHash << "  " << run.input;
+   }
+}
+
+
+int main(int argc, char **argv){
+   std::string gitHash;
+   std::string input;
+   std::string metric = "average";
+   double outlierThreshold = 3.5;
+   int64_t runTime = time(NULL);
+   std::vector<std::string> arguments;
+
+   if(argc < 2) {
+      usage(argv[0]);
+      return 1;
+   }
+   const std::string command = argv[1];
+   for(int i = 2; i < argc; i++){
+      const std::string option = argv[i];
+      if(option.size() == 2 && option[0] == '-' && i + 1 < argc) {
+         const std::string value = argv[++i];
+         switch(option[1]) {
+            case 'g': gitHash = value; break;
+            case 'i': input = value; break;
+            case 't': runTime = atoll(value.c_str()); break;
+            case 'k': metric = value; break;
+            case 'n': outlierThreshold = atof(value.c_str()); break;
+            default:
+               usage(argv[0]);
+               return 1;
+         }
+      }
+      else {
+         arguments.push_back(option);
+      }
+   }
+
+   const unsigned int nArguments = command == "runs" ? 1 : 2;
+   if((command != "add" && command != "runs" && command != "trend") || arguments.size() != nArguments) {
+      usage(argv[0]);
+      return 1;
+   }
+   RunDatabase database;
+   if(!database.open(arguments[0]))
+      return 1;
+
+   if(command == "add") {
+      TimerDump dump;
+      TimerReport report;
+      RunDatabase::Run run;
+      if(!dump.read(arguments[1]))
+         return 1;
+      report.collect(dump, std::vector<bool>(dump.getNumRanks(), true));
+      run.time = runTime;
+      run.nRanks = report.nProcesses;
+      run.nThreads = report.maxThreads;
+      run.gitHash = gitHash;
+      run.input = input;
+      return database.addRun(run, report) ? 0 : 1;
+   }
+   else if(command == "runs") {
+      for(auto &run: database.getRuns()){
+         printRun(run);
+         std::cout << std::endl;
+      }
+   }
+   else if(command == "trend") {
+      std::vector<RunDatabase::TrendPoint> trend;
+      if(!database.getTrend(arguments[1], metric, outlierThreshold, trend)) {
+         std::cerr << "PHIPROF-ERROR: No " << metric << " for timer " << arguments[1] << " in " << arguments[0] << std::endl;
+         return 1;
+      }
+      for(auto &point: trend){
+         std::cout << std::setw(12) << point.value << "  ";
+         printRun(database.getRuns()[point.run]);
+         std::cout << (point.outlier ? "  OUTLIER" : "") << std::endl;
+      }
+      //only the latest run matters when checking a new run
+      if(trend.size() > 0 && trend.back().outlier && trend.back().run == (int)database.getRuns().size() - 1)
+         return 2;
+   }
+   return 0;
+}
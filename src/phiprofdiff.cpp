@@ -0,0 +1,117 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include "timerdump.hpp"
+#include "timerreport.hpp"
+#include "timerdiff.hpp"
+
+/*
+  phiprof-diff compares two dumps written by phiprof::dump, e.g. from a
+  nightly run and a reference run. The exit status is 2 if any timer
+  has regressed, so that it can be used directly in scripts.
+*/
+
+namespace {
+   void usage(const char *name){
+      std::cerr << "Usage: " << name << " [options] basedump newdump" << std::endl
+                << "  -a seconds   absolute growth of time that is a regression (default 0.001)" << std::endl
+                << "  -r fraction  relative growth of time that is a regression (default 0.1)" << std::endl
+                << "  -c and|or    growth has to exceed both thresholds (and, default) or one of them (or)" << std::endl
+                << "  -m fraction  only print timers with at least this fraction of total time" << std::endl
+                << "  -o file      write the comparison into file instead of standard output" << std::endl
+                << "Exit status is 0 if no timer regressed, 2 if some did and 1 on errors." << std::endl;
+   }
+
+   bool readReport(const std::string &dumpName, TimerReport &report){
+      TimerDump dump;
+      if(!dump.read(dumpName))
+         return false;
+      report.collect(dump, std::vector<bool>(dump.getNumRanks(), true));
+      return true;
+   }
+}
+
+
+int main(int argc, char **argv){
+   double absoluteThreshold = 0.001;
+   double relativeThreshold = 0.1;
+   bool requireBoth = true;
+   double minFraction = 0.0;
+   std::string outputName;
+   std::vector<std::string> dumpNames;
+
+   for(int i = 1; i < argc; i++){
+      const std::string option = argv[i];
+      if(option.size() == 2 && option[0] == '-' && i + 1 < argc) {
+         const std::string value = argv[++i];
+         switch(option[1]) {
+            case 'a': absoluteThreshold = atof(value.c_str()); break;
+            case 'r': relativeThreshold = atof(value.c_str()); break;
+            case 'c':
+               if(value != "and" && value != "or") {
+                  usage(argv[0]);
+                  return 1;
+               }
+               requireBoth = value == "and";
+               break;
+            case 'm': minFraction = atof(value.c_str()); break;
+            case 'o': outputName = value; break;
+            default:
+               usage(argv[0]);
+               return 1;
+         }
+      }
+      else if(option[0] != '-') {
+         dumpNames.push_back(option);
+      }
+      else {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+   if(dumpNames.size() != 2) {
+      usage(argv[0]);
+      return 1;
+   }
+
+   TimerReport base, other;
+   if(!readReport(dumpNames[0], base) || !readReport(dumpNames[1], other))
+      return 1;
+
+   TimerDiff diff(absoluteThreshold, relativeThreshold, requireBoth);
+   diff.compare(base, other);
+
+   std::ofstream outputFile;
+   if(outputName.size() > 0) {
+      outputFile.open(outputName);
+      if(!outputFile.good()) {
+         std::cerr << "PHIPROF-ERROR: Could not open " << outputName << " for writing" << std::endl;
+         return 1;
+      }
+   }
+   std::ostream &output = outputName.size() > 0 ? outputFile : std::cout;
+   diff.print(output, minFraction);
+   return diff.hasRegressions() ? 2 : 0;
+}
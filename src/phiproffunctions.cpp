@@ -0,0 +1,237 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+  Hooks for code compiled with -finstrument-functions (GCC, Clang,
+  Intel). Each call of an instrumented function is timed in a timer
+  named after the function in the group Functions, under the active
+  timer of the calling thread. Direct recursion is timed in the
+  outermost call.
+
+  The name of a function is resolved once per address with dladdr and
+  demangled. Functions are only timed if their name matches the
+  regular expression in PHIPROF_FUNCTIONS_INCLUDE (default all) and
+  does not match PHIPROF_FUNCTIONS_EXCLUDE. The resolved functions are
+  kept in a lock-free cache shared by all threads, and the timer ids
+  of each function under each parent in a cache per thread, so after
+  the first call the hooks take no locks. Calls are only timed once
+  phiprof has been initialized, and not while phiprof itself
+  communicates.
+
+  Compile the code with -finstrument-functions and link with
+  -lphiprof_functions -lphiprof. Functions in the executable are only
+  resolved if it is linked with -rdynamic, static functions not at all.
+  This file is compiled with -fno-instrument-functions, and functions
+  called from within the hooks, e.g. phiprof itself if it has been
+  instrumented, are not timed.
+*/
+
+#include <string>
+#include <regex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include "phiprof.hpp"
+#include "instrumentation.hpp"
+
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
+
+namespace {
+   struct Function {
+      std::string label;
+      bool timed;
+   };
+
+   //Resolved functions, open addressing with linear probing. A slot is
+   //claimed by setting its address with compare-and-swap, and the
+   //function is published once resolved. When the cache is full new
+   //functions are not timed.
+   const int cacheBits = 16;
+   const size_t cacheSize = 1 << cacheBits;
+   std::atomic<void*> cacheAddresses[cacheSize];
+   std::atomic<const Function*> cacheFunctions[cacheSize];
+
+   //a call on the stack of a thread. id is the timer of the call, -1
+   //if it is not timed, and started is false for recursive calls that
+   //are timed in the outermost call.
+   struct Call {
+      void *address;
+      int id;
+      bool started;
+   };
+
+   //Calls of each thread. Trivially destructible, since functions are
+   //still called while threads and the program exit. Calls deeper
+   //than maxDepth are not timed.
+   const int maxDepth = 1024;
+   thread_local Call callStack[maxDepth];
+   thread_local int depth = 0;
+   thread_local bool inHook = false; //set while a hook runs on this thread
+
+   //regular expression from an environment variable, returns false if
+   //it is not set or not valid
+   NO_INSTRUMENT bool getRegex(const char *variable, std::regex &regex){
+      const char *value = getenv(variable);
+      if(value == NULL)
+         return false;
+      try {
+         regex.assign(value);
+      }
+      catch(const std::regex_error &) {
+         std::cerr << "PHIPROF-ERROR: Invalid regular expression in " << variable << std::endl;
+         return false;
+      }
+      return true;
+   }
+
+   NO_INSTRUMENT bool isTimed(const std::string &label){
+      static std::regex include, exclude;
+      static const bool hasInclude = getRegex("PHIPROF_FUNCTIONS_INCLUDE", include);
+      static const bool hasExclude = getRegex("PHIPROF_FUNCTIONS_EXCLUDE", exclude);
+      return (!hasInclude || std::regex_search(label, include)) &&
+         (!hasExclude || !std::regex_search(label, exclude));
+   }
+
+   NO_INSTRUMENT Function* resolve(void *address){
+      Function *function = new Function;
+      Dl_info info;
+      if(dladdr(address, &info) != 0 && info.dli_sname != NULL) {
+         int status;
+         char *demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+         function->label = status == 0 ? demangled : info.dli_sname;
+         free(demangled);
+      }
+      else {
+         char buffer[32];
+         snprintf(buffer, sizeof(buffer), "%p", address);
+         function->label = buffer;
+      }
+      function->timed = isTimed(function->label);
+      return function;
+   }
+
+   NO_INSTRUMENT const Function* getFunction(void *address){
+      size_t slot = (reinterpret_cast<uintptr_t>(address) * 0x9E3779B97F4A7C15ULL) >> (64 - cacheBits);
+      for(size_t probe = 0; probe < cacheSize; probe++, slot = (slot + 1) % cacheSize) {
+         void *cached = cacheAddresses[slot].load(std::memory_order_acquire);
+         if(cached == NULL && cacheAddresses[slot].compare_exchange_strong(cached, address))
+            cached = address;
+         if(cached != address)
+            continue;
+
+         const Function *function = cacheFunctions[slot].load(std::memory_order_acquire);
+         if(function == NULL) {
+            //threads that find the slot before it is published resolve
+            //the function too, the first one is kept
+            Function *resolved = resolve(address);
+            if(cacheFunctions[slot].compare_exchange_strong(function, resolved))
+               function = resolved;
+            else
+               delete resolved;
+         }
+         return function;
+      }
+      return NULL;
+   }
+
+   struct CallHash {
+      NO_INSTRUMENT size_t operator()(const std::pair<void*, int> &call) const{
+         return std::hash<void*>()(call.first) ^ (std::hash<int>()(call.second) << 1);
+      }
+   };
+
+   NO_INSTRUMENT int getTimerId(void *address, const Function &function){
+      //timer ids of each function under each parent, per thread so that
+      //the lookup needs no locking. Never freed, like callStack.
+      thread_local std::unordered_map<std::pair<void*, int>, int, CallHash> *ids = NULL;
+      if(ids == NULL)
+         ids = new std::unordered_map<std::pair<void*, int>, int, CallHash>;
+      const int parentId = phiprof::instrumentation::getCurrentId();
+      auto it = ids->find(std::make_pair(address, parentId));
+      if(it != ids->end())
+         return it->second;
+      const int id = phiprof::initializeTimer(function.label, "Functions");
+      (*ids)[std::make_pair(address, parentId)] = id;
+      return id;
+   }
+
+   NO_INSTRUMENT void enterFunction(void *address){
+      if(depth >= maxDepth) {
+         depth++;
+         return;
+      }
+      Call &call = callStack[depth];
+      const Call *caller = depth > 0 ? &callStack[depth - 1] : NULL;
+      depth++;
+      call.address = address;
+      if(caller != NULL && caller->address == address && caller->id >= 0 &&
+         caller->id == phiprof::instrumentation::getCurrentId()) {
+         call.id = caller->id;
+         call.started = false;
+         return;
+      }
+      call.id = -1;
+      if(phiprof::instrumentation::isEnabled()) {
+         const Function *function = getFunction(address);
+         if(function != NULL && function->timed) {
+            call.id = getTimerId(address, *function);
+            phiprof::start(call.id);
+         }
+      }
+      call.started = call.id >= 0;
+   }
+
+   NO_INSTRUMENT void exitFunction(){
+      if(depth == 0)
+         return;
+      depth--;
+      if(depth < maxDepth && callStack[depth].started)
+         phiprof::stop(callStack[depth].id);
+   }
+}
+
+extern "C" {
+
+//calls made by the hooks themselves enter and exit while inHook is
+//set, so they are skipped in pairs and the call stack stays balanced
+NO_INSTRUMENT void __cyg_profile_func_enter(void *address, void *){
+   if(inHook)
+      return;
+   inHook = true;
+   enterFunction(address);
+   inHook = false;
+}
+
+NO_INSTRUMENT void __cyg_profile_func_exit(void *, void *){
+   if(inHook)
+      return;
+   inHook = true;
+   exitFunction();
+   inHook = false;
+}
+
+}
@@ -0,0 +1,486 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+/*
+  PMPI wrappers that time MPI calls automatically. Each call is timed
+  in a timer called after the MPI function (e.g. MPI_Allreduce) in the
+  group MPI, under the active timer of the calling thread. The bytes
+  sent and received are recorded as workunits where they are known
+  when the call returns. Calls are only timed once phiprof has been
+  initialized, and not while phiprof itself communicates.
+
+  Point-to-point sends are also recorded per destination rank for the
+  communication matrix (PHIPROF_PRINTS=comm-matrix), attributed to the
+  timer that is active when the send is made.
+
+  Link with -lphiprof_mpi -lphiprof before the MPI library, or preload
+  libphiprof_mpi.so into a program linked with the shared libphiprof.
+*/
+
+#include <vector>
+#include <mutex>
+#include "mpi.h"
+#include "phiprof.hpp"
+#include "instrumentation.hpp"
+
+namespace {
+   enum MpiFunction {
+      SEND, SSEND, BSEND, RECV, SENDRECV, SENDRECV_REPLACE, ISEND, ISSEND, IRECV,
+      WAIT, WAITALL, WAITANY, WAITSOME, TEST, TESTALL, PROBE, IPROBE,
+      BARRIER, BCAST, REDUCE, ALLREDUCE, GATHER, GATHERV, SCATTER, SCATTERV,
+      ALLGATHER, ALLGATHERV, ALLTOALL, ALLTOALLV, REDUCE_SCATTER_BLOCK, SCAN, EXSCAN,
+      IBARRIER, IBCAST, IALLREDUCE,
+      nFunctions
+   };
+
+   const char *functionLabels[nFunctions] = {
+      "MPI_Send", "MPI_Ssend", "MPI_Bsend", "MPI_Recv", "MPI_Sendrecv", "MPI_Sendrecv_replace",
+      "MPI_Isend", "MPI_Issend", "MPI_Irecv",
+      "MPI_Wait", "MPI_Waitall", "MPI_Waitany", "MPI_Waitsome", "MPI_Test", "MPI_Testall",
+      "MPI_Probe", "MPI_Iprobe",
+      "MPI_Barrier", "MPI_Bcast", "MPI_Reduce", "MPI_Allreduce", "MPI_Gather", "MPI_Gatherv",
+      "MPI_Scatter", "MPI_Scatterv", "MPI_Allgather", "MPI_Allgatherv", "MPI_Alltoall",
+      "MPI_Alltoallv", "MPI_Reduce_scatter_block", "MPI_Scan", "MPI_Exscan",
+      "MPI_Ibarrier", "MPI_Ibcast", "MPI_Iallreduce"
+   };
+
+   //Times one MPI call. The timer is started in the constructor, and
+   //stopped either with the bytes moved or in the destructor. A
+   //function has to always use one of the two, otherwise the
+   //workunits are not reported.
+   class CallTimer {
+   public:
+      explicit CallTimer(MpiFunction function) : id(-1), parentId(-1) {
+         if(!phiprof::instrumentation::isEnabled())
+            return;
+         //timer ids of each function under each parent, per thread so
+         //that the lookup needs no locking
+         thread_local std::vector<int> ids[nFunctions];
+         parentId = phiprof::instrumentation::getCurrentId();
+         std::vector<int> &functionIds = ids[function];
+         if(parentId >= (int)functionIds.size())
+            functionIds.resize(parentId + 1, -1);
+         if(functionIds[parentId] < 0)
+            functionIds[parentId] = phiprof::initializeTimer(functionLabels[function], "MPI");
+         id = functionIds[parentId];
+         phiprof::start(id);
+      }
+
+      ~CallTimer(){
+         if(id >= 0)
+            phiprof::stop(id);
+      }
+
+      void stop(double bytes){
+         if(id >= 0)
+            phiprof::stop(id, bytes, "B");
+         id = -1;
+      }
+
+      //record a message to dest in comm, has to be called before stop()
+      void addMessage(int dest, MPI_Comm comm, double bytes);
+
+      CallTimer(const CallTimer&) = delete;
+      CallTimer& operator=(const CallTimer&) = delete;
+
+   private:
+      int id;
+      int parentId;
+   };
+
+   int deleteWorldRanks(MPI_Comm, int, void *attributeValue, void *){
+      delete static_cast<std::vector<int>*>(attributeValue);
+      return MPI_SUCCESS;
+   }
+
+   //Translate a rank in comm into a rank in MPI_COMM_WORLD. The ranks
+   //of each communicator are translated once and cached as an
+   //attribute of it, which is freed together with the communicator.
+   //For intercommunicators the rank is in the remote group.
+   int getWorldRank(int rank, MPI_Comm comm){
+      static std::mutex mutex;
+      static int keyval = MPI_KEYVAL_INVALID;
+      std::vector<int> *worldRanks;
+      int found;
+      if(comm == MPI_COMM_WORLD)
+         return rank;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if(keyval == MPI_KEYVAL_INVALID)
+         PMPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, deleteWorldRanks, &keyval, NULL);
+      PMPI_Comm_get_attr(comm, keyval, &worldRanks, &found);
+      if(!found) {
+         MPI_Group group, worldGroup;
+         int isInter, size;
+         PMPI_Comm_test_inter(comm, &isInter);
+         if(isInter)
+            PMPI_Comm_remote_group(comm, &group);
+         else
+            PMPI_Comm_group(comm, &group);
+         PMPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+         PMPI_Group_size(group, &size);
+         std::vector<int> ranks(size);
+         for(int i = 0; i < size; i++)
+            ranks[i] = i;
+         worldRanks = new std::vector<int>(size);
+         PMPI_Group_translate_ranks(group, size, ranks.data(), worldGroup, worldRanks->data());
+         PMPI_Group_free(&group);
+         PMPI_Group_free(&worldGroup);
+         PMPI_Comm_set_attr(comm, keyval, worldRanks);
+      }
+      return rank < (int)worldRanks->size() ? (*worldRanks)[rank] : MPI_UNDEFINED;
+   }
+
+   void CallTimer::addMessage(int dest, MPI_Comm comm, double bytes){
+      if(id < 0 || dest < 0)
+         return; //not timed, or MPI_PROC_NULL
+      const int worldDest = getWorldRank(dest, comm);
+      if(worldDest != MPI_UNDEFINED)
+         phiprof::instrumentation::addMessage(parentId, worldDest, bytes);
+   }
+
+   double getBytes(int count, MPI_Datatype datatype){
+      int size;
+      PMPI_Type_size(datatype, &size);
+      return (double)count * size;
+   }
+
+   double getBytes(const int counts[], int n, MPI_Datatype datatype){
+      double count = 0;
+      for(int i = 0; i < n; i++)
+         count += counts[i];
+      return count * getBytes(1, datatype);
+   }
+
+   double getReceivedBytes(const MPI_Status *status, MPI_Datatype datatype){
+      int count;
+      PMPI_Get_count(status, datatype, &count);
+      return count != MPI_UNDEFINED ? getBytes(count, datatype) : 0.0;
+   }
+
+   int getSize(MPI_Comm comm){
+      int size;
+      PMPI_Comm_size(comm, &size);
+      return size;
+   }
+
+   bool isRoot(int root, MPI_Comm comm){
+      int rank;
+      PMPI_Comm_rank(comm, &rank);
+      return rank == root;
+   }
+}
+
+
+////-------------------------------------------------------------------------
+///  Point-to-point
+////-------------------------------------------------------------------------
+
+extern "C" {
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm){
+   CallTimer timer(SEND);
+   const int result = PMPI_Send(buf, count, datatype, dest, tag, comm);
+   timer.addMessage(dest, comm, getBytes(count, datatype));
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Ssend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm){
+   CallTimer timer(SSEND);
+   const int result = PMPI_Ssend(buf, count, datatype, dest, tag, comm);
+   timer.addMessage(dest, comm, getBytes(count, datatype));
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Bsend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm){
+   CallTimer timer(BSEND);
+   const int result = PMPI_Bsend(buf, count, datatype, dest, tag, comm);
+   timer.addMessage(dest, comm, getBytes(count, datatype));
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status *status){
+   CallTimer timer(RECV);
+   MPI_Status localStatus;
+   if(status == MPI_STATUS_IGNORE)
+      status = &localStatus;
+   const int result = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+   timer.stop(getReceivedBytes(status, datatype));
+   return result;
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status){
+   CallTimer timer(SENDRECV);
+   MPI_Status localStatus;
+   if(status == MPI_STATUS_IGNORE)
+      status = &localStatus;
+   const int result = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag,
+                                    recvbuf, recvcount, recvtype, source, recvtag, comm, status);
+   timer.addMessage(dest, comm, getBytes(sendcount, sendtype));
+   timer.stop(getBytes(sendcount, sendtype) + getReceivedBytes(status, recvtype));
+   return result;
+}
+
+int MPI_Sendrecv_replace(void *buf, int count, MPI_Datatype datatype, int dest, int sendtag,
+                         int source, int recvtag, MPI_Comm comm, MPI_Status *status){
+   CallTimer timer(SENDRECV_REPLACE);
+   MPI_Status localStatus;
+   if(status == MPI_STATUS_IGNORE)
+      status = &localStatus;
+   const int result = PMPI_Sendrecv_replace(buf, count, datatype, dest, sendtag, source, recvtag, comm, status);
+   timer.addMessage(dest, comm, getBytes(count, datatype));
+   timer.stop(getBytes(count, datatype) + getReceivedBytes(status, datatype));
+   return result;
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request *request){
+   CallTimer timer(ISEND);
+   const int result = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+   timer.addMessage(dest, comm, getBytes(count, datatype));
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Issend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+               MPI_Request *request){
+   CallTimer timer(ISSEND);
+   const int result = PMPI_Issend(buf, count, datatype, dest, tag, comm, request);
+   timer.addMessage(dest, comm, getBytes(count, datatype));
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+//the size of the message is not known before completion, the size of
+//the posted buffer is used
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request *request){
+   CallTimer timer(IRECV);
+   const int result = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status){
+   CallTimer timer(WAIT);
+   return PMPI_Wait(request, status);
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status *array_of_statuses){
+   CallTimer timer(WAITALL);
+   return PMPI_Waitall(count, array_of_requests, array_of_statuses);
+}
+
+int MPI_Waitany(int count, MPI_Request array_of_requests[], int *index, MPI_Status *status){
+   CallTimer timer(WAITANY);
+   return PMPI_Waitany(count, array_of_requests, index, status);
+}
+
+int MPI_Waitsome(int incount, MPI_Request array_of_requests[], int *outcount, int array_of_indices[],
+                 MPI_Status array_of_statuses[]){
+   CallTimer timer(WAITSOME);
+   return PMPI_Waitsome(incount, array_of_requests, outcount, array_of_indices, array_of_statuses);
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status){
+   CallTimer timer(TEST);
+   return PMPI_Test(request, flag, status);
+}
+
+int MPI_Testall(int count, MPI_Request array_of_requests[], int *flag, MPI_Status array_of_statuses[]){
+   CallTimer timer(TESTALL);
+   return PMPI_Testall(count, array_of_requests, flag, array_of_statuses);
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status){
+   CallTimer timer(PROBE);
+   return PMPI_Probe(source, tag, comm, status);
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status){
+   CallTimer timer(IPROBE);
+   return PMPI_Iprobe(source, tag, comm, flag, status);
+}
+
+
+////-------------------------------------------------------------------------
+///  Collectives, bytes are the data sent plus received by this process
+////-------------------------------------------------------------------------
+
+int MPI_Barrier(MPI_Comm comm){
+   CallTimer timer(BARRIER);
+   return PMPI_Barrier(comm);
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm){
+   CallTimer timer(BCAST);
+   const int result = PMPI_Bcast(buffer, count, datatype, root, comm);
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Reduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+               int root, MPI_Comm comm){
+   CallTimer timer(REDUCE);
+   const int result = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+   timer.stop(getBytes(count, datatype) * (isRoot(root, comm) ? 2 : 1));
+   return result;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                  MPI_Comm comm){
+   CallTimer timer(ALLREDUCE);
+   const int result = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+   timer.stop(2 * getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm){
+   CallTimer timer(GATHER);
+   const int result = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+   double bytes = sendbuf != MPI_IN_PLACE ? getBytes(sendcount, sendtype) : 0.0;
+   if(isRoot(root, comm))
+      bytes += getBytes(recvcount, recvtype) * getSize(comm);
+   timer.stop(bytes);
+   return result;
+}
+
+int MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                const int recvcounts[], const int displs[], MPI_Datatype recvtype, int root, MPI_Comm comm){
+   CallTimer timer(GATHERV);
+   const int result = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, root, comm);
+   double bytes = sendbuf != MPI_IN_PLACE ? getBytes(sendcount, sendtype) : 0.0;
+   if(isRoot(root, comm))
+      bytes += getBytes(recvcounts, getSize(comm), recvtype);
+   timer.stop(bytes);
+   return result;
+}
+
+int MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                MPI_Datatype recvtype, int root, MPI_Comm comm){
+   CallTimer timer(SCATTER);
+   const int result = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, root, comm);
+   double bytes = recvbuf != MPI_IN_PLACE ? getBytes(recvcount, recvtype) : 0.0;
+   if(isRoot(root, comm))
+      bytes += getBytes(sendcount, sendtype) * getSize(comm);
+   timer.stop(bytes);
+   return result;
+}
+
+int MPI_Scatterv(const void *sendbuf, const int sendcounts[], const int displs[], MPI_Datatype sendtype,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int root, MPI_Comm comm){
+   CallTimer timer(SCATTERV);
+   const int result = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf, recvcount, recvtype, root, comm);
+   double bytes = recvbuf != MPI_IN_PLACE ? getBytes(recvcount, recvtype) : 0.0;
+   if(isRoot(root, comm))
+      bytes += getBytes(sendcounts, getSize(comm), sendtype);
+   timer.stop(bytes);
+   return result;
+}
+
+int MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                  MPI_Datatype recvtype, MPI_Comm comm){
+   CallTimer timer(ALLGATHER);
+   const int result = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+   double bytes = sendbuf != MPI_IN_PLACE ? getBytes(sendcount, sendtype) : 0.0;
+   timer.stop(bytes + getBytes(recvcount, recvtype) * getSize(comm));
+   return result;
+}
+
+int MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                   const int recvcounts[], const int displs[], MPI_Datatype recvtype, MPI_Comm comm){
+   CallTimer timer(ALLGATHERV);
+   const int result = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf, recvcounts, displs, recvtype, comm);
+   double bytes = sendbuf != MPI_IN_PLACE ? getBytes(sendcount, sendtype) : 0.0;
+   timer.stop(bytes + getBytes(recvcounts, getSize(comm), recvtype));
+   return result;
+}
+
+int MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+                 MPI_Datatype recvtype, MPI_Comm comm){
+   CallTimer timer(ALLTOALL);
+   const int result = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf, recvcount, recvtype, comm);
+   double bytes = sendbuf != MPI_IN_PLACE ? getBytes(sendcount, sendtype) * getSize(comm) : 0.0;
+   timer.stop(bytes + getBytes(recvcount, recvtype) * getSize(comm));
+   return result;
+}
+
+int MPI_Alltoallv(const void *sendbuf, const int sendcounts[], const int sdispls[], MPI_Datatype sendtype,
+                  void *recvbuf, const int recvcounts[], const int rdispls[], MPI_Datatype recvtype,
+                  MPI_Comm comm){
+   CallTimer timer(ALLTOALLV);
+   const int result = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype,
+                                     recvbuf, recvcounts, rdispls, recvtype, comm);
+   double bytes = sendbuf != MPI_IN_PLACE ? getBytes(sendcounts, getSize(comm), sendtype) : 0.0;
+   timer.stop(bytes + getBytes(recvcounts, getSize(comm), recvtype));
+   return result;
+}
+
+int MPI_Reduce_scatter_block(const void *sendbuf, void *recvbuf, int recvcount, MPI_Datatype datatype,
+                             MPI_Op op, MPI_Comm comm){
+   CallTimer timer(REDUCE_SCATTER_BLOCK);
+   const int result = PMPI_Reduce_scatter_block(sendbuf, recvbuf, recvcount, datatype, op, comm);
+   timer.stop(getBytes(recvcount, datatype) * (getSize(comm) + 1));
+   return result;
+}
+
+int MPI_Scan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm){
+   CallTimer timer(SCAN);
+   const int result = PMPI_Scan(sendbuf, recvbuf, count, datatype, op, comm);
+   timer.stop(2 * getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Exscan(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm){
+   CallTimer timer(EXSCAN);
+   const int result = PMPI_Exscan(sendbuf, recvbuf, count, datatype, op, comm);
+   timer.stop(2 * getBytes(count, datatype));
+   return result;
+}
+
+//nonblocking collectives only time the initiation, completion is in the waits
+int MPI_Ibarrier(MPI_Comm comm, MPI_Request *request){
+   CallTimer timer(IBARRIER);
+   return PMPI_Ibarrier(comm, request);
+}
+
+int MPI_Ibcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm, MPI_Request *request){
+   CallTimer timer(IBCAST);
+   const int result = PMPI_Ibcast(buffer, count, datatype, root, comm, request);
+   timer.stop(getBytes(count, datatype));
+   return result;
+}
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                   MPI_Comm comm, MPI_Request *request){
+   CallTimer timer(IALLREDUCE);
+   const int result = PMPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, comm, request);
+   timer.stop(2 * getBytes(count, datatype));
+   return result;
+}
+
+}
@@ -0,0 +1,224 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+/*
+  OMPT tool that times OpenMP regions automatically. On each thread of
+  an outermost parallel region the implicit task is timed in the timer
+  "omp parallel", under the active timer of the thread, until the
+  thread reaches the implicit barrier at the end of the region. The
+  time threads wait in the region in barriers, taskwait, taskgroup,
+  locks, critical and ordered regions is timed in timers under it
+  (e.g. "omp barrier"). All timers are in the group OpenMP.
+
+  The timers are per thread, so the thread imbalance of "omp parallel"
+  in the reports is the time threads idle in the barrier at the end of
+  the region, and the imbalance of the wait timers shows which threads
+  waited. The barrier at the end of the region is not timed itself,
+  since e.g. LLVM libomp reports its end on the worker threads only
+  when they start the next region.
+
+  The OpenMP runtime activates the tool by calling ompt_start_tool,
+  this requires a runtime with OMPT support (e.g. LLVM libomp, not
+  GCC libgomp) and omp-tools.h at compile time. Nested
+  parallel regions are not timed, and the tool does nothing before
+  phiprof has been initialized or while phiprof itself
+  communicates. It can be disabled with OMP_TOOL=disabled.
+*/
+
+#if defined(_OPENMP) && defined(__has_include)
+#if __has_include(<omp-tools.h>)
+#define PHIPROF_OMPT
+#endif
+#endif
+
+#ifdef PHIPROF_OMPT
+#include <vector>
+#include <omp-tools.h>
+#include "phiprof.hpp"
+#include "instrumentation.hpp"
+
+namespace {
+   enum OmpRegion {
+      PARALLEL, IMPLICIT_BARRIER, BARRIER, TASKWAIT, TASKGROUP,
+      LOCK, CRITICAL, ORDERED,
+      nRegions
+   };
+
+   //ompt_sync_region_barrier_implicit, without its deprecation warning
+   const int barrierImplicit = 2;
+
+   const char *regionLabels[nRegions] = {
+      "omp parallel", "omp implicit barrier", "omp barrier", "omp taskwait", "omp taskgroup",
+      "omp lock", "omp critical", "omp ordered"
+   };
+
+   //State of each thread. The level of the parallel region the thread
+   //is in (0 outside), and the timers it has active. parallelId is -1
+   //outside timed implicit tasks.
+   struct ThreadState {
+      int level = 0;
+      int parallelId = -1;
+      int waitId = -1;
+      bool inCallback = false; //phiprof itself uses critical regions
+   };
+   thread_local ThreadState state;
+
+   //Start the timer of a region under the active timer of the thread
+   int startRegion(OmpRegion region){
+      //timer ids of each region under each parent, per thread so that
+      //the lookup needs no locking
+      thread_local std::vector<int> ids[nRegions];
+      const int parentId = phiprof::instrumentation::getCurrentId();
+      std::vector<int> &regionIds = ids[region];
+      if(parentId >= (int)regionIds.size())
+         regionIds.resize(parentId + 1, -1);
+      if(regionIds[parentId] < 0) {
+         state.inCallback = true;
+         regionIds[parentId] = phiprof::initializeTimer(regionLabels[region], "OpenMP");
+         state.inCallback = false;
+      }
+      phiprof::start(regionIds[parentId]);
+      return regionIds[parentId];
+   }
+
+   bool isTimed(){
+      return state.level <= 1 && !state.inCallback && phiprof::instrumentation::isEnabled();
+   }
+
+   //waits are only timed in timed implicit tasks
+   void startWait(OmpRegion region){
+      if(isTimed() && state.waitId < 0 && state.parallelId >= 0)
+         state.waitId = startRegion(region);
+   }
+
+   void stopParallel(){
+      if(state.parallelId >= 0)
+         phiprof::stop(state.parallelId);
+      state.parallelId = -1;
+   }
+
+   void stopWait(){
+      if(state.waitId >= 0)
+         phiprof::stop(state.waitId);
+      state.waitId = -1;
+   }
+
+   void onParallelBegin(ompt_data_t *, const ompt_frame_t *, ompt_data_t *parallelData,
+                        unsigned int, int, const void *){
+      parallelData->value = state.level + 1;
+   }
+
+   void onImplicitTask(ompt_scope_endpoint_t endpoint, ompt_data_t *parallelData, ompt_data_t *,
+                       unsigned int, unsigned int, int flags){
+      if(flags & ompt_task_initial)
+         return;
+      if(endpoint == ompt_scope_begin) {
+         state.level = parallelData->value;
+         if(isTimed())
+            state.parallelId = startRegion(PARALLEL);
+      }
+      else if(endpoint == ompt_scope_end) {
+         stopWait();
+         stopParallel();
+         state.level--;
+      }
+   }
+
+   void onSyncRegionWait(ompt_sync_region_t kind, ompt_scope_endpoint_t endpoint,
+                         ompt_data_t *, ompt_data_t *, const void *){
+      if(endpoint == ompt_scope_end) {
+         stopWait();
+         return;
+      }
+      //OpenMP 5.0 runtimes report the barrier at the end of the region
+      //as ompt_sync_region_barrier_implicit, deprecated in 5.1
+      if(kind == ompt_sync_region_barrier_implicit_parallel || kind == barrierImplicit) {
+         //end of the region for this thread
+         stopWait();
+         stopParallel();
+         return;
+      }
+      switch(kind) {
+         case ompt_sync_region_barrier_implicit_workshare:
+            startWait(IMPLICIT_BARRIER);
+            break;
+         //e.g. LLVM libomp reports all barriers of GCC compiled code as
+         //implementation barriers
+         case ompt_sync_region_barrier_explicit:
+         case ompt_sync_region_barrier_implementation:
+            startWait(BARRIER);
+            break;
+         case ompt_sync_region_taskwait:
+            startWait(TASKWAIT);
+            break;
+         case ompt_sync_region_taskgroup:
+            startWait(TASKGROUP);
+            break;
+         default:
+            break;
+      }
+   }
+
+   //test locks and atomics do not wait
+   void onMutexAcquire(ompt_mutex_t kind, unsigned int, unsigned int, ompt_wait_id_t, const void *){
+      switch(kind) {
+         case ompt_mutex_lock:
+         case ompt_mutex_nest_lock:
+            startWait(LOCK);
+            break;
+         case ompt_mutex_critical:
+            startWait(CRITICAL);
+            break;
+         case ompt_mutex_ordered:
+            startWait(ORDERED);
+            break;
+         default:
+            break;
+      }
+   }
+
+   void onMutexAcquired(ompt_mutex_t, ompt_wait_id_t, const void *){
+      if(!state.inCallback)
+         stopWait();
+   }
+
+   int initializeTool(ompt_function_lookup_t lookup, int, ompt_data_t *){
+      ompt_set_callback_t setCallback = (ompt_set_callback_t)lookup("ompt_set_callback");
+      if(setCallback == NULL)
+         return 0;
+      setCallback(ompt_callback_parallel_begin, (ompt_callback_t)onParallelBegin);
+      setCallback(ompt_callback_implicit_task, (ompt_callback_t)onImplicitTask);
+      setCallback(ompt_callback_sync_region_wait, (ompt_callback_t)onSyncRegionWait);
+      setCallback(ompt_callback_mutex_acquire, (ompt_callback_t)onMutexAcquire);
+      setCallback(ompt_callback_mutex_acquired, (ompt_callback_t)onMutexAcquired);
+      return 1; //keep the tool active
+   }
+
+   void finalizeTool(ompt_data_t *){}
+}
+
+extern "C" ompt_start_tool_result_t* ompt_start_tool(unsigned int, const char *){
+   static ompt_start_tool_result_t result = {initializeTool, finalizeTool, {0}};
+   return &result;
+}
+
+#endif
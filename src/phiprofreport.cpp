@@ -0,0 +1,164 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include "timerdump.hpp"
+#include "timerreport.hpp"
+
+/*
+  phiprof-report regenerates the reports of phiprof::print from a
+  dump written by phiprof::dump. The ranks, the subtree, the sorting
+  and the fraction of time under which timers are hidden can all be
+  chosen freely.
+*/
+
+namespace {
+   void usage(const char *name){
+      std::cerr << "Usage: " << name << " [options] dumpfile" << std::endl
+                << "  -p styles    comma separated print styles, groups,compact,full,detailed,json,csv,flame,flame-max," << std::endl
+                << "               heatmap,heatmap-image,clusters,imbalance,self,flat (default groups,compact)" << std::endl
+                << "  -m fraction  only print timers with at least this fraction of total time" << std::endl
+                << "  -s path      only print the subtree starting at the timer with this full label, e.g. /solve/halo" << std::endl
+                << "  -r ranks     only use these ranks, e.g. 0-15,32" << std::endl
+                << "  -k key       sort children by id (default), time, max, imbalance, count or self" << std::endl
+                << "  -o file      write the report into file instead of standard output" << std::endl;
+   }
+
+   bool parseRanks(const std::string &list, int nRanks, std::vector<bool> &selected){
+      std::stringstream stream(list);
+      std::string range;
+      selected.assign(nRanks, false);
+      while(std::getline(stream, range, ',')) {
+         int first, last;
+         char dash;
+         std::stringstream rangeStream(range);
+         if(!(rangeStream >> first))
+            return false;
+         if(rangeStream >> dash) {
+            if(dash != '-' || !(rangeStream >> last))
+               return false;
+         }
+         else {
+            last = first;
+         }
+         for(int rank = std::max(first, 0); rank <= std::min(last, nRanks - 1); rank++)
+            selected[rank] = true;
+      }
+      return true;
+   }
+}
+
+
+int main(int argc, char **argv){
+   std::string prints = "groups,compact";
+   std::string subtree;
+   std::string rankList;
+   std::string sortKey = "id";
+   std::string outputName;
+   std::string dumpName;
+   double minFraction = -1.0;
+
+   for(int i = 1; i < argc; i++){
+      const std::string option = argv[i];
+      if(option.size() == 2 && option[0] == '-' && i + 1 < argc) {
+         const std::string value = argv[++i];
+         switch(option[1]) {
+            case 'p': prints = value; break;
+            case 'm': minFraction = atof(value.c_str()); break;
+            case 's': subtree = value; break;
+            case 'r': rankList = value; break;
+            case 'k': sortKey = value; break;
+            case 'o': outputName = value; break;
+            default:
+               usage(argv[0]);
+               return 1;
+         }
+      }
+      else if(dumpName.size() == 0 && option[0] != '-') {
+         dumpName = option;
+      }
+      else {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+   if(dumpName.size() == 0) {
+      usage(argv[0]);
+      return 1;
+   }
+
+   TimerDump dump;
+   if(!dump.read(dumpName))
+      return 1;
+
+   std::vector<bool> selected(dump.getNumRanks(), true);
+   if(rankList.size() > 0 && !parseRanks(rankList, dump.getNumRanks(), selected)) {
+      std::cerr << "PHIPROF-ERROR: Could not parse rank list " << rankList << std::endl;
+      return 1;
+   }
+
+   int subtreeIndex = 0;
+   if(subtree.size() > 0) {
+      subtreeIndex = dump.getDictionary().findFullLabel(subtree);
+      if(subtreeIndex < 0) {
+         std::cerr << "PHIPROF-ERROR: Timer " << subtree << " does not exist in " << dumpName << std::endl;
+         return 1;
+      }
+   }
+
+   TimerReport report;
+   report.collect(dump, selected, subtreeIndex);
+   if(!report.sortTimers(sortKey)) {
+      std::cerr << "PHIPROF-ERROR: Unknown sort key " << sortKey << std::endl;
+      return 1;
+   }
+
+   if(prints.find("heatmap") != std::string::npos)
+      report.collectRankTimes(dump, selected);
+   if(prints.find("flame-max") != std::string::npos)
+      report.collectSlowestTimes(dump);
+   if(prints.find("clusters") != std::string::npos)
+      report.collectClusters(dump, selected);
+
+   std::ofstream outputFile;
+   if(outputName.size() > 0) {
+      outputFile.open(outputName);
+      if(!outputFile.good()) {
+         std::cerr << "PHIPROF-ERROR: Could not open " << outputName << " for writing" << std::endl;
+         return 1;
+      }
+   }
+   std::ostream &output = outputName.size() > 0 ? outputFile : std::cout;
+   std::stringstream printStream(prints);
+   std::string style;
+   while(std::getline(printStream, style, ',')) {
+      if(TimerReport::isPrintStyle(style))
+         report.print(style, output, minFraction);
+      else if(style.size() > 0)
+         std::cerr << "phiprof warning: nonexistent print style " << style << std::endl;
+   }
+   return 0;
+}
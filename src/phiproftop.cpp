@@ -0,0 +1,159 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include "sharedcounters.hpp"
+#include "prettyprinttable.hpp"
+#include "common.hpp"
+
+/*
+  phiprof-top shows the live counters that the processes on this node
+  publish into shared memory when run with PHIPROF_SHM=1. Timers are
+  matched by their label path over the processes. For each timer it
+  shows the time and its imbalance over the processes, and the rates
+  over the last interval: the share of the wall time spent in the
+  timer, calls and workunits per second. Active is the number of
+  threads of all processes that are in the timer right now.
+*/
+
+namespace {
+   void usage(const char *name){
+      std::cerr << "Usage: " << name << " [options]" << std::endl
+                << "  -d seconds   interval between updates (default 2)" << std::endl
+                << "  -n count     number of updates, 0 runs until interrupted (default 0)" << std::endl
+                << "  -m fraction  only show timers with at least this fraction of total time (default 0.01)" << std::endl;
+   }
+
+   typedef NodeCounters::Path Path;
+   typedef NodeCounters::Totals Totals;
+
+   void print(const std::map<Path, Totals> &totals, const std::map<Path, Totals> &previous,
+              int nRanks, double interval, double minFraction, std::ostream &output){
+      char hostname[256] = "";
+      gethostname(hostname, sizeof(hostname) - 1);
+      std::stringstream buffer;
+      buffer << "phiprof-top on " << hostname << ", " << nRanks << " processes, rates over "
+             << interval << " s";
+      PrettyPrintTable table;
+      table.addTitle(buffer.str());
+      table.addHorizontalLine();
+      table.addElement("", 3);
+      table.addElement("Time (s)", 3);
+      table.addElement("Rates", 3);
+      table.addHorizontalLine();
+      table.addElement("Name");
+      table.addElement("Ranks");
+      table.addElement("Active");
+      table.addElement("Avg");
+      table.addElement("Max");
+      table.addElement("Imb %");
+      table.addElement("Busy %");
+      table.addElement("Calls/s");
+      table.addElement("Units/s");
+      table.addHorizontalLine();
+
+      double totalTime = 0.0;
+      for(const auto &t : totals) {
+         if(t.first.size() == 1)
+            totalTime = std::max(totalTime, t.second.time / t.second.ranks);
+      }
+      //paths are ordered so that children follow their parent
+      for(const auto &t : totals) {
+         const Totals &total = t.second;
+         const double average = total.time / total.ranks;
+         if(average < minFraction * totalTime && total.active == 0)
+            continue;
+         Totals before;
+         auto it = previous.find(t.first);
+         if(it != previous.end())
+            before = it->second;
+         table.addRow();
+         table.addElement(t.first.back(), 1, t.first.size() - 1);
+         table.addElement(total.ranks);
+         table.addElement(total.active);
+         table.addElement(average);
+         table.addElement(total.timeMax);
+         table.addElement(total.timeMax > 0.0 ? 100.0 * (total.timeMax - average) / total.timeMax : 0.0);
+         table.addElement(100.0 * std::max(total.time - before.time, 0.0) / (interval * total.ranks));
+         table.addElement(std::max(total.count - before.count, 0.0) / interval);
+         table.addElement(std::max(total.workUnits - before.workUnits, 0.0) / interval);
+      }
+      table.addHorizontalLine();
+      table.print(output);
+   }
+}
+
+
+int main(int argc, char **argv){
+   double delay = 2.0;
+   int updates = 0;
+   double minFraction = 0.01;
+
+   for(int i = 1; i < argc; i++){
+      const std::string option = argv[i];
+      if(option.size() == 2 && option[0] == '-' && i + 1 < argc) {
+         const std::string value = argv[++i];
+         switch(option[1]) {
+            case 'd': delay = atof(value.c_str()); break;
+            case 'n': updates = atoi(value.c_str()); break;
+            case 'm': minFraction = atof(value.c_str()); break;
+            default:
+               usage(argv[0]);
+               return 1;
+         }
+      }
+      else {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+   if(delay <= 0.0) {
+      usage(argv[0]);
+      return 1;
+   }
+
+   const bool terminal = isatty(STDOUT_FILENO);
+   NodeCounters node;
+   std::map<Path, Totals> previous, current;
+   node.sample(previous);
+   double previousTime = wTime();
+   for(int update = 0; updates == 0 || update < updates; update++) {
+      usleep(delay * 1.0e6);
+      const int nRanks = node.sample(current);
+      const double now = wTime();
+      if(terminal)
+         std::cout << "\033[H\033[2J"; //clear the screen
+      if(nRanks == 0)
+         std::cout << "No processes publish phiprof counters on this node, run them with PHIPROF_SHM=1" << std::endl;
+      else
+         print(current, previous, nRanks, now - previousTime, minFraction, std::cout);
+      std::cout.flush();
+      previous.swap(current);
+      previousTime = now;
+   }
+   return 0;
+}
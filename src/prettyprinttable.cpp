@@ -76,7 +76,7 @@ void PrettyPrintTable::addRow(){
 }
 
 
-void PrettyPrintTable::print(std::ofstream& output, std::string const& delimeter){
+void PrettyPrintTable::print(std::ostream& output, std::string const& delimeter){
    uint nColumns;
    std::vector<uint> columnWidths;
    
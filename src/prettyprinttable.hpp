@@ -43,7 +43,7 @@ public:
 
    void addElement(double element, uint span = 1);
    void addElement(float element, uint span = 1);
-   void print(std::ofstream& file, std::string const& delimeter = " | ");
+   void print(std::ostream& file, std::string const& delimeter = " | ");
 
 private:
    const int _indentWidth=2; //how many spaces each level is indented
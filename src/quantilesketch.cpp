@@ -0,0 +1,128 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "quantilesketch.hpp"
+
+QuantileSketch::QuantileSketch() : nCentroids(0), totalWeight(0.0),
+                                   min(std::numeric_limits<double>::max()),
+                                   max(-std::numeric_limits<double>::max()) {}
+
+void QuantileSketch::add(double value){
+   QuantileSketch single;
+   single.nCentroids = 1;
+   single.totalWeight = 1.0;
+   single.min = value;
+   single.max = value;
+   single.mean[0] = value;
+   single.weight[0] = 1.0;
+   merge(single);
+}
+
+//Centroids of both sketches are sorted by mean and merged greedily as
+//long as a centroid spans at most one unit of the k1 scale function
+//k(q) = delta / (2 pi) * asin(2q - 1). Its range is delta / 2 and two
+//adjacent centroids always span more than one unit, so with delta =
+//capacity the result fits.
+void QuantileSketch::merge(const QuantileSketch &other){
+   if(other.nCentroids == 0)
+      return;
+   const int n = nCentroids + other.nCentroids;
+   double allMean[2 * capacity];
+   double allWeight[2 * capacity];
+   int order[2 * capacity];
+   for(int i = 0; i < nCentroids; i++){
+      allMean[i] = mean[i];
+      allWeight[i] = weight[i];
+   }
+   for(int i = 0; i < other.nCentroids; i++){
+      allMean[nCentroids + i] = other.mean[i];
+      allWeight[nCentroids + i] = other.weight[i];
+   }
+   for(int i = 0; i < n; i++)
+      order[i] = i;
+   std::sort(order, order + n, [&](int a, int b){ return allMean[a] < allMean[b]; });
+
+   totalWeight += other.totalWeight;
+   min = std::min(min, other.min);
+   max = std::max(max, other.max);
+
+   //few enough values to keep all of them
+   if(n <= capacity) {
+      for(int i = 0; i < n; i++){
+         mean[i] = allMean[order[i]];
+         weight[i] = allWeight[order[i]];
+      }
+      nCentroids = n;
+      return;
+   }
+
+   const double delta = capacity;
+   auto k = [&](double q){ return delta / (2.0 * M_PI) * std::asin(2.0 * std::min(std::max(q, 0.0), 1.0) - 1.0); };
+   nCentroids = 0;
+   double weightBefore = 0.0; //weight of the completed centroids
+   double kLow = k(0.0);
+   mean[0] = allMean[order[0]];
+   weight[0] = allWeight[order[0]];
+   for(int j = 1; j < n; j++){
+      const double w = allWeight[order[j]];
+      const double proposed = weight[nCentroids] + w;
+      if(k((weightBefore + proposed) / totalWeight) - kLow <= 1.0 || nCentroids == capacity - 1) {
+         mean[nCentroids] += (allMean[order[j]] - mean[nCentroids]) * w / proposed;
+         weight[nCentroids] = proposed;
+      }
+      else {
+         weightBefore += weight[nCentroids];
+         kLow = k(weightBefore / totalWeight);
+         nCentroids++;
+         mean[nCentroids] = allMean[order[j]];
+         weight[nCentroids] = w;
+      }
+   }
+   nCentroids++;
+}
+
+//Linear interpolation between centroid midpoints, the tails are
+//interpolated towards the exact minimum and maximum
+double QuantileSketch::getQuantile(double q) const{
+   if(nCentroids == 0)
+      return 0.0;
+   if(nCentroids == 1)
+      return min + std::min(std::max(q, 0.0), 1.0) * (max - min);
+
+   //position in the same units as the weights, with the values of a
+   //sketch of unit weights at 0.5, 1.5, ...
+   const double position = std::min(std::max(q, 0.0), 1.0) * (totalWeight - 1.0) + 0.5;
+   double center = weight[0] / 2.0;
+   if(position <= center)
+      return center > 0.5 ? min + (mean[0] - min) * (position - 0.5) / (center - 0.5) : mean[0];
+   for(int i = 1; i < nCentroids; i++){
+      const double nextCenter = center + (weight[i - 1] + weight[i]) / 2.0;
+      if(position <= nextCenter)
+         return mean[i - 1] + (mean[i] - mean[i - 1]) * (position - center) / (nextCenter - center);
+      center = nextCenter;
+   }
+   const double last = totalWeight - 0.5;
+   return last > center ? mean[nCentroids - 1] + (max - mean[nCentroids - 1]) * (position - center) / (last - center)
+                        : mean[nCentroids - 1];
+}
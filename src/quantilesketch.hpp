@@ -0,0 +1,78 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef QUANTILESKETCH_H
+#define QUANTILESKETCH_H
+#include <stdint.h>
+
+/*
+  Fixed-size mergeable sketch of a distribution of values (a merging
+  t-digest). Up to capacity centroids of (mean, weight) are kept, with
+  small centroids near the tails so that the low and high quantiles
+  stay accurate. Merging two sketches gives again a sketch of the same
+  size, so the sketches of all processes can be reduced with a custom
+  MPI operator while the data volume per value stays constant. The
+  class is trivially copyable and can be sent as raw bytes. With at
+  most capacity values the quantiles are exact (linear interpolation
+  between the sorted values).
+*/
+class QuantileSketch {
+public:
+   static const int capacity = 32;
+
+   QuantileSketch();
+
+   /**
+    * Add one value
+    */
+   void add(double value);
+
+   /**
+    * Add all values of another sketch
+    */
+   void merge(const QuantileSketch &other);
+
+   /**
+    * @param q
+    *   Quantile between 0 and 1, e.g., 0.5 for the median
+    * @return
+    *   Estimate of the quantile, 0 if the sketch is empty
+    */
+   double getQuantile(double q) const;
+
+   /**
+    * @return
+    *   Number of values added
+    */
+   double getWeight() const{
+      return totalWeight;
+   }
+
+private:
+   int32_t nCentroids;
+   double totalWeight;
+   double min;
+   double max;
+   double mean[capacity];
+   double weight[capacity];
+};
+
+#endif
@@ -0,0 +1,295 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include "rundatabase.hpp"
+
+namespace {
+   //columns and the size of one value in them
+   const std::vector<std::pair<std::string, size_t>> columns = {
+      {"label", sizeof(int32_t)}, {"ranks", sizeof(int32_t)},
+      {"average", sizeof(double)}, {"max", sizeof(double)},
+      {"imbalance", sizeof(double)}, {"count", sizeof(double)}};
+
+   //metadata strings are stored tab separated on one line
+   std::string sanitize(std::string value){
+      std::replace(value.begin(), value.end(), '\t', ' ');
+      std::replace(value.begin(), value.end(), '\n', ' ');
+      return value;
+   }
+
+   //labels are stored one per line, backslash and newline are escaped
+   std::string escapeLabel(const std::string &label){
+      std::string escaped;
+      for(char c : label) {
+         if(c == '\\')
+            escaped += "\\\\";
+         else if(c == '\n')
+            escaped += "\\n";
+         else
+            escaped += c;
+      }
+      return escaped;
+   }
+
+   std::string unescapeLabel(const std::string &escaped){
+      std::string label;
+      for(unsigned int i = 0; i < escaped.size(); i++) {
+         if(escaped[i] == '\\' && i + 1 < escaped.size()) {
+            i++;
+            label += escaped[i] == 'n' ? '\n' : escaped[i];
+         }
+         else
+            label += escaped[i];
+      }
+      return label;
+   }
+
+   //exclusive lock on a file, released when destroyed
+   class FileLock {
+   public:
+      FileLock(const std::string &fileName){
+         descriptor = ::open(fileName.c_str(), O_CREAT | O_RDWR, 0644);
+         if(descriptor >= 0 && flock(descriptor, LOCK_EX) != 0) {
+            close(descriptor);
+            descriptor = -1;
+         }
+      }
+      ~FileLock(){
+         if(descriptor >= 0)
+            close(descriptor); //releases the lock
+      }
+      bool isLocked() const { return descriptor >= 0;}
+   private:
+      int descriptor;
+   };
+
+   template<typename T> void appendColumn(std::ofstream &file, const std::vector<T> &values){
+      file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+   }
+}
+
+std::string RunDatabase::path(const std::string &file) const{
+   return directory + "/" + file;
+}
+
+bool RunDatabase::open(const std::string &databaseDirectory){
+   std::error_code error;
+   directory = databaseDirectory;
+   std::filesystem::create_directories(directory, error);
+   if(!std::filesystem::is_directory(directory)) {
+      std::cerr << "PHIPROF-ERROR: Could not create database directory " << directory << std::endl;
+      return false;
+   }
+   return load();
+}
+
+//read the labels and the index of runs
+bool RunDatabase::load(){
+   runs.clear();
+   labels.clear();
+   labelIds.clear();
+   nNewLabels = 0;
+
+   std::ifstream labelFile(path("labels.txt"));
+   std::string line;
+   while(std::getline(labelFile, line)) {
+      const std::string label = unescapeLabel(line);
+      labelIds[label] = labels.size();
+      labels.push_back(label);
+   }
+
+   std::ifstream runFile(path("runs.txt"));
+   while(std::getline(runFile, line)) {
+      std::stringstream fields(line);
+      Run run;
+      if(!(fields >> run.time >> run.nRanks >> run.nThreads >> run.firstRow >> run.nRows)) {
+         std::cerr << "PHIPROF-ERROR: Malformed run " << runs.size() << " in " << path("runs.txt") << std::endl;
+         return false;
+      }
+      fields.get(); //tab before the strings
+      std::getline(fields, run.gitHash, '\t');
+      std::getline(fields, run.input);
+      runs.push_back(run);
+   }
+   return true;
+}
+
+int RunDatabase::getLabelId(const std::string &fullLabel, bool add){
+   auto labelId = labelIds.find(fullLabel);
+   if(labelId != labelIds.end())
+      return labelId->second;
+   if(!add)
+      return -1;
+   labelIds[fullLabel] = labels.size();
+   labels.push_back(fullLabel);
+   nNewLabels++;
+   return labels.size() - 1;
+}
+
+bool RunDatabase::addRun(const Run &newRun, const TimerReport &report){
+   //Other processes may add runs to the same database. The lock on
+   //runs.txt is held from reading the end of the columns to writing the
+   //index, and the labels and runs they added are read first.
+   FileLock lock(path("runs.txt"));
+   if(!lock.isLocked()) {
+      std::cerr << "PHIPROF-ERROR: Could not lock " << path("runs.txt") << std::endl;
+      return false;
+   }
+   if(!load())
+      return false;
+
+   Run run = newRun;
+   run.gitHash = sanitize(run.gitHash);
+   run.input = sanitize(run.input);
+   run.firstRow = runs.size() > 0 ? runs.back().firstRow + runs.back().nRows : 0;
+
+   //one row per timer, the "other" rows are not stored
+   std::vector<std::pair<int32_t, int>> rows; //label id, index in report
+   const TimerReport::TimerStatistics &stats = report.stats;
+   for(unsigned int i = 0; i < stats.id.size(); i++){
+      if(stats.id[i] == -1 || stats.ranksSum[i] == 0)
+         continue;
+      std::string fullLabel = report.dictionary.getFullLabel(stats.id[i]);
+      if(fullLabel.size() == 0)
+         fullLabel = "/"; //root timer
+      rows.push_back(std::make_pair(getLabelId(fullLabel, true), i));
+   }
+   std::sort(rows.begin(), rows.end());
+   run.nRows = rows.size();
+
+   std::vector<int32_t> labelColumn, ranks;
+   std::vector<double> average, max, imbalance, count;
+   for(auto &row: rows){
+      const int i = row.second;
+      labelColumn.push_back(row.first);
+      ranks.push_back(stats.ranksSum[i]);
+      average.push_back(report.getAverage(i));
+      max.push_back(stats.timeMax[i].val);
+      imbalance.push_back(report.getImbalance(i));
+      count.push_back(double(stats.countSum[i]) / stats.ranksSum[i]);
+   }
+
+   std::ofstream labelFile(path("labels.txt"), std::ofstream::app);
+   for(unsigned int label = labels.size() - nNewLabels; label < labels.size(); label++)
+      labelFile << escapeLabel(labels[label]) << std::endl;
+   nNewLabels = 0;
+
+   //drop rows of an interrupted add, then append the new rows
+   std::vector<std::ofstream> files;
+   for(auto &column: columns){
+      const std::string fileName = path(column.first + ".col");
+      const uintmax_t committedBytes = run.firstRow * column.second;
+      std::error_code error;
+      if(std::filesystem::exists(fileName) && std::filesystem::file_size(fileName) > committedBytes)
+         std::filesystem::resize_file(fileName, committedBytes, error);
+      files.emplace_back(fileName, std::ofstream::binary | std::ofstream::app);
+   }
+   appendColumn(files[0], labelColumn);
+   appendColumn(files[1], ranks);
+   appendColumn(files[2], average);
+   appendColumn(files[3], max);
+   appendColumn(files[4], imbalance);
+   appendColumn(files[5], count);
+   bool written = labelFile.good();
+   for(auto &file: files){
+      file.close();
+      written = written && !file.fail();
+   }
+   if(!written) {
+      std::cerr << "PHIPROF-ERROR: Could not write run into " << directory << std::endl;
+      return false;
+   }
+
+   //the run is only part of the database once it is in the index
+   std::ofstream runFile(path("runs.txt"), std::ofstream::app);
+   runFile << run.time << "\t" << run.nRanks << "\t" << run.nThreads << "\t"
+           << run.firstRow << "\t" << run.nRows << "\t" << run.gitHash << "\t" << run.input << std::endl;
+   if(!runFile.good()) {
+      std::cerr << "PHIPROF-ERROR: Could not write run into " << path("runs.txt") << std::endl;
+      return false;
+   }
+   runs.push_back(run);
+   return true;
+}
+
+bool RunDatabase::getTrend(const std::string &fullLabel, const std::string &metric, double outlierThreshold,
+                           std::vector<TrendPoint> &trend) const{
+   trend.clear();
+   auto labelId = labelIds.find(fullLabel);
+   auto column = std::find_if(columns.begin(), columns.end(),
+                              [&](const std::pair<std::string, size_t> &c) { return c.first == metric;});
+   if(labelId == labelIds.end() || column == columns.end() || column == columns.begin())
+      return false;
+
+   std::ifstream labelFile(path("label.col"), std::ifstream::binary);
+   std::ifstream valueFile(path(column->first + ".col"), std::ifstream::binary);
+   std::vector<int32_t> runLabels;
+   for(unsigned int r = 0; r < runs.size(); r++){
+      //rows of a run are sorted by label id
+      runLabels.resize(runs[r].nRows);
+      labelFile.seekg(runs[r].firstRow * sizeof(int32_t));
+      labelFile.read(reinterpret_cast<char*>(runLabels.data()), runLabels.size() * sizeof(int32_t));
+      auto row = std::lower_bound(runLabels.begin(), runLabels.end(), labelId->second);
+      if(!labelFile || row == runLabels.end() || *row != labelId->second)
+         continue;
+      
+      TrendPoint point;
+      point.run = r;
+      point.outlier = false;
+      valueFile.seekg((runs[r].firstRow + (row - runLabels.begin())) * column->second);
+      if(column->second == sizeof(int32_t)) {
+         int32_t value;
+         valueFile.read(reinterpret_cast<char*>(&value), sizeof(value));
+         point.value = value;
+      }
+      else {
+         valueFile.read(reinterpret_cast<char*>(&point.value), sizeof(point.value));
+      }
+      if(!valueFile)
+         return false;
+      trend.push_back(point);
+   }
+
+   //robust outlier detection with the median absolute deviation, 1.4826
+   //scales it to the standard deviation of normally distributed data
+   if(trend.size() > 2) {
+      std::vector<double> values, deviations;
+      for(auto &point: trend)
+         values.push_back(point.value);
+      std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+      const double median = values[values.size() / 2];
+      for(auto &point: trend)
+         deviations.push_back(std::fabs(point.value - median));
+      std::nth_element(deviations.begin(), deviations.begin() + deviations.size() / 2, deviations.end());
+      const double mad = 1.4826 * deviations[deviations.size() / 2];
+      for(auto &point: trend)
+         point.outlier = mad > 0.0 ? std::fabs(point.value - median) > outlierThreshold * mad : point.value != median;
+   }
+   return true;
+}
@@ -0,0 +1,112 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef RUNDATABASE_H
+#define RUNDATABASE_H
+#include <vector>
+#include <string>
+#include <map>
+#include <stdint.h>
+#include "timerreport.hpp"
+
+/*
+  Append-only store of the timer statistics of many runs, kept in a
+  directory on a plain filesystem. The statistics are stored column by
+  column so that the history of one timer can be read without reading
+  all data:
+
+    labels.txt      full label paths, the line number is the label id,
+                    backslashes and newlines are escaped
+    runs.txt        index with one line per run: metadata and the
+                    range of rows of the run in the columns
+    label.col       int32 label id of each row
+    ranks.col       int32 processes that have the timer
+    average.col     double average time over processes
+    max.col         double maximum time over processes
+    imbalance.col   double imbalance between processes
+    count.col       double average count over processes
+
+  The rows of a run are sorted by label id. A run is added by first
+  appending to the columns and then to runs.txt, so an interrupted add
+  leaves only unreferenced rows that are overwritten by the next add.
+  Runs can be added by several processes at the same time, an add holds
+  an exclusive flock on runs.txt.
+*/
+class RunDatabase {
+public:
+   struct Run {
+      int64_t time;        //seconds since epoch
+      int nRanks;
+      int nThreads;
+      std::string gitHash;
+      std::string input;   //name of the input or case
+      int64_t firstRow;
+      int64_t nRows;
+   };
+
+   struct TrendPoint {
+      int run;             //index of the run in getRuns()
+      double value;
+      bool outlier;
+   };
+
+   /**
+    * Open a database, the directory is created if it does not exist
+    *
+    * @return
+    *   Returns false if the database could not be opened
+    */
+   bool open(const std::string &directory);
+
+   /**
+    * Append the statistics of all timers in report as a new run.
+    * time, nRanks and nThreads of the run are set by the caller.
+    */
+   bool addRun(const Run &run, const TimerReport &report);
+
+   const std::vector<Run>& getRuns() const { return runs;}
+
+   /**
+    * Get the history of a timer over all runs that have it.
+    *
+    * @param metric
+    *   One of average, max, imbalance, count or ranks
+    * @param outlierThreshold
+    *   Points further than this many (scaled) median absolute deviations
+    *   from the median are flagged as outliers
+    * @return
+    *   Returns false if the timer or the metric does not exist
+    */
+   bool getTrend(const std::string &fullLabel, const std::string &metric, double outlierThreshold,
+                 std::vector<TrendPoint> &trend) const;
+
+private:
+   std::string path(const std::string &file) const;
+   bool load();
+   int getLabelId(const std::string &fullLabel, bool add);
+
+   std::string directory;
+   std::vector<Run> runs;
+   std::vector<std::string> labels;
+   std::map<std::string, int> labelIds;
+   int nNewLabels; //labels added but not yet written
+};
+
+#endif
@@ -0,0 +1,327 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedcounters.hpp"
+#include "common.hpp"
+
+namespace {
+   const char magic[8] = "PHIPROF";
+   const char prefix[] = "phiprof.";
+
+   //copy a string into a zero terminated field, truncating it
+   void copyString(char *field, const std::string &value, int fieldSize){
+      const size_t length = std::min(value.size(), (size_t)fieldSize - 1);
+      memcpy(field, value.data(), length);
+      field[length] = 0;
+   }
+
+   //string from a field that another process may be writing
+   std::string readString(const char *field, int fieldSize){
+      return std::string(field, strnlen(field, fieldSize));
+   }
+}
+
+SharedCounters::~SharedCounters(){
+   close();
+}
+
+size_t SharedCounters::getSize(int maxTimers, int nThreads){
+   return sizeof(Header) + (size_t)maxTimers * sizeof(Entry) + (size_t)maxTimers * nThreads * sizeof(Slot);
+}
+
+bool SharedCounters::create(int rank, const std::string &job, int maxTimers, int nThreads, double initializeTime){
+   close();
+   name = prefix + std::to_string(getpid());
+   const std::string path = "/" + name;
+   const int fd = shm_open(path.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+   if(fd < 0) {
+      std::cerr << "PHIPROF-ERROR: Could not create shared memory segment " << path << std::endl;
+      return false;
+   }
+   segmentSize = getSize(maxTimers, nThreads);
+   if(ftruncate(fd, segmentSize) != 0) {
+      std::cerr << "PHIPROF-ERROR: Could not allocate " << segmentSize << " bytes for " << path << std::endl;
+      ::close(fd);
+      shm_unlink(path.c_str());
+      return false;
+   }
+   segment = mmap(NULL, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if(segment == MAP_FAILED) {
+      segment = NULL;
+      shm_unlink(path.c_str());
+      return false;
+   }
+   owner = true;
+
+   //the segment is zero-filled, atomics are constructed in place
+   char *bytes = static_cast<char*>(segment);
+   header = new (bytes) Header();
+   entries = reinterpret_cast<Entry*>(bytes + sizeof(Header));
+   slots = reinterpret_cast<Slot*>(bytes + sizeof(Header) + (size_t)maxTimers * sizeof(Entry));
+   for(size_t i = 0; i < (size_t)maxTimers * nThreads; i++)
+      new (&slots[i]) Slot();
+   header->version = version;
+   header->rank = rank;
+   header->pid = getpid();
+   copyString(header->job, job, maxJob);
+   header->maxTimers = maxTimers;
+   header->nThreads = nThreads;
+   header->nTimers.store(0, std::memory_order_relaxed);
+   header->clockVersion.store(0, std::memory_order_relaxed);
+   header->pauseTime.store(-1.0, std::memory_order_relaxed);
+   header->pausedTime.store(0.0, std::memory_order_relaxed);
+   header->initializeTime = initializeTime;
+   //readers check the magic last
+   std::atomic_thread_fence(std::memory_order_release);
+   memcpy(header->magic, magic, sizeof(magic));
+   return true;
+}
+
+bool SharedCounters::open(const std::string &segmentName){
+   close();
+   name = segmentName;
+   const std::string path = "/" + name;
+   const int fd = shm_open(path.c_str(), O_RDONLY, 0);
+   if(fd < 0)
+      return false;
+   struct stat status;
+   if(fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(Header)) {
+      ::close(fd);
+      return false;
+   }
+   segmentSize = status.st_size;
+   segment = mmap(NULL, segmentSize, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if(segment == MAP_FAILED) {
+      segment = NULL;
+      return false;
+   }
+   char *bytes = static_cast<char*>(segment);
+   header = reinterpret_cast<Header*>(bytes);
+   if(memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version ||
+      segmentSize < getSize(header->maxTimers, header->nThreads)) {
+      close();
+      return false;
+   }
+   entries = reinterpret_cast<Entry*>(bytes + sizeof(Header));
+   slots = reinterpret_cast<Slot*>(bytes + sizeof(Header) + (size_t)header->maxTimers * sizeof(Entry));
+   return true;
+}
+
+void SharedCounters::close(){
+   if(segment == NULL)
+      return;
+   munmap(segment, segmentSize);
+   if(owner)
+      shm_unlink(("/" + name).c_str());
+   segment = NULL;
+   header = NULL;
+   entries = NULL;
+   slots = NULL;
+   owner = false;
+}
+
+std::vector<std::string> SharedCounters::list(){
+   std::vector<std::string> names;
+   DIR *directory = opendir("/dev/shm");
+   if(directory == NULL)
+      return names;
+   while(struct dirent *entry = readdir(directory)) {
+      const std::string entryName(entry->d_name);
+      if(entryName.compare(0, strlen(prefix), prefix) != 0)
+         continue;
+      //segments of processes that did not exit cleanly are left out
+      const int pid = atoi(entryName.c_str() + strlen(prefix));
+      if(pid > 0 && kill(pid, 0) == 0)
+         names.push_back(entryName);
+   }
+   closedir(directory);
+   std::sort(names.begin(), names.end());
+   return names;
+}
+
+std::string SharedCounters::getJobId(){
+   for(const char *variable : {"PHIPROF_JOB", "SLURM_JOB_ID", "PBS_JOBID", "LSB_JOBID"}) {
+      const char *value = getenv(variable);
+      if(value != NULL && strlen(value) > 0)
+         return value;
+   }
+   return "";
+}
+
+void SharedCounters::addTimer(int id, int parentId, int level, const std::string &label,
+                              const std::vector<std::string> &groups, const std::string &workUnitLabel){
+   if(segment == NULL || id >= header->maxTimers)
+      return;
+   Entry &entry = entries[id];
+   entry.parentId = parentId;
+   entry.level = level;
+   copyString(entry.label, label, maxLabel);
+   std::string joinedGroups;
+   for(const auto &group : groups)
+      joinedGroups += (joinedGroups.empty() ? "" : ",") + group;
+   copyString(entry.groups, joinedGroups, maxGroups);
+   copyString(entry.workUnitLabel, workUnitLabel, maxWorkUnitLabel);
+   //timers are added in id order
+   header->nTimers.store(id + 1, std::memory_order_release);
+}
+
+//a reader can see a partially written label, it is only used for display
+void SharedCounters::setWorkUnitLabel(int id, const std::string &workUnitLabel){
+   if(segment == NULL || id >= header->maxTimers)
+      return;
+   copyString(entries[id].workUnitLabel, workUnitLabel, maxWorkUnitLabel);
+}
+
+void SharedCounters::setClock(double pauseTime, double pausedTime){
+   if(segment == NULL)
+      return;
+   const uint64_t v = header->clockVersion.load(std::memory_order_relaxed);
+   header->clockVersion.store(v + 1, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+   header->pauseTime.store(pauseTime, std::memory_order_relaxed);
+   header->pausedTime.store(pausedTime, std::memory_order_relaxed);
+   header->clockVersion.store(v + 2, std::memory_order_release);
+}
+
+//publish all values of a slot, used when the counters are reset
+void SharedCounters::publish(int id, int thread, const Values &values){
+   if(segment == NULL || id >= header->maxTimers)
+      return;
+   Slot &s = slot(thread, id);
+   const uint64_t v = beginWrite(s);
+   s.count.store(values.count, std::memory_order_relaxed);
+   s.active.store(values.active, std::memory_order_relaxed);
+   s.time.store(values.time, std::memory_order_relaxed);
+   s.workUnits.store(values.workUnits, std::memory_order_relaxed);
+   s.startTime.store(values.startTime, std::memory_order_relaxed);
+   s.version.store(v + 2, std::memory_order_release);
+}
+
+int SharedCounters::getNumTimers() const{
+   return std::min(header->nTimers.load(std::memory_order_acquire), header->maxTimers);
+}
+
+SharedCounters::Values SharedCounters::read(int id, int thread) const{
+   const Slot &s = slot(thread, id);
+   Values values;
+   uint64_t before, after;
+   do {
+      before = s.version.load(std::memory_order_acquire);
+      values.count = s.count.load(std::memory_order_relaxed);
+      values.active = s.active.load(std::memory_order_relaxed) != 0;
+      values.time = s.time.load(std::memory_order_relaxed);
+      values.workUnits = s.workUnits.load(std::memory_order_relaxed);
+      values.startTime = s.startTime.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = s.version.load(std::memory_order_relaxed);
+   } while(before != after || (before & 1));
+   return values;
+}
+
+double SharedCounters::getClock() const{
+   double pauseTime, pausedTime;
+   uint64_t before, after;
+   do {
+      before = header->clockVersion.load(std::memory_order_acquire);
+      pauseTime = header->pauseTime.load(std::memory_order_relaxed);
+      pausedTime = header->pausedTime.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = header->clockVersion.load(std::memory_order_relaxed);
+   } while(before != after || (before & 1));
+   return pauseTime >= 0.0 ? pauseTime : wTime() - pausedTime;
+}
+
+
+void NodeCounters::setJob(const std::string &jobId){
+   allJobs = false;
+   job = jobId;
+}
+
+int NodeCounters::sample(std::map<Path, Totals> &totals){
+   std::map<std::string, std::unique_ptr<SharedCounters>> alive;
+   for(const auto &name : SharedCounters::list()) {
+      auto it = segments.find(name);
+      if(it != segments.end()) {
+         alive[name] = std::move(it->second);
+      }
+      else {
+         std::unique_ptr<SharedCounters> segment(new SharedCounters);
+         if(segment->open(name) &&
+            (allJobs || readString(segment->getHeader().job, SharedCounters::maxJob) == job))
+            alive[name] = std::move(segment);
+      }
+   }
+   segments.swap(alive);
+
+   totals.clear();
+   for(const auto &s : segments) {
+      const SharedCounters &segment = *s.second;
+      const int nTimers = segment.getNumTimers();
+      const int nThreads = segment.getHeader().nThreads;
+      const double now = segment.getClock();
+      std::vector<Path> paths(nTimers);
+      for(int id = 0; id < nTimers; id++) {
+         const SharedCounters::Entry &entry = segment.getEntry(id);
+         //parents have smaller ids than their children
+         if(entry.parentId >= 0 && entry.parentId < id)
+            paths[id] = paths[entry.parentId];
+         paths[id].push_back(readString(entry.label, SharedCounters::maxLabel));
+
+         Totals local;
+         int timedThreads = 0;
+         for(int thread = 0; thread < nThreads; thread++) {
+            const SharedCounters::Values values = segment.read(id, thread);
+            if(values.count == 0 && !values.active)
+               continue;
+            timedThreads++;
+            local.time += values.time + (values.active ? std::max(now - values.startTime, 0.0) : 0.0);
+            local.count += values.count;
+            local.workUnits += values.workUnits;
+            local.active += values.active;
+         }
+         if(timedThreads == 0)
+            continue;
+         Totals &total = totals[paths[id]];
+         if(total.ranks == 0) {
+            total.groups = readString(entry.groups, SharedCounters::maxGroups);
+            total.workUnitLabel = readString(entry.workUnitLabel, SharedCounters::maxWorkUnitLabel);
+         }
+         total.ranks++;
+         total.active += local.active;
+         total.time += local.time / timedThreads;
+         total.timeMax = std::max(total.timeMax, local.time / timedThreads);
+         total.count += local.count;
+         total.workUnits += local.workUnits;
+      }
+   }
+   return segments.size();
+}
@@ -0,0 +1,242 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef SHAREDCOUNTERS_H
+#define SHAREDCOUNTERS_H
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+
+/*
+  Live counters of the timers of one process in a POSIX shared memory
+  segment, /dev/shm/phiprof.<pid>, for monitoring tools on the same
+  node such as phiprof-top. Layout of the segment:
+
+    Header
+    Entry[maxTimers]             label and parent of each timer
+    Slot[nThreads][maxTimers]    counters of each timer on each thread
+
+  Entries are added by the process under the timer creation lock and
+  published by incrementing nTimers. Each slot has one writer, the
+  thread it belongs to, which updates it when it starts and stops the
+  timer. The writer makes version odd while it updates a slot, so
+  readers retry until they read the same even version before and after
+  the values. Timers beyond maxTimers are not published.
+
+  All fields are lock-free atomics of fixed size, so the segment can be
+  read by another process.
+*/
+class SharedCounters {
+public:
+   static const uint32_t version = 1;
+   static const int maxJob = 64;
+
+   struct Header {
+      char magic[8];      //"PHIPROF" and a terminating zero
+      uint32_t version;
+      int32_t rank;       //rank in MPI_COMM_WORLD
+      int32_t pid;
+      char job[maxJob];   //batch job id, empty if unknown
+      int32_t maxTimers;
+      int32_t nThreads;
+      std::atomic<int32_t> nTimers;
+      std::atomic<uint64_t> clockVersion; //seqlock of the clock fields
+      std::atomic<double> pauseTime;  //profile clock is paused at this time, -1 if running
+      std::atomic<double> pausedTime; //time paused, profile clock = wTime() - pausedTime
+      double initializeTime;          //profile clock at initialization
+   };
+
+   static const int maxLabel = 120;
+   static const int maxGroups = 96;
+   static const int maxWorkUnitLabel = 32;
+   //strings are truncated and zero terminated
+   struct Entry {
+      int32_t parentId;
+      int32_t level;
+      char label[maxLabel];
+      char groups[maxGroups]; //comma separated
+      char workUnitLabel[maxWorkUnitLabel]; //can change when the timer is stopped
+   };
+
+   struct Slot {
+      std::atomic<uint64_t> version;
+      std::atomic<int64_t> count;
+      std::atomic<int64_t> active;
+      std::atomic<double> time;      //time of stopped intervals
+      std::atomic<double> workUnits;
+      std::atomic<double> startTime; //profile clock time of the running interval
+   };
+
+   //values of one timer on one thread, read from a slot
+   struct Values {
+      int64_t count = 0;
+      bool active = false;
+      double time = 0.0;
+      double workUnits = 0.0;
+      double startTime = 0.0;
+   };
+
+   SharedCounters() = default;
+   SharedCounters(const SharedCounters&) = delete;
+   SharedCounters& operator=(const SharedCounters&) = delete;
+   ~SharedCounters();
+
+   /**
+    * Create the segment of this process, replacing an existing one.
+    *
+    * @return
+    *   Returns false if the segment could not be created.
+    */
+   bool create(int rank, const std::string &job, int maxTimers, int nThreads, double initializeTime);
+
+   /**
+    * Map the segment of another process read-only.
+    *
+    * @param name
+    *   Name of the segment, e.g. phiprof.1234
+    * @return
+    *   Returns false if it is not a valid segment.
+    */
+   bool open(const std::string &name);
+
+   /**
+    * Unmap the segment, and remove it if this process created it.
+    */
+   void close();
+
+   bool isOpen() const { return segment != NULL;}
+
+   /**
+    * Names of the segments in /dev/shm whose process is still alive.
+    */
+   static std::vector<std::string> list();
+
+   /**
+    * Id of the batch job of this process from PHIPROF_JOB, or the
+    * variables of Slurm, PBS and LSF. Empty if none is set.
+    */
+   static std::string getJobId();
+
+   //writer side, called by the process that created the segment
+   void addTimer(int id, int parentId, int level, const std::string &label,
+                 const std::vector<std::string> &groups, const std::string &workUnitLabel);
+   void setWorkUnitLabel(int id, const std::string &workUnitLabel);
+   void setClock(double pauseTime, double pausedTime);
+
+   void publishStart(int id, int thread, double startTime){
+      if(id < header->maxTimers) {
+         Slot &s = slot(thread, id);
+         const uint64_t v = beginWrite(s);
+         s.startTime.store(startTime, std::memory_order_relaxed);
+         s.active.store(1, std::memory_order_relaxed);
+         s.version.store(v + 2, std::memory_order_release);
+      }
+   }
+
+   void publishStop(int id, int thread, int64_t count, double time, double workUnits){
+      if(id < header->maxTimers) {
+         Slot &s = slot(thread, id);
+         const uint64_t v = beginWrite(s);
+         s.count.store(count, std::memory_order_relaxed);
+         s.time.store(time, std::memory_order_relaxed);
+         s.workUnits.store(workUnits, std::memory_order_relaxed);
+         s.active.store(0, std::memory_order_relaxed);
+         s.version.store(v + 2, std::memory_order_release);
+      }
+   }
+
+   void publish(int id, int thread, const Values &values);
+
+   //reader side
+   const Header& getHeader() const { return *header;}
+   int getNumTimers() const;
+   const Entry& getEntry(int id) const { return entries[id];}
+   Values read(int id, int thread) const;
+   double getClock() const; //current profile clock of the process
+
+private:
+   Slot& slot(int thread, int id) const{
+      return slots[(size_t)thread * header->maxTimers + id];
+   }
+
+   static uint64_t beginWrite(Slot &s){
+      const uint64_t v = s.version.load(std::memory_order_relaxed);
+      s.version.store(v + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      return v;
+   }
+
+   static size_t getSize(int maxTimers, int nThreads);
+
+   void *segment = NULL;
+   size_t segmentSize = 0;
+   std::string name;
+   bool owner = false;
+   Header *header = NULL;
+   Entry *entries = NULL;
+   Slot *slots = NULL;
+};
+
+
+/*
+  Shared counters of the processes on this node, summed by timer label
+  path. Segments stay open between samples.
+*/
+class NodeCounters {
+public:
+   typedef std::vector<std::string> Path;
+
+   //values of one timer path, summed over the processes
+   struct Totals {
+      int ranks = 0;
+      int active = 0;      //threads in the timer now
+      double time = 0.0;   //sum over processes of the average over threads
+      double timeMax = 0.0;
+      double count = 0.0;  //sum over processes and threads
+      double workUnits = 0.0;
+      std::string groups;
+      std::string workUnitLabel;
+   };
+
+   /**
+    * Only read the processes of one job, see SharedCounters::getJobId.
+    * By default all processes are read.
+    */
+   void setJob(const std::string &jobId);
+
+   /**
+    * Read the counters of all live processes.
+    *
+    * @return
+    *   The number of processes read
+    */
+   int sample(std::map<Path, Totals> &totals);
+
+private:
+   bool allJobs = true;
+   std::string job;
+   std::map<std::string, std::unique_ptr<SharedCounters>> segments;
+};
+
+#endif
@@ -17,8 +17,76 @@ You should have received a copy of the GNU Lesser General Public
 License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 
 */
+#include <mutex>
+#include <unordered_set>
+#include <unordered_map>
+#include <set>
 #include "timerdata.hpp"
+
 int TimerData::numThreads = 1;
 int TimerData::thread = 0;
+std::atomic<double> TimerData::pauseTime{-1.0};
+std::atomic<double> TimerData::pausedTime{0.0};
+
+namespace {
+   //interned strings, groups lists and the bits of groups. Node based
+   //containers, so that the elements do not move.
+   struct InternPool {
+      std::mutex mutex;
+      std::unordered_set<std::string> strings;
+      std::set<std::vector<std::string>> groupLists;
+      std::unordered_map<std::string, int> groupIndices;
+   };
+
+   //constructed on first use, and never destroyed as timers may
+   //refer to it until the end of the program
+   InternPool& getPool(){
+      static InternPool *pool = new InternPool;
+      return *pool;
+   }
+}
+
+const std::string* TimerData::internString(const std::string &s){
+   InternPool &pool = getPool();
+   std::lock_guard<std::mutex> lock(pool.mutex);
+   return &*pool.strings.insert(s).first;
+}
+
+const std::vector<std::string>* TimerData::internGroups(const std::vector<std::string> &groups){
+   InternPool &pool = getPool();
+   std::lock_guard<std::mutex> lock(pool.mutex);
+   return &*pool.groupLists.insert(groups).first;
+}
+
+//registers the groups, the first 63 groups get their own bit
+uint64_t TimerData::getGroupMask(const std::vector<std::string> &groups){
+   InternPool &pool = getPool();
+   std::lock_guard<std::mutex> lock(pool.mutex);
+   uint64_t mask = 0;
+   for(const auto &group : groups) {
+      auto it = pool.groupIndices.find(group);
+      if(it == pool.groupIndices.end())
+         it = pool.groupIndices.emplace(group, pool.groupIndices.size()).first;
+      mask |= it->second < 63 ? 1ULL << it->second : overflowGroupBit;
+   }
+   return mask;
+}
 
+uint64_t TimerData::getGroupBit(const std::string &group){
+   std::vector<uint64_t> bits;
+   getGroupBits(std::vector<std::string>(1, group), bits);
+   return bits[0];
+}
 
+void TimerData::getGroupBits(const std::vector<std::string> &groups, std::vector<uint64_t> &bits){
+   InternPool &pool = getPool();
+   std::lock_guard<std::mutex> lock(pool.mutex);
+   bits.clear();
+   for(const auto &group : groups) {
+      auto it = pool.groupIndices.find(group);
+      if(it == pool.groupIndices.end())
+         bits.push_back(0);
+      else
+         bits.push_back(it->second < 63 ? 1ULL << it->second : overflowGroupBit);
+   }
+}
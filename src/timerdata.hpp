@@ -26,35 +26,76 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <omp.h>
 #include <limits>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 #include "common.hpp"
+#include "sharedcounters.hpp"
 
 
 
 class TimerData {
 public:
+   //accumulated values of all threads, copied for phases and deltas
+   struct Counters {
+      std::vector<int64_t> count;
+      std::vector<double> time;
+      std::vector<double> childTime;
+      std::vector<double> workUnits;
+
+      //add sign times other, for the threads of other
+      void add(const Counters &other, int sign){
+         count.resize(std::max(count.size(), other.count.size()), 0);
+         time.resize(count.size(), 0.0);
+         childTime.resize(count.size(), 0.0);
+         workUnits.resize(count.size(), 0.0);
+         for(uint i = 0; i < other.count.size(); i++){
+            count[i] += sign * other.count[i];
+            time[i] += sign * other.time[i];
+            childTime[i] += sign * other.childTime[i];
+            workUnits[i] += sign * other.workUnits[i];
+         }
+      }
+   };
+
    //threadcounts should be set before creating any objects
    TimerData(TimerData* parentTimer,
              const int &id, 
              const std::string &label, 
              const std::vector<std::string> &groups, 
-             const std::string &workUnitLabel) : id(id), label(label), groups(groups), workUnitLabel(workUnitLabel) {
+             const std::string &workUnitLabel) :
+      id(id), label(internString(label)), groups(internGroups(groups)),
+      groupMask(getGroupMask(groups)), workUnitLabel(internString(workUnitLabel)),
+      nSlots(numThreads), slots(new std::atomic<ThreadSlot*>[numThreads]) {
       if(parentTimer != NULL) {
          parentId = parentTimer->id;
          level = parentTimer->level + 1;
+         childIndex = parentTimer->childIds.size();
          //add timer to parentTimer
-         parentTimer->childIds.push_back(id);
+         parentTimer->addChild(id, this->label);
       }
       else { //this is the special case when one adds a root timer
          parentId = -1;
          level = 0;
+         childIndex = 0;
       }
-      count.assign(numThreads, 0);
-      time.assign(numThreads, 0.0);
-      startTime.assign(numThreads, -1);
-      workUnits.assign(numThreads, 0.0 );
-      active.assign(numThreads, false);
+      //no children yet, the tree hash is only the hash of this timer
+      ownHash = computeOwnHash();
+      treeHash = mixHash(ownHash);
+      for(int i = 0; i < nSlots; i++)
+         slots[i].store(NULL, std::memory_order_relaxed);
    }
 
+   //timers are stored in place and never copied
+   TimerData(const TimerData&) = delete;
+   TimerData& operator=(const TimerData&) = delete;
+
+   ~TimerData(){
+      for(int i = 0; i < nSlots; i++)
+         delete slots[i].load(std::memory_order_relaxed);
+   }
 
    static void setThreadCounts(){
 #ifdef _OPENMP
@@ -73,43 +114,95 @@ public:
 #endif
    }
 
+   //Clock of all timers, it does not advance while paused. pause and
+   //resume are called outside parallel regions, but other threads, e.g.
+   //the publisher of the shared counters, may read the clock meanwhile.
+   //resume stores the paused time before releasing the pause time.
+   static double getTime(){
+      const double pause = pauseTime.load(std::memory_order_acquire);
+      return pause >= 0.0 ? pause : wTime() - pausedTime.load(std::memory_order_relaxed);
+   }
+
+   static bool pause(){
+      if(pauseTime.load(std::memory_order_relaxed) >= 0.0)
+         return false;
+      pauseTime.store(getTime(), std::memory_order_release);
+      return true;
+   }
+
+   static bool resume(){
+      const double pause = pauseTime.load(std::memory_order_relaxed);
+      if(pause < 0.0)
+         return false;
+      pausedTime.store(wTime() - pause, std::memory_order_relaxed);
+      pauseTime.store(-1.0, std::memory_order_release);
+      return true;
+   }
+
+   //state of the clock, for readers in other processes
+   static void getClockState(double &clockPauseTime, double &clockPausedTime){
+      clockPauseTime = pauseTime.load(std::memory_order_acquire);
+      clockPausedTime = pausedTime.load(std::memory_order_relaxed);
+   }
+
    int start() {
-      startTime[thread] = wTime();
-      active[thread] = true;
+      ThreadSlot &slot = getSlot(thread);
+      slot.startTime = getTime();
+      slot.active = true;
+      if(shared != NULL)
+         shared->publishStart(id, thread, slot.startTime);
       return id;
    }
 
-   int stop(){
-      time[thread] += (wTime() - startTime[thread]);
-      count[thread]++;
-      active[thread]=false;
-      return parentId;
+   //returns the time of the interval that was stopped, the caller
+   //adds it to the child time of the parent
+   double stop(){
+      ThreadSlot &slot = getSlot(thread);
+      const double interval = getTime() - slot.startTime;
+      slot.time += interval;
+      slot.count++;
+      slot.active = false;
+      if(shared != NULL)
+         shared->publishStop(id, thread, slot.count, slot.time, slot.workUnits);
+      return interval;
    }
 
-   int stop(double addWorkUnits){
-      double stopTime = wTime();
-      workUnits[thread] += addWorkUnits;
-      time[thread] += (stopTime - startTime[thread]);
-      count[thread]++;
-      active[thread]=false;
-      return parentId;
+   double stop(double addWorkUnits){
+      ThreadSlot &slot = getSlot(thread);
+      double stopTime = getTime();
+      const double interval = stopTime - slot.startTime;
+      slot.workUnits += addWorkUnits;
+      slot.time += interval;
+      slot.count++;
+      slot.active = false;
+      if(shared != NULL)
+         shared->publishStop(id, thread, slot.count, slot.time, slot.workUnits);
+      return interval;
    }
 
-   int stop(double addWorkUnits, const std::string &addWorkUnitLabel){
-      double stopTime=wTime();
-      
-      if(count[thread]==0){ //set workUnitLabel the first time, the
-                            //rest of the time adding it has no
-                            //impact. This has a data race
-                            //vs. threads, so if many set it the end
-                            //value is undefined (the last one)
-         workUnitLabel = addWorkUnitLabel;
-      }
-      workUnits[thread] += addWorkUnits;
-      time[thread] += (stopTime - startTime[thread]);
-      count[thread]++;
-      active[thread]=false;
-      return parentId;
+   //time of a stopped child interval on this thread. Only kept if
+   //this thread has timed this timer, the child may have been started
+   //by a thread that never started its parent.
+   void addChildTime(double interval){
+      if(ThreadSlot *slot = findSlot(thread))
+         slot->childTime += interval;
+   }
+
+   //workUnitLabel is set the first time a thread stops the timer, the
+   //rest of the time adding it has no impact. If many threads set
+   //it the end value is undefined (the last one)
+   bool isNewWorkUnitLabel(const std::string &addWorkUnitLabel) const {
+      const ThreadSlot *slot = findSlot(thread);
+      return (slot == NULL || slot->count == 0) && addWorkUnitLabel != getWorkUnitLabel();
+   }
+
+   //Sets the workunit label and updates the hash of this timer. The
+   //hashes of the ancestors have to be updated by the caller.
+   void setWorkUnitLabel(const std::string &newWorkUnitLabel){
+      uint64_t oldOwnHash = mixHash(ownHash);
+      workUnitLabel.store(internString(newWorkUnitLabel), std::memory_order_relaxed);
+      ownHash = computeOwnHash();
+      treeHash += mixHash(ownHash) - oldOwnHash;
    }
 
 
@@ -119,10 +212,10 @@ public:
       double sum = 0;
       nThreads = 0;
       
-      for(uint i = 0; i < time.size(); i++){
-         if(count[i] > 0 || active[i]) {
+      for(int i = 0; i < nSlots; i++){
+         if(isTimed(i)) {
             nThreads++;
-            double timerTime = time[i] + (active[i] ? wTime()- startTime[i] : 0.0);
+            double timerTime = getThreadTime(*findSlot(i));
             max = std::max(timerTime, max);
             min = std::min(timerTime, min);
             sum += timerTime;
@@ -136,6 +229,97 @@ public:
    }
    
 
+   //Exclusive (self) time of each thread that has the timer, -1 for
+   //the others. The running intervals of the children are not yet in
+   //childTime, they are given by the caller in activeChildTime.
+   void getExclusiveTimes(const std::vector<double> &activeChildTime, std::vector<double> &exclusiveTime) const {
+      exclusiveTime.assign(nSlots, -1.0);
+      for(int i = 0; i < nSlots; i++){
+         if(isTimed(i)) {
+            const ThreadSlot &slot = *findSlot(i);
+            exclusiveTime[i] = std::max(getThreadTime(slot) - slot.childTime - activeChildTime[i], 0.0);
+         }
+      }
+   }
+
+   //Add the running interval of each thread to the time, and restart
+   //it at now. The intervals are returned so that the caller can add
+   //them to the child time of the parent.
+   void closeActiveIntervals(double now, std::vector<double> &intervals){
+      intervals.assign(nSlots, 0.0);
+      for(int i = 0; i < nSlots; i++){
+         ThreadSlot *slot = findSlot(i);
+         if(slot != NULL && slot->active) {
+            intervals[i] = now - slot->startTime;
+            slot->time += intervals[i];
+            slot->startTime = now;
+         }
+      }
+   }
+
+   //called outside parallel regions
+   void addChildTimes(const std::vector<double> &intervals){
+      for(int i = 0; i < nSlots; i++){
+         if(intervals[i] != 0.0)
+            getSlot(i).childTime += intervals[i];
+      }
+   }
+
+   void getCounters(Counters &counters) const {
+      counters.count.assign(nSlots, 0);
+      counters.time.assign(nSlots, 0.0);
+      counters.childTime.assign(nSlots, 0.0);
+      counters.workUnits.assign(nSlots, 0.0);
+      for(int i = 0; i < nSlots; i++){
+         if(const ThreadSlot *slot = findSlot(i)) {
+            counters.count[i] = slot->count;
+            counters.time[i] = slot->time;
+            counters.childTime[i] = slot->childTime;
+            counters.workUnits[i] = slot->workUnits;
+         }
+      }
+   }
+
+   //replace the accumulated values, e.g. with those of a phase. Called
+   //outside parallel regions.
+   void setCounters(const Counters &counters){
+      for(int i = 0; i < nSlots; i++){
+         const bool hasValues = (uint)i < counters.count.size() &&
+            (counters.count[i] != 0 || counters.time[i] != 0.0 ||
+             counters.childTime[i] != 0.0 || counters.workUnits[i] != 0.0);
+         ThreadSlot *slot = hasValues ? &getSlot(i) : findSlot(i);
+         if(slot == NULL)
+            continue;
+         slot->count = hasValues ? counters.count[i] : 0;
+         slot->time = hasValues ? counters.time[i] : 0.0;
+         slot->childTime = hasValues ? counters.childTime[i] : 0.0;
+         slot->workUnits = hasValues ? counters.workUnits[i] : 0.0;
+      }
+   }
+
+   //A thread has timed the timer if it has stopped or is running it.
+   //Phase and delta windows can also have time from an interval that
+   //was closed while running, without a count.
+   bool isTimed(uint thread) const {
+      const ThreadSlot *slot = findSlot(thread);
+      return slot != NULL && (slot->count > 0 || slot->active || slot->time > 0.0);
+   }
+
+   //time since threadId started the timer, -1 if it is not running
+   double getElapsedTime(uint threadId) const {
+      const ThreadSlot *slot = findSlot(threadId);
+      return slot != NULL && slot->active ? getTime() - slot->startTime : -1.0;
+   }
+
+   //time of the running interval of each thread, 0 if not active
+   void addActiveTime(std::vector<double> &activeTime) const {
+      for(int i = 0; i < nSlots; i++){
+         const ThreadSlot *slot = findSlot(i);
+         if(slot != NULL && slot->active)
+            activeTime[i] += getTime() - slot->startTime;
+      }
+   }
+
    double getTimeImbalance() const {
       double max, min, ave;
       int nThreads;
@@ -159,10 +343,10 @@ public:
    int64_t getAverageCount() const {
       int64_t sumCount = 0.0;
       int timedThreads = 0;
-      for(uint i = 0; i < time.size(); i++){
-         if(count[i] > 0 || active[i]) {
+      for(int i = 0; i < nSlots; i++){
+         if(isTimed(i)) {
             timedThreads++;
-            sumCount += count[i];
+            sumCount += findSlot(i)->count;
          }
       }
       //TODO, should return double
@@ -175,10 +359,10 @@ public:
    double getAverageWorkUnits() const{
       double sumWorkUnits = 0.0;
       int timedThreads = 0;
-      for(uint i = 0; i < time.size(); i++){
-         if(count[i] > 0 || active[i]) {
+      for(int i = 0; i < nSlots; i++){
+         if(isTimed(i)) {
             timedThreads++;
-            sumWorkUnits += workUnits[i];
+            sumWorkUnits += findSlot(i)->workUnits;
          }
       }
       if (timedThreads > 0)
@@ -190,8 +374,8 @@ public:
 
    double getThreads() const {
       int timedThreads = 0;
-      for(uint i = 0; i < time.size(); i++){
-         if(count[i] > 0 || active[i]) {
+      for(int i = 0; i < nSlots; i++){
+         if(isTimed(i)) {
             timedThreads++;
          }
       }
@@ -200,64 +384,215 @@ public:
 
    
 
-//String with label, groups and workunitlabel.
-   std::string getStringForHash() const{
-      std::string hashString = label;
-      hashString += workUnitLabel;
-      for (const auto& g: groups) {
-         hashString += g;
+   //id of the child with label, -1 if there is none
+   int getChildId(const std::string &childLabel) const {
+      if(childLookup) {
+         auto it = childLookup->find(childLabel);
+         return it != childLookup->end() ? it->second : -1;
+      }
+      for(uint i = 0; i < childIds.size(); i++){
+         if(*childLabels[i] == childLabel)
+            return childIds[i];
       }
-      return hashString;
+      return -1;
+   }
+
+   //Hash of the subtree starting at this timer (Merkle hash). It is
+   //the sum of the mixed hash of this timer and the contributions of
+   //all children, so that a changed child only requires the ancestors
+   //to update their sum
+   uint64_t getHash() const { return treeHash;}
+
+   //What this timer contributes to the hash of its parent, depends on
+   //the position among the children.
+   uint64_t getHashContribution() const {
+      return mixHash(treeHash + 0x9e3779b97f4a7c15ULL * (childIndex + 1));
+   }
+
+   //Replace the contribution of a child, oldContribution is 0 for a new child
+   void updateChildHash(uint64_t oldContribution, uint64_t newContribution){
+      treeHash += newContribution - oldContribution;
    }
    
    
    void resetTime(double resetWallTime){
-      count.assign(count.size(), 0);
-      time.assign(time.size(), 0.0);
-      workUnits.assign(workUnits.size(), 0.0 );
-      
-      for(uint thread = 0; thread < active.size(); thread++) {
-         if(active[thread]){
-            startTime[thread] = resetWallTime;
+      for(int i = 0; i < nSlots; i++){
+         if(ThreadSlot *slot = findSlot(i)) {
+            slot->count = 0;
+            slot->time = 0.0;
+            slot->childTime = 0.0;
+            slot->workUnits = 0.0;
+            if(slot->active)
+               slot->startTime = resetWallTime;
          }
       }
+      publish();
    }
    
    void shiftActiveStartTime(double shiftTime){
-      for(uint thread = 0; thread < active.size(); thread++) {
-         if(active[thread]){
-            startTime[thread] += shiftTime;
-         }
+      for(int i = 0; i < nSlots; i++){
+         ThreadSlot *slot = findSlot(i);
+         if(slot != NULL && slot->active)
+            slot->startTime += shiftTime;
       }
+      publish();
+   }
+
+   //Publish the counters into shared memory, NULL to stop. Called
+   //outside parallel regions, the threads update their own values
+   //afterwards.
+   void setSharedCounters(SharedCounters *counters){
+      shared = counters;
+      publish();
+   }
+
+   //True if the timer is in group. groupBit is getGroupBit(group).
+   bool isInGroup(const std::string &group, uint64_t groupBit) const {
+      if(groupBit != overflowGroupBit)
+         return (groupMask & groupBit) != 0;
+      return (groupMask & overflowGroupBit) != 0 &&
+         std::find(groups->begin(), groups->end(), group) != groups->end();
    }
 
-   const std::string& getLabel() const { return label;}
+   //Bit of a group in the group masks of the timers, 0 if no timer is
+   //in it. Groups beyond the first 63 share the overflow bit.
+   static uint64_t getGroupBit(const std::string &group);
+   //bits of many groups with one lock, e.g. once per report
+   static void getGroupBits(const std::vector<std::string> &groups, std::vector<uint64_t> &bits);
+
+   const std::string& getLabel() const { return *label;}
    const int& getId() const { return id;}
    const int& getLevel() const { return level;}
    const int& getParentId() const { return parentId;}
    const std::vector<int>& getChildIds() const { return childIds;}
-   const std::string& getWorkUnitLabel() const { return workUnitLabel;}
-   const std::vector<std::string>& getGroups() const { return groups;}
+   const std::string& getWorkUnitLabel() const { return *workUnitLabel.load(std::memory_order_relaxed);}
+   const std::vector<std::string>& getGroups() const { return *groups;}
    
 private:
+   //Children are searched linearly, with a hash table when there are
+   //many. The keys are views of the interned labels.
+   void addChild(int childId, const std::string *childLabel){
+      childIds.push_back(childId);
+      childLabels.push_back(childLabel);
+      if(childLookup) {
+         childLookup->emplace(*childLabel, childId);
+      }
+      else if(childIds.size() > maxLinearChildren) {
+         childLookup.reset(new std::unordered_map<std::string_view, int>);
+         for(uint i = 0; i < childIds.size(); i++)
+            childLookup->emplace(*childLabels[i], childIds[i]);
+      }
+   }
+   static const uint maxLinearChildren = 16;
+
+   //values of one thread, allocated when the thread first uses the timer
+   struct ThreadSlot {
+      int64_t count = 0;         //how many times have this been accumulated
+      double time = 0.0;         //total time accumulated
+      double childTime = 0.0;    //time of stopped child intervals
+      double startTime = -1.0;   //starting time of previous start() call
+      double workUnits = 0.0;    //how many units of work have we done
+      bool active = false;
+   };
+
+   //slot of a thread, NULL if it has not used the timer
+   ThreadSlot* findSlot(int threadId) const {
+      return slots[threadId].load(std::memory_order_acquire);
+   }
+
+   //Slot of a thread, allocated if needed. Only the thread itself
+   //allocates its slot, except outside parallel regions.
+   ThreadSlot& getSlot(int threadId){
+      ThreadSlot *slot = slots[threadId].load(std::memory_order_relaxed);
+      if(slot == NULL) {
+         slot = new ThreadSlot();
+         slots[threadId].store(slot, std::memory_order_release);
+      }
+      return *slot;
+   }
+
+   static double getThreadTime(const ThreadSlot &slot){
+      return slot.time + (slot.active ? getTime() - slot.startTime : 0.0);
+   }
+
+   //all values of all threads, when they are changed outside start and stop
+   void publish() const {
+      if(shared == NULL)
+         return;
+      for(int i = 0; i < nSlots; i++){
+         const ThreadSlot *slot = findSlot(i);
+         if(slot == NULL)
+            continue;
+         SharedCounters::Values values;
+         values.count = slot->count;
+         values.active = slot->active;
+         values.time = slot->time;
+         values.workUnits = slot->workUnits;
+         values.startTime = slot->startTime;
+         shared->publish(id, i, values);
+      }
+   }
+
+   //Labels and group lists are interned, timers share one copy of
+   //equal strings. The copies are never freed or moved.
+   static const std::string* internString(const std::string &s);
+   static const std::vector<std::string>* internGroups(const std::vector<std::string> &groups);
+   static uint64_t getGroupMask(const std::vector<std::string> &groups);
+   static const uint64_t overflowGroupBit = 1ULL << 63;
+
+   //splitmix64 finalizer
+   static uint64_t mixHash(uint64_t x){
+      x ^= x >> 30;
+      x *= 0xbf58476d1ce4e5b9ULL;
+      x ^= x >> 27;
+      x *= 0x94d049bb133111ebULL;
+      x ^= x >> 31;
+      return x;
+   }
+
+   //64 bit FNV-1a, continued from hash
+   static uint64_t hashString(const std::string &s, uint64_t hash = 0xcbf29ce484222325ULL){
+      for(const char c: s) {
+         hash ^= (unsigned char)c;
+         hash *= 0x100000001b3ULL;
+      }
+      //separator, so that "ab"+"c" differs from "a"+"bc"
+      return mixHash(hash ^ s.size());
+   }
+
+   //hash of label, workunitlabel and groups
+   uint64_t computeOwnHash() const {
+      uint64_t hash = hashString(getLabel());
+      hash = hashString(getWorkUnitLabel(), hash);
+      for (const auto& g: getGroups()) {
+         hash = hashString(g, hash);
+      }
+      return hash;
+   }
+
    const int id; // unique id identifying this timer (index for timers)
-   const std::string label;          //print label 
+   const std::string *label;          //print label 
    static int numThreads;
    static int thread;
 #pragma omp threadprivate(thread)
+   static std::atomic<double> pauseTime;  //time of the clock when paused, -1 when running
+   static std::atomic<double> pausedTime; //total time paused
    
    int level;  //what hierarchy level
    int parentId;  //key of parent (id)
+   int childIndex; //position among the children of parent
+   uint64_t ownHash;  //hash of label, workunitlabel and groups
+   uint64_t treeHash; //hash of the subtree starting from this timer
    std::vector<int> childIds; //children of this timer
-   const std::vector<std::string> groups; // What user-defined groups does this timer belong to, e.g., "MPI", "IO", etc..
-   std::string workUnitLabel;   //unit for the counter workUnitCount
-                                //(can be changed in stop)
-
-   std::vector<int64_t> count; //how many times have this been accumulated per thread
-   std::vector<double> time; // total time accumulated per thread
-   std::vector<double> startTime; //Starting time of previous start() call per thread
-   std::vector<double> workUnits;        // how many units of work have we done. If -1 it is not counted, or printed
-   std::vector<bool> active;
+   std::vector<const std::string*> childLabels; //labels of the children
+   std::unique_ptr<std::unordered_map<std::string_view, int>> childLookup; //child ids by label, if many children
+   const std::vector<std::string> *groups; // What user-defined groups does this timer belong to, e.g., "MPI", "IO", etc..
+   const uint64_t groupMask; //bits of the groups, see getGroupBit
+   std::atomic<const std::string*> workUnitLabel;   //unit for the counter workUnitCount
+                                                    //(can be changed in stop)
+   const int nSlots; //number of threads
+   std::unique_ptr<std::atomic<ThreadSlot*>[]> slots; //values per thread, NULL until used
+   SharedCounters *shared = NULL; //live counters, NULL if not published
 };
 
 
@@ -0,0 +1,202 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <sstream>
+#include <stdint.h>
+#include "timerdictionary.hpp"
+#include "timertree.hpp"
+
+namespace {
+   //Serialized format: all integers are 32 bit, strings are stored as
+   //length followed by the characters (no terminating zero).
+   void putInt(std::vector<char> &buffer, int32_t value){
+      const char *bytes = reinterpret_cast<const char*>(&value);
+      buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+   }
+
+   void putString(std::vector<char> &buffer, const std::string &value){
+      putInt(buffer, value.size());
+      buffer.insert(buffer.end(), value.begin(), value.end());
+   }
+
+   bool getInt(const char *buffer, size_t bufferSize, size_t &pos, int32_t &value){
+      if(pos + sizeof(value) > bufferSize)
+         return false;
+      memcpy(&value, buffer + pos, sizeof(value));
+      pos += sizeof(value);
+      return true;
+   }
+
+   bool getString(const char *buffer, size_t bufferSize, size_t &pos, std::string &value){
+      int32_t length;
+      if(!getInt(buffer, bufferSize, pos, length) || length < 0 || pos + length > bufferSize)
+         return false;
+      value.assign(buffer + pos, length);
+      pos += length;
+      return true;
+   }
+}
+
+TimerDictionary::TimerDictionary(){}
+
+void TimerDictionary::clear(){
+   entries.clear();
+   indices.clear();
+}
+
+int TimerDictionary::find(int parentIndex, const std::string &label) const{
+   auto it = indices.find(std::make_pair(parentIndex, label));
+   if(it == indices.end())
+      return -1;
+   return it->second;
+}
+
+int TimerDictionary::findFullLabel(const std::string &fullLabel) const{
+   std::stringstream labels(fullLabel);
+   std::string label;
+   int index = entries.size() > 0 ? 0 : -1;
+   while(index >= 0 && std::getline(labels, label, '/')) {
+      if(label.size() > 0)
+         index = find(index, label);
+   }
+   return index;
+}
+
+int TimerDictionary::add(int parentIndex, const std::string &label,
+                         const std::vector<std::string> &groups, const std::string &workUnitLabel){
+   int index = find(parentIndex, label);
+   if(index >= 0)
+      return index;
+
+   Entry entry;
+   entry.label = label;
+   entry.groups = groups;
+   entry.workUnitLabel = workUnitLabel;
+   entry.parentIndex = parentIndex;
+   entry.level = parentIndex >= 0 ? entries[parentIndex].level + 1 : 0;
+   index = entries.size();
+   entries.push_back(entry);
+   if(parentIndex >= 0)
+      entries[parentIndex].childIndices.push_back(index);
+   indices[std::make_pair(parentIndex, label)] = index;
+   return index;
+}
+
+//ids in a timertree are given in creation order, so parents are
+//always added before their children
+void TimerDictionary::add(const TimerTree &tree, std::vector<int> &treeIndices){
+   treeIndices.resize(tree.size());
+   for(std::size_t id = 0; id < tree.size(); id++){
+      int parentId = tree[id].getParentId();
+      treeIndices[id] = add(parentId >= 0 ? treeIndices[parentId] : -1,
+                            tree[id].getLabel(), tree[id].getGroups(), tree[id].getWorkUnitLabel());
+   }
+}
+
+int TimerDictionary::merge(const TimerDictionary &other){
+   int nConflicts = 0;
+   std::vector<int> otherIndices(other.size());
+   for(std::size_t i = 0; i < other.size(); i++){
+      const int parentIndex = other[i].parentIndex;
+      const std::size_t oldSize = entries.size();
+      otherIndices[i] = add(parentIndex >= 0 ? otherIndices[parentIndex] : -1,
+                            other[i].label, other[i].groups, other[i].workUnitLabel);
+      if(std::size_t(otherIndices[i]) >= oldSize)
+         continue;
+      //timer existed already, workunits may have been recorded on only some processes
+      Entry &entry = entries[otherIndices[i]];
+      if(entry.workUnitLabel.empty())
+         entry.workUnitLabel = other[i].workUnitLabel;
+      if(entry.groups != other[i].groups ||
+         (!other[i].workUnitLabel.empty() && entry.workUnitLabel != other[i].workUnitLabel))
+         nConflicts++;
+   }
+   return nConflicts;
+}
+
+void TimerDictionary::serialize(std::vector<char> &buffer) const{
+   buffer.clear();
+   putInt(buffer, entries.size());
+   for(const auto &entry: entries){
+      putInt(buffer, entry.parentIndex);
+      putString(buffer, entry.label);
+      putString(buffer, entry.workUnitLabel);
+      putInt(buffer, entry.groups.size());
+      for(const auto &group: entry.groups)
+         putString(buffer, group);
+   }
+}
+
+bool TimerDictionary::deserialize(const char *buffer, size_t bufferSize){
+   size_t pos = 0;
+   int32_t nEntries;
+   clear();
+   if(!getInt(buffer, bufferSize, pos, nEntries))
+      return false;
+
+   for(int i = 0; i < nEntries; i++){
+      int32_t parentIndex, nGroups;
+      std::string label, workUnitLabel;
+      std::vector<std::string> groups;
+      if(!getInt(buffer, bufferSize, pos, parentIndex) ||
+         !getString(buffer, bufferSize, pos, label) ||
+         !getString(buffer, bufferSize, pos, workUnitLabel) ||
+         !getInt(buffer, bufferSize, pos, nGroups) || nGroups < 0 ||
+         (size_t)nGroups > (bufferSize - pos) / sizeof(int32_t)) //each group has at least its length
+         return false;
+      groups.resize(nGroups);
+      for(auto &group: groups){
+         if(!getString(buffer, bufferSize, pos, group))
+            return false;
+      }
+      //parent has to exist already, and paths have to be unique
+      if(parentIndex >= i || (parentIndex < 0 && i > 0) || find(parentIndex, label) >= 0)
+         return false;
+      add(parentIndex, label, groups, workUnitLabel);
+   }
+   return true;
+}
+
+//get full hierarchical name for a timer, same format as in TimerTree
+std::string TimerDictionary::getFullLabel(int index, bool reverse) const{
+   std::vector<std::string> labels;
+   while(index > 0){
+      labels.push_back(entries[index].label);
+      index = entries[index].parentIndex;
+   }
+
+   std::string fullLabel;
+   if(reverse){
+      for (auto it = labels.begin(); it != labels.end(); ++it){
+         fullLabel += *it;
+         fullLabel += "\\";
+      }
+   }
+   else{
+      for (auto rit = labels.rbegin(); rit != labels.rend(); ++rit){
+         fullLabel += "/";
+         fullLabel += *rit;
+      }
+   }
+   return fullLabel;
+}
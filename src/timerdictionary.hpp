@@ -0,0 +1,126 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef TIMERDICTIONARY_H
+#define TIMERDICTIONARY_H
+#include <vector>
+#include <string>
+#include <map>
+
+class TimerTree;
+
+/*
+  Description of a tree of timers (labels, groups, workunit labels and
+  hierarchy) without any timing data. Timers are identified by their
+  full label path, i.e., the labels of all ancestors and their own
+  label. The same path always maps to the same index, which makes it
+  possible to merge the trees of processes that executed different
+  codepaths. Parents are always stored before their children.
+*/
+class TimerDictionary {
+public:
+   struct Entry {
+      std::string label;
+      std::vector<std::string> groups;
+      std::string workUnitLabel;
+      int parentIndex;
+      int level;
+      std::vector<int> childIndices;
+   };
+
+   TimerDictionary();
+
+   /**
+    * Remove all entries, also the root entry
+    */
+   void clear();
+
+   /**
+    * Add a timer under parentIndex. If a timer with the same label
+    * already exists there, then its index is returned and nothing is
+    * changed. Use parentIndex -1 for the root timer.
+    *
+    * @return
+    *   The index of the timer
+    */
+   int add(int parentIndex, const std::string &label,
+           const std::vector<std::string> &groups, const std::string &workUnitLabel);
+
+   /**
+    * Add all timers of a timertree.
+    *
+    * @param indices
+    *   Set to the dictionary index of each timer id in the tree
+    */
+   void add(const TimerTree &tree, std::vector<int> &indices);
+
+   /**
+    * Add all timers of another dictionary that do not yet exist in
+    * this one. Existing indices are not changed. If a timer exists in
+    * both with different groups or workunit labels, the ones in this
+    * dictionary are kept, an empty workunit label is replaced.
+    *
+    * @return
+    *   The number of timers whose groups or workunit labels differ
+    */
+   int merge(const TimerDictionary &other);
+
+   /**
+    * @return
+    *   The index of the child of parentIndex with label, -1 if it does not exist
+    */
+   int find(int parentIndex, const std::string &label) const;
+
+   /**
+    * @return
+    *   The index of the timer with a full label as returned by
+    *   getFullLabel(), e.g., /solve/halo. -1 if it does not exist.
+    */
+   int findFullLabel(const std::string &fullLabel) const;
+
+   /**
+    * Serialize into a byte buffer, the buffer is overwritten
+    */
+   void serialize(std::vector<char> &buffer) const;
+
+   /**
+    * Replace the contents with a dictionary serialized with serialize()
+    *
+    * @return
+    *   Returns false if the buffer was malformed
+    */
+   bool deserialize(const char *buffer, size_t bufferSize);
+
+   std::string getFullLabel(int index, bool reverse=false) const;
+
+   const Entry& operator[](std::size_t index) const{
+      return entries[index];
+   }
+
+   std::size_t size() const{
+      return entries.size();
+   }
+
+private:
+   std::vector<Entry> entries;
+   std::map<std::pair<int, std::string>, int> indices; //(parentIndex, label) -> index
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include "timerdiff.hpp"
+#include "prettyprinttable.hpp"
+
+TimerDiff::TimerDiff(double absoluteThreshold, double relativeThreshold, bool requireBoth) :
+   absoluteThreshold(absoluteThreshold), relativeThreshold(relativeThreshold), requireBoth(requireBoth) {}
+
+bool TimerDiff::isRegression(double baseTime, double time) const{
+   const double growth = time - baseTime;
+   const bool absolute = growth > absoluteThreshold;
+   //relative growth from zero is not defined, only the absolute threshold applies
+   if(baseTime <= 0.0)
+      return absolute;
+   const bool relative = growth / baseTime > relativeThreshold;
+   return requireBoth ? absolute && relative : absolute || relative;
+}
+
+void TimerDiff::compare(const TimerReport &base, const TimerReport &other){
+   std::map<std::string, int> baseEntries; //full label -> index in entries
+   entries.clear();
+
+   //root (i=0) and "other" rows (id -1) are not compared
+   for(unsigned int i = 1; i < base.stats.id.size(); i++){
+      const int id = base.stats.id[i];
+      if(id == -1 || base.stats.ranksSum[i] == 0)
+         continue;
+      Entry entry;
+      entry.fullLabel = base.dictionary.getFullLabel(id);
+      entry.level = base.stats.level[i];
+      entry.inBase = true;
+      entry.inOther = false;
+      entry.baseAverage = base.getAverage(i);
+      entry.baseMax = base.stats.timeMax[i].val;
+      entry.baseImbalance = base.getImbalance(i);
+      entry.average = entry.max = entry.imbalance = 0.0;
+      entry.totalFraction = base.stats.timeTotalFraction[i];
+      entry.regressed = false;
+      baseEntries[entry.fullLabel] = entries.size();
+      entries.push_back(entry);
+   }
+
+   for(unsigned int i = 1; i < other.stats.id.size(); i++){
+      const int id = other.stats.id[i];
+      if(id == -1 || other.stats.ranksSum[i] == 0)
+         continue;
+      const std::string fullLabel = other.dictionary.getFullLabel(id);
+      auto baseEntry = baseEntries.find(fullLabel);
+      if(baseEntry == baseEntries.end()) {
+         Entry entry;
+         entry.fullLabel = fullLabel;
+         entry.level = other.stats.level[i];
+         entry.inBase = false;
+         entry.baseAverage = entry.baseMax = entry.baseImbalance = 0.0;
+         entry.totalFraction = 0.0;
+         entries.push_back(entry);
+      }
+      Entry &entry = baseEntry == baseEntries.end() ? entries.back() : entries[baseEntry->second];
+      entry.inOther = true;
+      entry.average = other.getAverage(i);
+      entry.max = other.stats.timeMax[i].val;
+      entry.imbalance = other.getImbalance(i);
+      entry.totalFraction = std::max(entry.totalFraction, other.stats.timeTotalFraction[i]);
+      //new and removed timers are reported, but are not regressions
+      entry.regressed = entry.inBase &&
+         (isRegression(entry.baseAverage, entry.average) || isRegression(entry.baseMax, entry.max));
+   }
+}
+
+bool TimerDiff::hasRegressions() const{
+   for(auto &entry: entries){
+      if(entry.regressed)
+         return true;
+   }
+   return false;
+}
+
+void TimerDiff::print(std::ostream &output, double minFraction) const{
+   PrettyPrintTable table;
+   std::stringstream buffer;
+   buffer << "Timers with a growth of more than " << absoluteThreshold << " s "
+          << (requireBoth ? "and " : "or ")
+          << 100.0 * relativeThreshold << "% in average or max time are regressions.";
+   table.addTitle(buffer.str());
+
+   //relative change in %, empty if not defined
+   auto addChange = [&](double baseTime, double time) {
+      if(baseTime > 0.0)
+         table.addElement(100.0 * (time - baseTime) / baseTime);
+      else
+         table.addElement("");
+   };
+
+   table.addHorizontalLine();
+   //row1
+   table.addElement("",1);
+   table.addElement("Avg time (s)",3);
+   table.addElement("Max time (s)",3);
+   table.addElement("Imb %",2);
+   table.addElement("",1);
+   table.addHorizontalLine();
+   //row2
+   table.addElement("Timer",1);
+   table.addElement("Base",1);
+   table.addElement("New",1);
+   table.addElement("Change %",1);
+   table.addElement("Base",1);
+   table.addElement("New",1);
+   table.addElement("Change %",1);
+   table.addElement("Base",1);
+   table.addElement("New",1);
+   table.addElement("Status",1);
+   table.addHorizontalLine();
+
+   for(auto &entry: entries){
+      if(entry.totalFraction < minFraction && !entry.regressed)
+         continue;
+      table.addElement(entry.fullLabel);
+      if(entry.inBase && entry.inOther) {
+         table.addElement(entry.baseAverage);
+         table.addElement(entry.average);
+         addChange(entry.baseAverage, entry.average);
+         table.addElement(entry.baseMax);
+         table.addElement(entry.max);
+         addChange(entry.baseMax, entry.max);
+         table.addElement(100.0 * entry.baseImbalance);
+         table.addElement(100.0 * entry.imbalance);
+         table.addElement(entry.regressed ? "REGRESSED" : "");
+      }
+      else {
+         //only exists in one of the reports
+         const bool inBase = entry.inBase;
+         table.addElement(inBase ? entry.baseAverage : 0.0);
+         table.addElement(inBase ? 0.0 : entry.average);
+         table.addElement("");
+         table.addElement(inBase ? entry.baseMax : 0.0);
+         table.addElement(inBase ? 0.0 : entry.max);
+         table.addElement("");
+         table.addElement(inBase ? 100.0 * entry.baseImbalance : 0.0);
+         table.addElement(inBase ? 0.0 : 100.0 * entry.imbalance);
+         table.addElement(inBase ? "removed" : "new");
+      }
+      table.addRow();
+   }
+   table.addHorizontalLine();
+   table.print(output);
+}
@@ -0,0 +1,87 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef TIMERDIFF_H
+#define TIMERDIFF_H
+#include <vector>
+#include <string>
+#include <ostream>
+#include "timerreport.hpp"
+
+/*
+  Comparison of two reports, e.g. from two runs of the same code. Timers
+  are matched by their full label path. A timer has regressed if its
+  average or maximum time grew by more than both the absolute and the
+  relative threshold, or by more than either of them if requireBoth is
+  false.
+*/
+class TimerDiff {
+public:
+   struct Entry {
+      std::string fullLabel;
+      int level;
+      bool inBase;       //timer exists in the base report
+      bool inOther;      //timer exists in the other report
+      double baseAverage;
+      double average;
+      double baseMax;
+      double max;
+      double baseImbalance;
+      double imbalance;
+      double totalFraction; //largest fraction of total time in the two reports
+      bool regressed;
+   };
+
+   /**
+    * @param absoluteThreshold
+    *   Smallest growth of time in seconds that is a regression
+    * @param relativeThreshold
+    *   Smallest relative growth of time that is a regression
+    * @param requireBoth
+    *   If true, the growth has to exceed both thresholds, otherwise
+    *   exceeding one of them is enough
+    */
+   TimerDiff(double absoluteThreshold=0.001, double relativeThreshold=0.1, bool requireBoth=true);
+
+   /**
+    * Compare other to base. Timers are in the order of base, followed
+    * by the timers that only exist in other.
+    */
+   void compare(const TimerReport &base, const TimerReport &other);
+
+   bool hasRegressions() const;
+
+   const std::vector<Entry>& getEntries() const { return entries;}
+
+   /**
+    * Print a table of timers with at least minFraction of total time
+    */
+   void print(std::ostream &output, double minFraction=0.0) const;
+
+private:
+   bool isRegression(double baseTime, double time) const;
+
+   double absoluteThreshold;
+   double relativeThreshold;
+   bool requireBoth;
+   std::vector<Entry> entries;
+};
+
+#endif
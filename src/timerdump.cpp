@@ -0,0 +1,103 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include "timerdump.hpp"
+
+namespace {
+   const char magic[8] = {'P','H','I','P','D','U','M','P'};
+}
+
+void TimerDump::setHeader(Header &header, int nRanks, int64_t dictionaryBytes){
+   memcpy(header.magic, magic, sizeof(magic));
+   header.version = version;
+   header.nRanks = nRanks;
+   header.dictionaryBytes = dictionaryBytes;
+}
+
+bool TimerDump::read(const std::string &fileName){
+   Header header;
+   std::vector<char> buffer;
+   std::vector<RankEntry> rankEntries;
+   std::ifstream input(fileName, std::ifstream::binary);
+   dictionary.clear();
+   records.clear();
+   nodes.clear();
+
+   if(!input.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, magic, sizeof(magic)) != 0) {
+      std::cerr << "PHIPROF-ERROR: " << fileName << " is not a phiprof dump" << std::endl;
+      return false;
+   }
+   if(header.version != version || header.nRanks < 0 || header.dictionaryBytes < 0) {
+      std::cerr << "PHIPROF-ERROR: Unsupported dump version " << header.version << " in " << fileName << std::endl;
+      return false;
+   }
+
+   //sizes are checked against the file before anything is allocated
+   input.seekg(0, std::ifstream::end);
+   const int64_t fileSize = input.tellg();
+   input.seekg(sizeof(header));
+   const int64_t headerBytes = sizeof(header) + header.dictionaryBytes;
+   if(header.dictionaryBytes > fileSize - (int64_t)sizeof(header) ||
+      header.nRanks > (fileSize - headerBytes) / (int64_t)sizeof(RankEntry)) {
+      std::cerr << "PHIPROF-ERROR: Malformed header in " << fileName << std::endl;
+      return false;
+   }
+
+   buffer.resize(header.dictionaryBytes);
+   rankEntries.resize(header.nRanks);
+   if(!input.read(buffer.data(), buffer.size()) ||
+      !dictionary.deserialize(buffer.data(), buffer.size()) ||
+      !input.read(reinterpret_cast<char*>(rankEntries.data()), rankEntries.size() * sizeof(RankEntry))) {
+      std::cerr << "PHIPROF-ERROR: Malformed header in " << fileName << std::endl;
+      return false;
+   }
+
+   for(int rank = 0; rank < header.nRanks; rank++) {
+      const RankEntry &entry = rankEntries[rank];
+      if(entry.nRecords < 0 || entry.offset < headerBytes || entry.offset > fileSize ||
+         entry.nRecords > (fileSize - entry.offset) / (int64_t)sizeof(Record)) {
+         std::cerr << "PHIPROF-ERROR: Invalid records of rank " << rank << " in " << fileName << std::endl;
+         return false;
+      }
+   }
+
+   records.resize(header.nRanks);
+   nodes.resize(header.nRanks);
+   for(int rank = 0; rank < header.nRanks; rank++) {
+      nodes[rank] = rankEntries[rank].node;
+      records[rank].resize(rankEntries[rank].nRecords);
+      input.seekg(rankEntries[rank].offset);
+      if(!input.read(reinterpret_cast<char*>(records[rank].data()), records[rank].size() * sizeof(Record))) {
+         std::cerr << "PHIPROF-ERROR: Could not read records of rank " << rank << " from " << fileName << std::endl;
+         return false;
+      }
+      for(const auto &record: records[rank]) {
+         if(record.index < 0 || record.index >= (int)dictionary.size()) {
+            std::cerr << "PHIPROF-ERROR: Invalid timer index in records of rank " << rank << " in " << fileName << std::endl;
+            return false;
+         }
+      }
+   }
+   return true;
+}
@@ -0,0 +1,95 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef TIMERDUMP_H
+#define TIMERDUMP_H
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "timerdictionary.hpp"
+
+/*
+  Raw per-rank timer data written by phiprof::dump(). The file is
+  written with native byte order and has the layout
+
+    Header
+    dictionary, union of the timers of all ranks (TimerDictionary::serialize)
+    RankEntry for each rank
+    Records of rank 0, rank 1, ...
+
+  Each rank has one Record per timer it has, referring to the timer
+  with its index in the dictionary. Times are inclusive, except the
+  exclusive times, which do not include the time in the children.
+*/
+class TimerDump {
+public:
+   static const int32_t version = 2;
+
+   struct Header {
+      char magic[8];  //"PHIPDUMP"
+      int32_t version;
+      int32_t nRanks;
+      int64_t dictionaryBytes;
+   };
+
+   struct RankEntry {
+      int64_t offset;   //file offset of the first record of the rank
+      int32_t nRecords;
+      int32_t node;     //lowest rank on the same shared-memory node
+   };
+
+   struct Record {
+      int32_t index;     //dictionary index of the timer
+      int32_t threads;   //threads that have executed the timer
+      int64_t count;     //average count over threads
+      double time;       //average time over threads
+      double timeMax;    //time of the slowest thread
+      double timeMin;    //time of the fastest thread
+      double workUnits;  //average workunits over threads
+      double exclusiveTime;    //average exclusive time over threads
+      double exclusiveTimeMax; //exclusive time of the slowest thread
+      double exclusiveTimeMin; //exclusive time of the fastest thread
+   };
+
+   /**
+    * Fill in a header for a file with nRanks ranks
+    */
+   static void setHeader(Header &header, int nRanks, int64_t dictionaryBytes);
+
+   /**
+    * Read a dump file
+    *
+    * @return
+    *   Returns false if the file could not be read or is not a valid dump
+    */
+   bool read(const std::string &fileName);
+
+   const TimerDictionary& getDictionary() const { return dictionary;}
+   int getNumRanks() const { return records.size();}
+   const std::vector<Record>& getRecords(int rank) const { return records[rank];}
+   int getNode(int rank) const { return nodes[rank];}
+
+private:
+   TimerDictionary dictionary;
+   std::vector<std::vector<Record>> records; //records of each rank
+   std::vector<int> nodes; //node of each rank
+};
+
+#endif
@@ -0,0 +1,1951 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include "timerreport.hpp"
+#include "prettyprinttable.hpp"
+
+
+namespace {
+   //a row in the statistics, either a timer or the "other" time of a timer
+   struct Row {
+      int index; //dictionary index of the timer, or of the parent for "other"
+      bool other;
+      int level;
+      int parentRow;
+   };
+
+   //same ordering as ParallelTimerTree::collectTimerStats, each timer
+   //with children is followed by an "other" row
+   void addRows(const TimerDictionary &dictionary, int index, int parentRow, std::vector<Row> &rows){
+      const int row = rows.size();
+      rows.push_back({index, false, dictionary[index].level, parentRow});
+      for(auto childIndex: dictionary[index].childIndices)
+         addRows(dictionary, childIndex, row, rows);
+      if(dictionary[index].childIndices.size() > 0)
+         rows.push_back({index, true, dictionary[index].level + 1, row});
+   }
+
+   double getGroupTime(const TimerDictionary &dictionary, const std::vector<const TimerDump::Record*> &records,
+                       const std::string &group, int index){
+      if(records[index] == NULL)
+         return 0.0;
+      for(auto &timerGroup: dictionary[index].groups){
+         if(group == timerGroup)
+            return records[index]->time;
+      }
+      double groupTime = 0.0;
+      for(auto childIndex: dictionary[index].childIndices)
+         groupTime += getGroupTime(dictionary, records, group, childIndex);
+      return groupTime;
+   }
+
+   //same definition as TimerData::getTimeImbalance, from the average
+   //and maximum over threads
+   double getThreadImbalance(double time, double timeMax, int threads){
+      if(threads > 1 && timeMax > 0.0)
+         return (timeMax - time) / timeMax * threads / (threads - 1);
+      return 1.0;
+   }
+
+   //p10, median and p90 columns, empty if there are no quantiles
+   void addQuantiles(PrettyPrintTable &table, const TimerReport &report, int i){
+      for(double q : {0.1, 0.5, 0.9}) {
+         if(report.hasQuantiles(i))
+            table.addElement(report.getQuantile(i, q));
+         else
+            table.addElement("");
+      }
+   }
+
+   void resize(TimerReport::TimerStatistics &stats, int nRows){
+      const TimerReport::doubleRankPair noMax = {-1.0, -1};
+      const TimerReport::doubleRankPair noMin = {std::numeric_limits<double>::max(), -1};
+      stats.ranksSum.assign(nRows, 0);
+      stats.timeSum.assign(nRows, 0.0);
+      stats.timeMax.assign(nRows, noMax);
+      stats.timeMin.assign(nRows, noMin);
+      stats.timeSketch.assign(nRows, QuantileSketch());
+      stats.nodesSum.assign(nRows, 0);
+      stats.nodeTimeSum.assign(nRows, 0.0);
+      stats.nodeTimeMax.assign(nRows, noMax);
+      stats.workUnitsSum.assign(nRows, 0.0);
+      stats.countSum.assign(nRows, 0);
+      stats.threadsSum.assign(nRows, 0);
+      stats.threadImbalanceSum.assign(nRows, 0.0);
+      stats.threadImbalanceMax.assign(nRows, noMax);
+      stats.threadImbalanceMin.assign(nRows, noMin);
+      stats.exclusiveTimeSum.assign(nRows, 0.0);
+      stats.exclusiveTimeMax.assign(nRows, noMax);
+      stats.exclusiveThreadImbalanceSum.assign(nRows, 0.0);
+      stats.exclusiveThreadImbalanceMax.assign(nRows, noMax);
+   }
+
+   void resize(TimerReport::GroupStatistics &groupStats, int nGroups){
+      groupStats.timeSum.assign(nGroups, 0.0);
+      groupStats.timeMax.assign(nGroups, {-1.0, -1});
+      groupStats.timeMin.assign(nGroups, {std::numeric_limits<double>::max(), -1});
+   }
+
+   //MAXLOC and MINLOC semantics, ties go to the lower rank
+   void maxLoc(TimerReport::doubleRankPair &a, const TimerReport::doubleRankPair &b){
+      if(b.val > a.val || (b.val == a.val && b.rank < a.rank))
+         a = b;
+   }
+
+   void minLoc(TimerReport::doubleRankPair &a, const TimerReport::doubleRankPair &b){
+      if(b.val < a.val || (b.val == a.val && b.rank < a.rank))
+         a = b;
+   }
+
+   void addStatistics(TimerReport::TimerStatistics &a, const TimerReport::TimerStatistics &b){
+      for(unsigned int i = 0; i < a.timeSum.size(); i++){
+         a.ranksSum[i] += b.ranksSum[i];
+         a.timeSum[i] += b.timeSum[i];
+         maxLoc(a.timeMax[i], b.timeMax[i]);
+         minLoc(a.timeMin[i], b.timeMin[i]);
+         a.timeSketch[i].merge(b.timeSketch[i]);
+         a.nodesSum[i] += b.nodesSum[i];
+         a.nodeTimeSum[i] += b.nodeTimeSum[i];
+         maxLoc(a.nodeTimeMax[i], b.nodeTimeMax[i]);
+         a.workUnitsSum[i] += b.workUnitsSum[i];
+         a.countSum[i] += b.countSum[i];
+         a.threadsSum[i] += b.threadsSum[i];
+         a.threadImbalanceSum[i] += b.threadImbalanceSum[i];
+         maxLoc(a.threadImbalanceMax[i], b.threadImbalanceMax[i]);
+         minLoc(a.threadImbalanceMin[i], b.threadImbalanceMin[i]);
+         a.exclusiveTimeSum[i] += b.exclusiveTimeSum[i];
+         maxLoc(a.exclusiveTimeMax[i], b.exclusiveTimeMax[i]);
+         a.exclusiveThreadImbalanceSum[i] += b.exclusiveThreadImbalanceSum[i];
+         maxLoc(a.exclusiveThreadImbalanceMax[i], b.exclusiveThreadImbalanceMax[i]);
+      }
+   }
+
+   void addStatistics(TimerReport::GroupStatistics &a, const TimerReport::GroupStatistics &b){
+      for(unsigned int i = 0; i < a.timeSum.size(); i++){
+         a.timeSum[i] += b.timeSum[i];
+         maxLoc(a.timeMax[i], b.timeMax[i]);
+         minLoc(a.timeMin[i], b.timeMin[i]);
+      }
+   }
+
+   //Statistics of the ranks in one node
+   void collectNode(const TimerDump &dump, const std::vector<int> &ranks, const std::vector<Row> &rows,
+                    TimerReport::TimerStatistics &stats, TimerReport::GroupStatistics &groupStats){
+      const TimerDictionary &dictionary = dump.getDictionary();
+      const int nRows = rows.size();
+      std::vector<const TimerDump::Record*> records;
+      resize(stats, nRows);
+      resize(groupStats, groupStats.name.size());
+      
+      for(auto rank: ranks){
+         records.assign(dictionary.size(), NULL);
+         for(auto &record: dump.getRecords(rank))
+            records[record.index] = &record;
+
+         for(int i = 0; i < nRows; i++){
+            const TimerDump::Record *record = records[rows[i].index];
+            if(record == NULL)
+               continue;
+            double time = record->time;
+            double threadImbalance;
+            double workUnits = -1.0;
+            const double exclusiveThreadImbalance =
+               getThreadImbalance(record->exclusiveTime, record->exclusiveTimeMax, record->threads);
+            if(rows[i].other) {
+               //workunits and exclusive time are not defined for other
+               //time, its thread imbalance is that of the exclusive
+               //time of the parent
+               for(auto childIndex: dictionary[rows[i].index].childIndices)
+                  time -= records[childIndex] != NULL ? records[childIndex]->time : 0.0;
+               threadImbalance = exclusiveThreadImbalance;
+            }
+            else {
+               workUnits = record->workUnits;
+               threadImbalance = getThreadImbalance(record->time, record->timeMax, record->threads);
+               stats.exclusiveTimeSum[i] += record->exclusiveTime;
+               maxLoc(stats.exclusiveTimeMax[i], {record->exclusiveTime, rank});
+               stats.exclusiveThreadImbalanceSum[i] += exclusiveThreadImbalance;
+               maxLoc(stats.exclusiveThreadImbalanceMax[i], {exclusiveThreadImbalance, rank});
+            }
+            stats.ranksSum[i]++;
+            stats.timeSum[i] += time;
+            maxLoc(stats.timeMax[i], {time, rank});
+            minLoc(stats.timeMin[i], {time, rank});
+            stats.timeSketch[i].add(time);
+            stats.workUnitsSum[i] += workUnits;
+            stats.countSum[i] += record->count;
+            stats.threadsSum[i] += record->threads;
+            if(threadImbalance >= 0.0)
+               stats.threadImbalanceSum[i] += threadImbalance;
+            maxLoc(stats.threadImbalanceMax[i], {threadImbalance, rank});
+            minLoc(stats.threadImbalanceMin[i], {threadImbalance, rank});
+         }
+
+         for(unsigned int i = 0; i < groupStats.name.size(); i++){
+            const double groupTime = getGroupTime(dictionary, records, groupStats.name[i], 0);
+            groupStats.timeSum[i] += groupTime;
+            maxLoc(groupStats.timeMax[i], {groupTime, rank});
+            minLoc(groupStats.timeMin[i], {groupTime, rank});
+         }
+      }
+
+      //node is identified by its lowest rank, as in print
+      for(int i = 0; i < nRows; i++){
+         if(stats.ranksSum[i] > 0) {
+            const double nodeAverage = stats.timeSum[i] / stats.ranksSum[i];
+            stats.nodesSum[i] = 1;
+            stats.nodeTimeSum[i] = nodeAverage;
+            stats.nodeTimeMax[i] = {nodeAverage, ranks[0]};
+         }
+      }
+   }
+}
+
+TimerReport::TimerReport() : nProcesses(0), nNodes(1), maxThreads(0), mergeTrees(false) {}
+
+//Compute the fractions of time and the workunit flags from the sums,
+//and reset the print order. Called once all statistics are
+//collected.
+void TimerReport::computeFractions(){
+   const int nTimers = stats.id.size();
+   stats.hasWorkUnits.resize(nTimers);
+   stats.timeTotalFraction.resize(nTimers);
+   stats.timeParentFraction.resize(nTimers);
+   stats.pruned.resize(nTimers);
+   const double functionsMinTime = getFunctionsMinTime();
+   for(int i = 0; i < nTimers; i++){
+      if(stats.workUnitsSum[i] <= 0)
+         stats.hasWorkUnits[i] = false;
+      else
+         stats.hasWorkUnits[i] = true;
+            
+      if(stats.timeSum[0]>0)
+         stats.timeTotalFraction[i]=stats.timeSum[i]/stats.timeSum[0];
+      else
+         stats.timeTotalFraction[i]=0.0;
+            
+      if(stats.timeSum[stats.parentIndex[i]]>0)
+         stats.timeParentFraction[i]=stats.timeSum[i]/stats.timeSum[stats.parentIndex[i]];
+      else
+         stats.timeParentFraction[i]=0.0;
+
+      //parents are before their children, whole subtrees are pruned
+      stats.pruned[i] = i > 0 && stats.pruned[stats.parentIndex[i]];
+      if(stats.id[i] >= 0 && stats.timeMax[i].val < functionsMinTime){
+         const auto &groups = dictionary[stats.id[i]].groups;
+         if(std::find(groups.begin(), groups.end(), "Functions") != groups.end())
+            stats.pruned[i] = true;
+      }
+   }
+
+   //total time is in the group called Total (timer id=0)
+   const int nGroups = groupStats.name.size();
+   auto total = std::find(groupStats.name.begin(), groupStats.name.end(), "Total");
+   const int totalIndex = total != groupStats.name.end() ? total - groupStats.name.begin() : 0;
+   groupStats.timeTotalFraction.resize(nGroups);
+   for(int i = 0; i < nGroups; i++){
+      if(groupStats.timeSum[totalIndex] > 0)
+         groupStats.timeTotalFraction[i] = groupStats.timeSum[i] / groupStats.timeSum[totalIndex];
+      else 
+         groupStats.timeTotalFraction[i] = 0.0;
+   }
+
+   order.resize(nTimers);
+   for(int i = 0; i < nTimers; i++)
+      order[i] = i;
+}
+
+//Fill in the statistics from a dump, like ParallelTimerTree does with
+//reductions. The statistics of each node are computed separately, in
+//parallel over OpenMP threads.
+void TimerReport::collect(const TimerDump &dump, const std::vector<bool> &selectedRanks, int subtreeIndex){
+   dictionary = dump.getDictionary();
+   stats = TimerStatistics();
+   groupStats = GroupStatistics();
+
+   //the root is always the first row, so that fractions are of the total time
+   std::vector<Row> rows;
+   if(subtreeIndex > 0) {
+      rows.push_back({0, false, 0, 0});
+      addRows(dictionary, subtreeIndex, 0, rows);
+   }
+   else {
+      addRows(dictionary, 0, 0, rows);
+   }
+
+   std::map<int, std::vector<int>> nodes; //ranks in each node
+   for(int rank = 0; rank < dump.getNumRanks(); rank++){
+      if(selectedRanks[rank])
+         nodes[dump.getNode(rank)].push_back(rank);
+   }
+   std::vector<std::vector<int>> nodeRanks;
+   for(auto &node: nodes)
+      nodeRanks.push_back(node.second);
+   
+   for(unsigned int index = 0; index < dictionary.size(); index++){
+      for(auto &group: dictionary[index].groups){
+         if(std::find(groupStats.name.begin(), groupStats.name.end(), group) == groupStats.name.end())
+            groupStats.name.push_back(group);
+      }
+   }
+   std::sort(groupStats.name.begin(), groupStats.name.end());
+
+   resize(stats, rows.size());
+   resize(groupStats, groupStats.name.size());
+#pragma omp parallel
+   {
+      TimerStatistics nodeStats;
+      GroupStatistics nodeGroupStats;
+      TimerStatistics threadStats;
+      GroupStatistics threadGroupStats;
+      nodeGroupStats.name = groupStats.name;
+      resize(threadStats, rows.size());
+      resize(threadGroupStats, groupStats.name.size());
+#pragma omp for schedule(dynamic)
+      for(unsigned int node = 0; node < nodeRanks.size(); node++){
+         collectNode(dump, nodeRanks[node], rows, nodeStats, nodeGroupStats);
+         addStatistics(threadStats, nodeStats);
+         addStatistics(threadGroupStats, nodeGroupStats);
+      }
+#pragma omp critical
+      {
+         addStatistics(stats, threadStats);
+         addStatistics(groupStats, threadGroupStats);
+      }
+   }
+
+   for(auto &row: rows){
+      stats.id.push_back(row.other ? -1 : row.index);
+      stats.level.push_back(row.level);
+      stats.parentIndex.push_back(row.parentRow);
+   }
+   nProcesses = 0;
+   maxThreads = 0;
+   for(auto &ranks: nodeRanks){
+      nProcesses += ranks.size();
+      for(auto rank: ranks){
+         for(auto &record: dump.getRecords(rank))
+            maxThreads = std::max(maxThreads, (int)record.threads);
+      }
+   }
+   nNodes = nodeRanks.size();
+   mergeTrees = true;
+   computeFractions();
+}
+
+//Sort the children of each timer, "other" stays last. Statistics are
+//stored depth first, so each subtree is a contiguous range of rows
+//starting at its root.
+bool TimerReport::sortTimers(const std::string &key){
+   std::vector<double> value(stats.id.size());
+   for(unsigned int i = 0; i < stats.id.size(); i++){
+      if(key == "time")
+         value[i] = stats.timeSum[i];
+      else if(key == "max")
+         value[i] = stats.timeMax[i].val;
+      else if(key == "imbalance")
+         value[i] = getImbalance(i);
+      else if(key == "count")
+         value[i] = stats.countSum[i];
+      else if(key == "self")
+         value[i] = stats.exclusiveTimeSum[i];
+      else if(key != "id")
+         return false;
+   }
+
+   //subtree of each row in the original order, range [row, end[row])
+   std::vector<unsigned int> end(stats.id.size());
+   for(int i = stats.id.size() - 1; i >= 0; i--){
+      unsigned int j = i + 1;
+      while(j < stats.id.size() && stats.level[j] > stats.level[i])
+         j = end[j];
+      end[i] = j;
+   }
+
+   order.clear();
+   auto addSubtree = [&](auto &self, unsigned int row) -> void {
+      order.push_back(row);
+      std::vector<unsigned int> rowChildren;
+      for(unsigned int child = row + 1; child < end[row]; child = end[child])
+         rowChildren.push_back(child);
+      if(key != "id")
+         std::stable_sort(rowChildren.begin(), rowChildren.end(), [&](unsigned int a, unsigned int b) {
+               //other timer (id -1) is always last
+               if((stats.id[a] == -1) != (stats.id[b] == -1))
+                  return stats.id[b] == -1;
+               return value[a] > value[b];
+            });
+      for(auto child: rowChildren)
+         self(self, child);
+   };
+   if(stats.id.size() > 0)
+      addSubtree(addSubtree, 0);
+   return true;
+}
+
+void TimerReport::selectRankTimesRows(int maxColumns){
+   rankTimesRows.clear();
+   for(unsigned int i = 0; i < stats.id.size(); i++){
+      if(stats.id[i] != -1)
+         rankTimesRows.push_back(i);
+   }
+   std::stable_sort(rankTimesRows.begin(), rankTimesRows.end(),
+                    [this](int a, int b){ return stats.timeSum[a] > stats.timeSum[b]; });
+   if((int)rankTimesRows.size() > maxColumns)
+      rankTimesRows.resize(std::max(maxColumns, 0));
+}
+
+void TimerReport::collectRankTimes(const TimerDump &dump, const std::vector<bool> &selectedRanks){
+   selectRankTimesRows(getHeatmapTimers());
+   std::vector<double> time(dictionary.size());
+   rankTimes.clear();
+   for(int rank = 0; rank < dump.getNumRanks(); rank++){
+      if(!selectedRanks[rank])
+         continue;
+      time.assign(dictionary.size(), 0.0);
+      for(auto &record: dump.getRecords(rank))
+         time[record.index] = record.time;
+      rankTimes.push_back(rank);
+      for(auto row: rankTimesRows)
+         rankTimes.push_back(time[stats.id[row]]);
+   }
+}
+
+//Time of one rank of a dump in each row of the statistics, and whether
+//the rank has the timer. Other rows get the time of their parent not
+//spent in its children, as in collectNode.
+void TimerReport::getRankTimes(const TimerDump &dump, int rank, std::vector<double> &time, std::vector<int> &ranks) const{
+   const int nRows = stats.id.size();
+   std::vector<double> indexTime(dictionary.size(), 0.0);
+   std::vector<int> indexRanks(dictionary.size(), 0);
+   for(auto &record: dump.getRecords(rank)){
+      indexTime[record.index] = record.time;
+      indexRanks[record.index] = 1;
+   }
+   time.assign(nRows, 0.0);
+   ranks.assign(nRows, 0);
+   for(int i = 0; i < nRows; i++){
+      if(stats.id[i] != -1) {
+         time[i] = indexTime[stats.id[i]];
+         ranks[i] = indexRanks[stats.id[i]];
+      }
+      else {
+         const int parentId = stats.id[stats.parentIndex[i]];
+         time[i] = indexTime[parentId];
+         ranks[i] = indexRanks[parentId];
+         for(auto childIndex: dictionary[parentId].childIndices)
+            time[i] -= indexTime[childIndex];
+      }
+   }
+}
+
+void TimerReport::collectSlowestTimes(const TimerDump &dump){
+   std::vector<int> ranks;
+   slowestTime.assign(stats.id.size(), 0.0);
+   if(stats.id.size() > 0 && stats.ranksSum[0] > 0)
+      getRankTimes(dump, stats.timeMax[0].rank, slowestTime, ranks);
+}
+
+//Same k-means as ParallelTimerTree::collectClusters, with the processes
+//of the dump in rank order so that ties are broken the same way
+void TimerReport::collectClusters(const TimerDump &dump, const std::vector<bool> &selectedRanks){
+   const int maxIterations = 50;
+   const int nRows = stats.id.size();
+   selectRankTimesRows(getHeatmapTimers());
+   const int nColumns = rankTimesRows.size();
+
+   std::vector<int> pointRanks;
+   std::vector<double> points; //time in rankTimesRows of each process
+   std::vector<double> rowTimes; //time in all rows of each process
+   std::vector<int> rowRanks;
+   std::vector<double> time;
+   std::vector<int> ranks;
+   for(int rank = 0; rank < dump.getNumRanks(); rank++){
+      if(!selectedRanks[rank])
+         continue;
+      getRankTimes(dump, rank, time, ranks);
+      pointRanks.push_back(rank);
+      for(auto row: rankTimesRows)
+         points.push_back(time[row]);
+      rowTimes.insert(rowTimes.end(), time.begin(), time.end());
+      rowRanks.insert(rowRanks.end(), ranks.begin(), ranks.end());
+   }
+   const int nPoints = pointRanks.size();
+   int nClusters = std::min(getClusters(), nPoints);
+   auto distance = [&](int p, const double *centroid){
+      double d = 0.0;
+      for(int c = 0; c < nColumns; c++)
+         d += (points[p * nColumns + c] - centroid[c]) * (points[p * nColumns + c] - centroid[c]);
+      return d;
+   };
+
+   //deterministic farthest-point initialization, the first centroid is
+   //the process with most time in the selected timers
+   std::vector<double> centroids;
+   std::vector<double> minDistance(nPoints, std::numeric_limits<double>::max());
+   for(int k = 0; k < nClusters; k++){
+      int farthest = 0;
+      double farthestValue = -1.0;
+      for(int p = 0; p < nPoints; p++){
+         double value = 0.0;
+         if(k == 0) {
+            for(int c = 0; c < nColumns; c++)
+               value += points[p * nColumns + c];
+         }
+         else {
+            minDistance[p] = std::min(minDistance[p], distance(p, centroids.data() + (k - 1) * nColumns));
+            value = minDistance[p];
+         }
+         if(value > farthestValue) {
+            farthest = p;
+            farthestValue = value;
+         }
+      }
+      if(k > 0 && farthestValue <= 0.0) {
+         //fewer distinct processes than clusters
+         nClusters = k;
+         break;
+      }
+      centroids.insert(centroids.end(), points.begin() + farthest * nColumns, points.begin() + (farthest + 1) * nColumns);
+   }
+
+   std::vector<int> cluster(nPoints, -1);
+   std::vector<double> sums((nColumns + 1) * nClusters);
+   for(int iteration = 0; iteration < maxIterations; iteration++){
+      bool anyChanged = false;
+      for(int p = 0; p < nPoints; p++){
+         int nearest = 0;
+         for(int k = 1; k < nClusters; k++){
+            if(distance(p, centroids.data() + k * nColumns) < distance(p, centroids.data() + nearest * nColumns))
+               nearest = k;
+         }
+         anyChanged = anyChanged || nearest != cluster[p];
+         cluster[p] = nearest;
+      }
+      if(!anyChanged)
+         break;
+
+      std::fill(sums.begin(), sums.end(), 0.0);
+      for(int p = 0; p < nPoints; p++){
+         for(int c = 0; c < nColumns; c++)
+            sums[cluster[p] * (nColumns + 1) + c] += points[p * nColumns + c];
+         sums[cluster[p] * (nColumns + 1) + nColumns] += 1.0;
+      }
+      for(int k = 0; k < nClusters; k++){
+         const double size = sums[k * (nColumns + 1) + nColumns];
+         if(size > 0.0) {
+            for(int c = 0; c < nColumns; c++)
+               centroids[k * nColumns + c] = sums[k * (nColumns + 1) + c] / size;
+         }
+      }
+   }
+
+   //representative is the process closest to the centroid of its cluster
+   std::vector<double> closest(nClusters, std::numeric_limits<double>::max());
+   clusterStats.size.assign(nClusters, 0);
+   clusterStats.representative.assign(nClusters, -1);
+   clusterStats.timeSum.assign(nClusters * nRows, 0.0);
+   clusterStats.ranksSum.assign(nClusters * nRows, 0);
+   for(int p = 0; p < nPoints; p++){
+      const int k = cluster[p];
+      const double d = distance(p, centroids.data() + k * nColumns);
+      if(d < closest[k]) {
+         closest[k] = d;
+         clusterStats.representative[k] = pointRanks[p];
+      }
+      clusterStats.size[k]++;
+      for(int i = 0; i < nRows; i++){
+         clusterStats.timeSum[k * nRows + i] += rowTimes[p * nRows + i];
+         clusterStats.ranksSum[k * nRows + i] += rowRanks[p * nRows + i];
+      }
+   }
+}
+
+int TimerReport::getHeatmapTimers(){
+   const char *envVariable = getenv("PHIPROF_HEATMAP_TIMERS");
+   if(envVariable != NULL && atoi(envVariable) > 0)
+      return atoi(envVariable);
+   return 32;
+}
+
+int TimerReport::getClusters(){
+   const char *envVariable = getenv("PHIPROF_CLUSTERS");
+   if(envVariable != NULL && atoi(envVariable) > 0)
+      return atoi(envVariable);
+   return 3;
+}
+
+int TimerReport::getSelfTimers(){
+   const char *envVariable = getenv("PHIPROF_SELF_TIMERS");
+   if(envVariable != NULL && atoi(envVariable) > 0)
+      return atoi(envVariable);
+   return 20;
+}
+
+int TimerReport::getImbalanceTimers(){
+   const char *envVariable = getenv("PHIPROF_IMBALANCE_TIMERS");
+   if(envVariable != NULL && atoi(envVariable) > 0)
+      return atoi(envVariable);
+   return 20;
+}
+
+double TimerReport::getFunctionsMinTime(){
+   const char *envVariable = getenv("PHIPROF_FUNCTIONS_MIN_TIME");
+   if(envVariable != NULL)
+      return atof(envVariable);
+   return 0.001;
+}
+
+double TimerReport::getAverage(int i) const{
+   return stats.ranksSum[i] > 0 ? stats.timeSum[i] / stats.ranksSum[i] : 0.0;
+}
+
+double TimerReport::getExclusiveAverage(int i) const{
+   return stats.ranksSum[i] > 0 ? stats.exclusiveTimeSum[i] / stats.ranksSum[i] : 0.0;
+}
+
+double TimerReport::getAverageThreads(int i) const{
+   return stats.ranksSum[i] > 0 ? double(stats.threadsSum[i]) / stats.ranksSum[i] : 0.0;
+}
+
+double TimerReport::getImbalance(int i) const{
+   const int nRanks = stats.ranksSum[i];
+   if(nRanks > 1 && stats.timeMax[i].val > 0.0)
+      return (stats.timeMax[i].val - getAverage(i)) / stats.timeMax[i].val * nRanks / (nRanks - 1);
+   return 0.0;
+}
+
+double TimerReport::getImbalanceCost(int i) const{
+   const int nRanks = stats.ranksSum[i];
+   if(nRanks > 1)
+      return std::max(stats.timeMax[i].val - getAverage(i), 0.0) * nRanks;
+   return 0.0;
+}
+
+double TimerReport::getParallelEfficiency(int i) const{
+   if(stats.ranksSum[i] > 0 && stats.timeMax[i].val > 0.0)
+      return getAverage(i) / stats.timeMax[i].val;
+   return 1.0;
+}
+
+bool TimerReport::hasQuantiles(int i) const{
+   return i < (int)stats.timeSketch.size() && stats.timeSketch[i].getWeight() > 0.0;
+}
+
+double TimerReport::getQuantile(int i, double q) const{
+   if(i < (int)stats.timeSketch.size())
+      return stats.timeSketch[i].getQuantile(q);
+   return 0.0;
+}
+
+bool TimerReport::isPrintStyle(const std::string &style){
+   return style == "groups" || style == "compact" || style == "full" || style == "detailed" ||
+      style == "json" || style == "csv" || style == "flame" || style == "flame-max" ||
+      style == "heatmap" || style == "heatmap-image" || style == "clusters" || style == "imbalance" ||
+      style == "self" || style == "flat";
+}
+
+std::string TimerReport::getFileExtension(const std::string &style){
+   if(style == "json" || style == "csv")
+      return style;
+   //folded stacks of different variants cannot share a file
+   if(style == "flame")
+      return "folded";
+   if(style == "flame-max")
+      return "max.folded";
+   if(style == "heatmap")
+      return "npy";
+   if(style == "heatmap-image")
+      return "ppm";
+   return "txt";
+}
+
+bool TimerReport::print(const std::string &style, std::ostream &output, double minFraction) const{
+   std::map<std::string, std::string> groupIds;
+   getGroupIds(groupIds);
+   if(style == "groups")
+      return printGroupStatistics(minFraction >= 0.0 ? minFraction : 0.0, groupIds, output);
+   else if(style == "compact")
+      return printTimers(minFraction >= 0.0 ? minFraction : 0.01, groupIds, output);
+   else if(style == "full")
+      return printTimers(minFraction >= 0.0 ? minFraction : 0.0, groupIds, output);
+   else if(style == "detailed")
+      return printTimersDetailed(minFraction >= 0.0 ? minFraction : 0.0, groupIds, output);
+   else if(style == "json")
+      return printJson(minFraction >= 0.0 ? minFraction : 0.0, groupIds, output);
+   else if(style == "csv")
+      return printCsv(minFraction >= 0.0 ? minFraction : 0.0, groupIds, output);
+   else if(style == "flame")
+      return printFlame(false, output);
+   else if(style == "flame-max")
+      return printFlame(true, output);
+   else if(style == "heatmap")
+      return printHeatmap(output);
+   else if(style == "heatmap-image")
+      return printHeatmapImage(output);
+   else if(style == "clusters")
+      return printClusters(minFraction >= 0.0 ? minFraction : 0.01, output);
+   else if(style == "imbalance")
+      return printImbalance(minFraction >= 0.0 ? minFraction : 0.01, output);
+   else if(style == "self")
+      return printSelf(minFraction >= 0.0 ? minFraction : 0.0, output);
+   else if(style == "flat")
+      return printFlat(minFraction >= 0.0 ? minFraction : 0.0, groupIds, output);
+   return false;
+}
+
+
+////-------------------------------------------------------------------------
+///  PRINT functions
+
+////-------------------------------------------------------------------------      
+
+// Creating std::map of group names to group one-letter ID
+void TimerReport::getGroupIds(std::map<std::string, std::string> &groupIds) const{
+   groupIds.clear();
+   //add groups to std::map
+   for(unsigned int index=0; index< dictionary.size(); index++) {
+      for(auto &group : dictionary[index].groups){
+         groupIds[group] = group;
+      }
+   }
+   //assign letters
+   int character = 65; // ASCII A, TODO skip after Z to a, see ascii table
+   for(std::map<std::string, std::string>::const_iterator group = groupIds.begin();
+       group != groupIds.end(); ++group) {
+      groupIds[group->first] = character++;
+   }
+}
+
+
+
+
+//print groups
+bool TimerReport::printGroupStatistics(double minFraction,
+                                       const std::map<std::string, std::string> &groupIds,
+                                       std::ostream &output) const{
+   
+   PrettyPrintTable table;
+   table.addTitle("Groups");
+   
+   
+   //print heders
+   table.addHorizontalLine();      
+   //row1
+   table.addElement("",2);
+   table.addElement("Time (s)",6);
+   table.addHorizontalLine();
+   //row2
+   table.addElement("Group",1);
+   table.addElement("Name",1);
+   table.addElement("Avg",1);      
+   table.addElement("% of total",1);      
+   table.addElement("Max time,rank",2);      
+   table.addElement("Min time,rank",2);      
+   table.addHorizontalLine();
+
+   for(unsigned int i=0;i<groupStats.name.size();i++){            
+      if(minFraction<=groupStats.timeTotalFraction[i]){
+         std::string groupId= groupIds.count(groupStats.name[i]) ? groupIds.find(groupStats.name[i])->second : std::string();
+         table.addRow();
+         table.addElement(groupId);
+         table.addElement(groupStats.name[i]);
+         if (nProcesses > 0)
+            table.addElement(groupStats.timeSum[i]/nProcesses);
+         else
+            table.addElement(0.0);
+         table.addElement(100.0*groupStats.timeTotalFraction[i]);
+         table.addElement(groupStats.timeMax[i].val);
+         table.addElement(groupStats.timeMax[i].rank);
+         table.addElement(groupStats.timeMin[i].val);
+         table.addElement(groupStats.timeMin[i].rank);
+      }
+   }
+   table.addHorizontalLine();
+   table.print(output);
+   return true;
+}
+         
+      
+      
+//title for the timer tables
+std::string TimerReport::getTableTitle(double minFraction) const{
+   std::stringstream buffer;
+   if(minFraction > 0.0 ) 
+      buffer << "Timers with more than " << minFraction * 100 <<"% of total time. ";
+   else
+      buffer << "All timers. ";
+
+   if(mergeTrees)
+      buffer << "Union of timers from "<< nProcesses << " processes";
+   else
+      buffer << "Set of identical timers has "<< nProcesses << " processes";
+   if(nNodes > 1)
+      buffer << " on " << nNodes << " nodes";
+   if(maxThreads > 0)
+      buffer << " with up to " << maxThreads << " threads each";
+   buffer << ".";
+   return buffer.str();
+}
+
+
+//print out global timers
+bool TimerReport::printTimers(double minFraction, const std::map<std::string, std::string>& groupIds, std::ostream &output) const{
+   PrettyPrintTable table;
+   std::stringstream buffer;
+   table.addTitle(getTableTitle(minFraction));
+   
+   //print heders
+   table.addHorizontalLine();      
+   //row1
+   table.addElement("",mergeTrees ? 5 : 4);
+   table.addElement("Count",1);
+   table.addElement("Process time",7);
+   table.addElement("Thread imbalances",4);
+   table.addElement("Workunits",1);      
+   table.addHorizontalLine();
+   //row2
+   table.addElement("Id",1);
+   table.addElement("Lvl",1);
+   table.addElement("Grp",1);
+   table.addElement("Name",1);
+   if(mergeTrees)
+      table.addElement("Ranks",1);
+   table.addElement("Avg",1);
+   table.addElement("Avg (s)",1);      
+   table.addElement("Self (s)",1);
+   table.addElement("P10 (s)",1);
+   table.addElement("Med (s)",1);
+   table.addElement("P90 (s)",1);
+   table.addElement("Time %",1);      
+   table.addElement("Imb %",1);
+   table.addElement("No",1);            
+   table.addElement("Avg %",1);
+   table.addElement("Max %",1);
+   table.addElement("Self %",1);
+
+   table.addElement("Avg",1);       
+   table.addHorizontalLine();
+
+   //print out all labels recursively
+   for(unsigned int row = 1; row < order.size(); row++){
+      const int i = order[row];
+      int id = stats.id[i];
+      int nRanks = stats.ranksSum[i]; //processes that have this timer
+      if(isPrinted(i, minFraction)){
+         //print timer if enough time is spent in it
+         if(id != -1) 
+            table.addElement(id);
+         else
+            table.addElement("");
+         
+         table.addElement(stats.level[i]);
+         if(id != -1) {
+            //normal timer, not "other" timer
+            //get and print group ids
+            buffer.str("");
+            for(auto &group : dictionary[id].groups){
+               std::string groupId=groupIds.count(group) ? groupIds.find(group)->second : std::string();
+               buffer << groupId;
+            }
+            table.addElement(buffer.str());
+            table.addElement(dictionary[id].label, 1, stats.level[i]-1);
+         }
+         else{
+            table.addElement(""); // no groups
+            table.addElement("Other", 1, stats.level[i]-1);
+         }
+         if(mergeTrees)
+            table.addElement(nRanks);
+
+	    
+         if(nRanks>0)
+            table.addElement(stats.countSum[i] / nRanks);
+         else
+            table.addElement(0.0);
+         
+         if(nRanks>0)
+            table.addElement(stats.timeSum[i] / nRanks);
+         else
+            table.addElement(0.0);
+         //time not in the children, "other" is all exclusive
+         if(id != -1)
+            table.addElement(getExclusiveAverage(i));
+         else
+            table.addElement("");
+         //distribution over processes, shows how many are slow
+         addQuantiles(table, *this, i);
+         
+         table.addElement(100.0 * stats.timeParentFraction[i]);
+         
+         table.addElement(100.0 * getImbalance(i));
+
+         table.addElement(getAverageThreads(i));
+         
+         if(getAverageThreads(i) > 1.0 && stats.threadImbalanceMax[i].val >= 0.0) {
+            table.addElement(100.0 * stats.threadImbalanceSum[i]/nRanks);
+            table.addElement(100.0 * stats.threadImbalanceMax[i].val);
+         }
+         else {
+            //not threaded
+            table.addElement("");
+            table.addElement("");
+         }
+         if(getAverageThreads(i) > 1.0 && stats.exclusiveThreadImbalanceMax[i].val >= 0.0)
+            table.addElement(100.0 * stats.exclusiveThreadImbalanceSum[i]/nRanks);
+         else
+            table.addElement("");
+         if(stats.hasWorkUnits[i] && id != -1){
+            buffer.str("");
+            
+            //print if units defined for all processes
+            //note how the total rate is computed. This is to avoid one process with little data to     
+            //skew results one way or the other                        
+            if(stats.timeSum[i]>0){
+               buffer << std::setprecision(4) << stats.workUnitsSum[i]/stats.timeSum[i];
+            }
+            else if (stats.workUnitsSum[i]>0){
+               //time is zero
+               buffer << "inf";
+            }
+            else {
+               //zero time zero units
+               buffer << 0;
+            }
+            buffer << " "<< dictionary[id].workUnitLabel<<"/s";                     
+            table.addElement(buffer.str());
+
+         }
+         table.addRow();
+      }
+   }
+   
+   table.addHorizontalLine();
+   table.print(output);
+
+   return true;
+}
+
+
+//print out global timers
+bool TimerReport::printTimersDetailed(double minFraction, const std::map<std::string, std::string>& groupIds, std::ostream &output) const{
+   PrettyPrintTable table;
+
+   std::stringstream buffer;
+   table.addTitle(getTableTitle(minFraction));
+      
+
+   
+   //print heders
+   table.addHorizontalLine();      
+   //row1
+   table.addElement("",mergeTrees ? 5 : 4);
+   table.addElement("Threads",1);
+   table.addElement("Time (s)",10);
+   table.addElement("Node time (s)",3);
+   table.addElement("Calls",1);
+   table.addElement("Workunit-rate",3);      
+   table.addHorizontalLine();
+   //row2
+   table.addElement("Id",1);
+   table.addElement("Lvl",1);
+   table.addElement("Grp",1);
+   table.addElement("Label",1);
+   if(mergeTrees)
+      table.addElement("Ranks",1);
+   table.addElement("Avg",1);
+   table.addElement("Avg",1);      
+   table.addElement("Self",1);
+   table.addElement("%",1);      
+   table.addElement("Max time,rank",2);      
+   table.addElement("Min time,rank",2);      
+   table.addElement("P10",1);
+   table.addElement("Median",1);
+   table.addElement("P90",1);
+   table.addElement("Max time,leader",2);
+   table.addElement("Imb %",1);
+   table.addElement("Avg",1);      
+   table.addElement("Total",1);     
+   table.addElement("Per process",1);       
+   table.addElement("Unit",1);       
+   table.addHorizontalLine();
+
+   //print out all labels recursively
+   for(unsigned int row = 1; row < order.size(); row++){
+      const int i = order[row];
+      int id = stats.id[i];
+      int nRanks = stats.ranksSum[i]; //processes that have this timer
+      if(isPrinted(i, minFraction)){
+         //print timer if enough time is spent in it
+         if(id != -1) 
+            table.addElement(id);
+         else
+            table.addElement("");
+
+         table.addElement(stats.level[i]);
+         if(id != -1) {
+            //normal timer, not "other" timer
+            //get and print group ids
+            buffer.str("");
+            for(auto &group : dictionary[id].groups){
+               std::string groupId=groupIds.count(group) ? groupIds.find(group)->second : std::string();
+               buffer << groupId;
+            }
+            table.addElement(buffer.str());
+            table.addElement(dictionary[id].label, 1, stats.level[i]-1);
+         }
+         else{
+            table.addElement(""); // no groups
+            table.addElement("Other", 1, stats.level[i]-1);
+         }
+         if(mergeTrees)
+            table.addElement(nRanks);
+         table.addElement(getAverageThreads(i));
+         if(nRanks > 0)
+            table.addElement(stats.timeSum[i]/nRanks);
+         else
+            table.addElement(0.0);
+         if(id != -1)
+            table.addElement(getExclusiveAverage(i));
+         else
+            table.addElement("");
+         table.addElement(100.0*stats.timeParentFraction[i]);
+         table.addElement(stats.timeMax[i].val);            
+         table.addElement(stats.timeMax[i].rank);
+         table.addElement(stats.timeMin[i].val);
+         table.addElement(stats.timeMin[i].rank);
+         addQuantiles(table, *this, i);
+         //slowest node, and imbalance between node averages
+         table.addElement(stats.nodeTimeMax[i].val);
+         table.addElement(stats.nodeTimeMax[i].rank);
+         int nNodes = stats.nodesSum[i]; //nodes that have this timer
+         if(nNodes > 1 && stats.nodeTimeMax[i].val != 0.0) {
+            double imbTime = stats.nodeTimeMax[i].val - stats.nodeTimeSum[i] / nNodes;
+            table.addElement(100.0 * imbTime / stats.nodeTimeMax[i].val * nNodes / (nNodes - 1));
+         }
+         else{
+            table.addElement(0.0);
+         }
+         if(nRanks > 0)
+            table.addElement(stats.countSum[i]/nRanks);
+         else
+            table.addElement(0.0);
+
+         if(stats.hasWorkUnits[i]){
+            //print if units defined for all processes
+            //note how the total rate is computed. This is to avoid one process with little data to     
+            //skew results one way or the other                        
+            if(stats.timeSum[i]>0){
+               table.addElement(nRanks*(stats.workUnitsSum[i]/stats.timeSum[i]));
+               table.addElement(stats.workUnitsSum[i]/stats.timeSum[i]);
+            }
+            else if (stats.workUnitsSum[i]>0){
+               //time is zero
+               table.addElement("inf");
+               table.addElement("inf");
+            }
+            else {
+               //zero time zero units
+               table.addElement(0);
+               table.addElement(0);
+            }
+            buffer.str("");
+            buffer << dictionary[id].workUnitLabel<<"/s";                     
+            table.addElement(buffer.str());
+         }
+         table.addRow();
+      }
+   }
+   
+   table.addHorizontalLine();
+   table.print(output);
+
+   return true;
+}
+
+
+////-------------------------------------------------------------------------
+///  Machine-readable output, values are streamed directly into output
+////-------------------------------------------------------------------------
+
+namespace {
+   void writeJsonString(std::ostream &output, const std::string &value){
+      output << '"';
+      for(char c: value){
+         if(c == '"' || c == '\\')
+            output << '\\' << c;
+         else if(static_cast<unsigned char>(c) < 0x20)
+            output << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+         else
+            output << c;
+      }
+      output << '"';
+   }
+
+   //JSON has no infinities or NaNs
+   void writeJsonNumber(std::ostream &output, double value){
+      if(std::isfinite(value))
+         output << value;
+      else
+         output << "null";
+   }
+
+   void writeJsonValueRank(std::ostream &output, const char *rankName, const TimerReport::doubleRankPair &value, bool valid){
+      if(valid) {
+         output << "{\"value\": ";
+         writeJsonNumber(output, value.val);
+         output << ", \"" << rankName << "\": " << value.rank << "}";
+      }
+      else {
+         output << "null";
+      }
+   }
+
+   void writeCsvString(std::ostream &output, const std::string &value){
+      output << '"';
+      for(char c: value){
+         if(c == '"')
+            output << '"';
+         output << c;
+      }
+      output << '"';
+   }
+}
+
+std::string TimerReport::getFullLabel(int i) const{
+   if(stats.id[i] != -1)
+      return dictionary.getFullLabel(stats.id[i]);
+   return dictionary.getFullLabel(stats.id[stats.parentIndex[i]]) + "/Other";
+}
+
+bool TimerReport::printJson(double minFraction, const std::map<std::string, std::string> &groupIds, std::ostream &output) const{
+   const std::streamsize precision = output.precision(std::numeric_limits<double>::max_digits10);
+   output << "{\n  \"processes\": " << nProcesses << ",\n  \"nodes\": " << nNodes
+          << ",\n  \"maxThreads\": " << maxThreads << ",\n  \"merged\": " << (mergeTrees ? "true" : "false");
+
+   output << ",\n  \"groups\": [";
+   for(unsigned int i = 0; i < groupStats.name.size(); i++){
+      output << (i > 0 ? ",\n" : "\n") << "    {\"name\": ";
+      writeJsonString(output, groupStats.name[i]);
+      output << ", \"id\": ";
+      writeJsonString(output, groupIds.count(groupStats.name[i]) ? groupIds.find(groupStats.name[i])->second : std::string());
+      output << ", \"timeSum\": ";
+      writeJsonNumber(output, groupStats.timeSum[i]);
+      output << ", \"timeAvg\": ";
+      writeJsonNumber(output, nProcesses > 0 ? groupStats.timeSum[i] / nProcesses : 0.0);
+      output << ", \"totalFraction\": ";
+      writeJsonNumber(output, groupStats.timeTotalFraction[i]);
+      output << ", \"timeMax\": ";
+      writeJsonValueRank(output, "rank", groupStats.timeMax[i], nProcesses > 0);
+      output << ", \"timeMin\": ";
+      writeJsonValueRank(output, "rank", groupStats.timeMin[i], nProcesses > 0);
+      output << "}";
+   }
+   output << "\n  ],\n  \"timers\": [";
+
+   bool first = true;
+   for(unsigned int row = 0; row < order.size(); row++){
+      const int i = order[row];
+      const int id = stats.id[i];
+      const int nRanks = stats.ranksSum[i];
+      if(!isPrinted(i, minFraction))
+         continue;
+      output << (first ? "\n" : ",\n") << "    {\"row\": " << i << ", \"parentRow\": " << stats.parentIndex[i];
+      first = false;
+      output << ", \"id\": ";
+      if(id != -1)
+         output << id;
+      else
+         output << "null";
+      //dictionary id of the parent timer, also for "other"
+      const int parentId = id != -1 ? dictionary[id].parentIndex : stats.id[stats.parentIndex[i]];
+      output << ", \"parentId\": ";
+      if(parentId >= 0)
+         output << parentId;
+      else
+         output << "null";
+      output << ", \"level\": " << stats.level[i] << ", \"label\": ";
+      writeJsonString(output, id != -1 ? dictionary[id].label : "Other");
+      output << ", \"fullLabel\": ";
+      writeJsonString(output, getFullLabel(i));
+      output << ", \"groups\": [";
+      if(id != -1) {
+         for(unsigned int g = 0; g < dictionary[id].groups.size(); g++){
+            output << (g > 0 ? ", " : "");
+            writeJsonString(output, dictionary[id].groups[g]);
+         }
+      }
+      output << "], \"ranks\": " << nRanks;
+
+      output << ",\n     \"time\": {\"sum\": ";
+      writeJsonNumber(output, stats.timeSum[i]);
+      output << ", \"avg\": ";
+      writeJsonNumber(output, getAverage(i));
+      output << ", \"max\": ";
+      writeJsonValueRank(output, "rank", stats.timeMax[i], nRanks > 0);
+      output << ", \"min\": ";
+      writeJsonValueRank(output, "rank", stats.timeMin[i], nRanks > 0);
+      //NaN is written as null
+      const double missing = std::numeric_limits<double>::quiet_NaN();
+      output << ", \"p10\": ";
+      writeJsonNumber(output, hasQuantiles(i) ? getQuantile(i, 0.1) : missing);
+      output << ", \"median\": ";
+      writeJsonNumber(output, hasQuantiles(i) ? getQuantile(i, 0.5) : missing);
+      output << ", \"p90\": ";
+      writeJsonNumber(output, hasQuantiles(i) ? getQuantile(i, 0.9) : missing);
+      output << ", \"totalFraction\": ";
+      writeJsonNumber(output, stats.timeTotalFraction[i]);
+      output << ", \"parentFraction\": ";
+      writeJsonNumber(output, stats.timeParentFraction[i]);
+      output << ", \"imbalance\": ";
+      writeJsonNumber(output, getImbalance(i));
+      output << "}";
+
+      const int nNodesWithTimer = stats.nodesSum[i];
+      output << ",\n     \"nodeTime\": {\"nodes\": " << nNodesWithTimer << ", \"avg\": ";
+      writeJsonNumber(output, nNodesWithTimer > 0 ? stats.nodeTimeSum[i] / nNodesWithTimer : 0.0);
+      output << ", \"max\": ";
+      writeJsonValueRank(output, "leader", stats.nodeTimeMax[i], nNodesWithTimer > 0);
+      output << "}";
+
+      output << ",\n     \"count\": {\"sum\": " << stats.countSum[i] << ", \"avg\": ";
+      writeJsonNumber(output, nRanks > 0 ? double(stats.countSum[i]) / nRanks : 0.0);
+      output << "}, \"threads\": {\"sum\": " << stats.threadsSum[i] << ", \"avg\": ";
+      writeJsonNumber(output, getAverageThreads(i));
+      output << "}";
+
+      //exclusive time is not defined for "other"
+      output << ",\n     \"exclusiveTime\": ";
+      if(id != -1 && nRanks > 0) {
+         output << "{\"sum\": ";
+         writeJsonNumber(output, stats.exclusiveTimeSum[i]);
+         output << ", \"avg\": ";
+         writeJsonNumber(output, getExclusiveAverage(i));
+         output << ", \"max\": ";
+         writeJsonValueRank(output, "rank", stats.exclusiveTimeMax[i], true);
+         output << ", \"threadImbalanceAvg\": ";
+         writeJsonNumber(output, stats.exclusiveThreadImbalanceSum[i] / nRanks);
+         output << ", \"threadImbalanceMax\": ";
+         writeJsonValueRank(output, "rank", stats.exclusiveThreadImbalanceMax[i], true);
+         output << "}";
+      }
+      else {
+         output << "null";
+      }
+
+      const bool hasThreadImbalance = nRanks > 0 && stats.threadImbalanceMax[i].val >= 0.0;
+      output << ",\n     \"threadImbalance\": ";
+      if(hasThreadImbalance) {
+         output << "{\"avg\": ";
+         writeJsonNumber(output, stats.threadImbalanceSum[i] / nRanks);
+         output << ", \"max\": ";
+         writeJsonValueRank(output, "rank", stats.threadImbalanceMax[i], true);
+         output << ", \"min\": ";
+         writeJsonValueRank(output, "rank", stats.threadImbalanceMin[i], true);
+         output << "}";
+      }
+      else {
+         output << "null";
+      }
+
+      output << ", \"workUnits\": ";
+      if(stats.hasWorkUnits[i] && id != -1) {
+         output << "{\"sum\": ";
+         writeJsonNumber(output, stats.workUnitsSum[i]);
+         output << ", \"label\": ";
+         writeJsonString(output, dictionary[id].workUnitLabel);
+         output << ", \"ratePerProcess\": ";
+         writeJsonNumber(output, stats.timeSum[i] > 0.0 ? stats.workUnitsSum[i] / stats.timeSum[i] : 0.0);
+         output << "}";
+      }
+      else {
+         output << "null";
+      }
+      output << "}";
+   }
+   output << "\n  ]\n}\n";
+   output.precision(precision);
+   return true;
+}
+
+bool TimerReport::printCsv(double minFraction, const std::map<std::string, std::string> &groupIds, std::ostream &output) const{
+   const std::streamsize precision = output.precision(std::numeric_limits<double>::max_digits10);
+   output << "type,row,parent_row,id,parent_id,level,label,full_label,groups,ranks,"
+          << "time_sum,time_avg,time_max,time_max_rank,time_min,time_min_rank,time_p10,time_median,time_p90,total_fraction,parent_fraction,imbalance,"
+          << "nodes,node_time_avg,node_time_max,node_time_max_leader,count_sum,threads_sum,"
+          << "thread_imbalance_avg,thread_imbalance_max,thread_imbalance_max_rank,thread_imbalance_min,thread_imbalance_min_rank,"
+          << "workunits_sum,workunit_label,"
+          << "exclusive_time_sum,exclusive_time_avg,exclusive_time_max,exclusive_time_max_rank,"
+          << "exclusive_thread_imbalance_avg,exclusive_thread_imbalance_max,exclusive_thread_imbalance_max_rank\n";
+
+   //groups use the label column for the name and the groups column for the id
+   for(unsigned int i = 0; i < groupStats.name.size(); i++){
+      output << "group,,,,,,";
+      writeCsvString(output, groupStats.name[i]);
+      output << ",,";
+      writeCsvString(output, groupIds.count(groupStats.name[i]) ? groupIds.find(groupStats.name[i])->second : std::string());
+      output << "," << nProcesses << "," << groupStats.timeSum[i] << ","
+             << (nProcesses > 0 ? groupStats.timeSum[i] / nProcesses : 0.0) << ","
+             << groupStats.timeMax[i].val << "," << groupStats.timeMax[i].rank << ","
+             << groupStats.timeMin[i].val << "," << groupStats.timeMin[i].rank << ",,,,"
+             << groupStats.timeTotalFraction[i] << ",,,,,,,,,,,,,,,,,,,,,,\n";
+   }
+
+   for(unsigned int row = 0; row < order.size(); row++){
+      const int i = order[row];
+      const int id = stats.id[i];
+      const int nRanks = stats.ranksSum[i];
+      if(!isPrinted(i, minFraction))
+         continue;
+      const int parentId = id != -1 ? dictionary[id].parentIndex : stats.id[stats.parentIndex[i]];
+      output << (id != -1 ? "timer," : "other,") << i << "," << stats.parentIndex[i] << ",";
+      if(id != -1)
+         output << id;
+      output << ",";
+      if(parentId >= 0)
+         output << parentId;
+      output << "," << stats.level[i] << ",";
+      writeCsvString(output, id != -1 ? dictionary[id].label : "Other");
+      output << ",";
+      writeCsvString(output, getFullLabel(i));
+      std::string groups;
+      if(id != -1) {
+         for(unsigned int g = 0; g < dictionary[id].groups.size(); g++)
+            groups += (g > 0 ? ";" : "") + dictionary[id].groups[g];
+      }
+      output << ",";
+      writeCsvString(output, groups);
+      output << "," << nRanks << "," << stats.timeSum[i] << "," << getAverage(i) << ","
+             << stats.timeMax[i].val << "," << stats.timeMax[i].rank << ","
+             << stats.timeMin[i].val << "," << stats.timeMin[i].rank << ",";
+      //empty if there are no quantiles
+      if(hasQuantiles(i))
+         output << getQuantile(i, 0.1) << "," << getQuantile(i, 0.5) << "," << getQuantile(i, 0.9) << ",";
+      else
+         output << ",,,";
+      output << stats.timeTotalFraction[i] << "," << stats.timeParentFraction[i] << "," << getImbalance(i) << ","
+             << stats.nodesSum[i] << ","
+             << (stats.nodesSum[i] > 0 ? stats.nodeTimeSum[i] / stats.nodesSum[i] : 0.0) << ","
+             << stats.nodeTimeMax[i].val << "," << stats.nodeTimeMax[i].rank << ","
+             << stats.countSum[i] << "," << stats.threadsSum[i] << ",";
+      if(nRanks > 0 && stats.threadImbalanceMax[i].val >= 0.0)
+         output << stats.threadImbalanceSum[i] / nRanks << ","
+                << stats.threadImbalanceMax[i].val << "," << stats.threadImbalanceMax[i].rank << ","
+                << stats.threadImbalanceMin[i].val << "," << stats.threadImbalanceMin[i].rank << ",";
+      else
+         output << ",,,,,";
+      if(stats.hasWorkUnits[i] && id != -1) {
+         output << stats.workUnitsSum[i] << ",";
+         writeCsvString(output, dictionary[id].workUnitLabel);
+      }
+      else {
+         output << ",";
+      }
+      if(id != -1 && nRanks > 0)
+         output << "," << stats.exclusiveTimeSum[i] << "," << getExclusiveAverage(i) << ","
+                << stats.exclusiveTimeMax[i].val << "," << stats.exclusiveTimeMax[i].rank << ","
+                << stats.exclusiveThreadImbalanceSum[i] / nRanks << ","
+                << stats.exclusiveThreadImbalanceMax[i].val << "," << stats.exclusiveThreadImbalanceMax[i].rank;
+      else
+         output << ",,,,,,,";
+      output << "\n";
+   }
+   output.precision(precision);
+   return true;
+}
+
+
+//Folded stacks, one line per frame with the exclusive time in
+//microseconds. The exclusive time of a timer with children is its
+//"other" row, leaves are exclusive as such. The slowest variant has the
+//stacks of the process with most total time.
+bool TimerReport::printFlame(bool slowest, std::ostream &output) const{
+   const int nRows = stats.id.size();
+   if(slowest && (int)slowestTime.size() != nRows)
+      return false;
+   std::vector<std::string> stacks(nRows);
+   std::vector<bool> hasChildren(nRows, false);
+   for(int i = 1; i < nRows; i++)
+      hasChildren[stats.parentIndex[i]] = true;
+
+   //parents are always before their children in the statistics
+   for(int i = 0; i < nRows; i++){
+      const int id = stats.id[i];
+      if(id == -1) {
+         stacks[i] = stacks[stats.parentIndex[i]];
+      }
+      else {
+         //';' separates frames and whitespace the value
+         std::string label = dictionary[id].label;
+         for(char &c: label){
+            if(c == ';')
+               c = ':';
+            else if(c == '\n' || c == '\r')
+               c = ' ';
+         }
+         stacks[i] = i > 0 ? stacks[stats.parentIndex[i]] + ";" + label : label;
+      }
+      if(id != -1 && hasChildren[i])
+         continue;
+
+      //average over all processes keeps the frames of timers that only
+      //some processes have consistent with their parents, and so does
+      //taking all frames from the same process
+      const double time = slowest ? slowestTime[i] : stats.timeSum[i] / nProcesses;
+      const long long microseconds = static_cast<long long>(time * 1.0e6 + 0.5);
+      if(stats.ranksSum[i] > 0 && microseconds > 0)
+         output << stacks[i] << " " << microseconds << "\n";
+   }
+   return true;
+}
+
+
+//Dense float32 matrix in the NPY format with one row per process. The
+//first column is the rank, the others the inclusive time in the
+//timers of rankTimesRows. The full labels of the columns are in a
+//comment at the end of the header, which numpy ignores. Version 2.0 of
+//the format is used only if the header does not fit in 64 kB.
+bool TimerReport::printHeatmap(std::ostream &output) const{
+   const int nColumns = rankTimesRows.size() + 1;
+   const int nRows = rankTimes.size() / nColumns;
+   const uint16_t one = 1;
+   const bool littleEndian = *reinterpret_cast<const char*>(&one) == 1;
+
+   std::stringstream header;
+   header << "{'descr': '" << (littleEndian ? '<' : '>') << "f4', 'fortran_order': False, 'shape': ("
+          << nRows << ", " << nColumns << "), } # rank";
+   for(auto row: rankTimesRows){
+      std::string label = dictionary.getFullLabel(stats.id[row]);
+      std::replace(label.begin(), label.end(), '\n', ' ');
+      header << ", " << (label.size() > 0 ? label : "/");
+   }
+   //data starts at a multiple of 64 bytes, the header ends in a newline
+   std::string headerString = header.str();
+   const bool version1 = 10 + headerString.size() + 64 <= 65535;
+   const size_t prefix = version1 ? 10 : 12;
+   headerString.append(63 - (prefix + headerString.size()) % 64, ' ');
+   headerString += '\n';
+   if(headerString.size() > UINT32_MAX) {
+      std::cerr << "PHIPROF-ERROR: Header of the heatmap is too large for the NPY format" << std::endl;
+      return false;
+   }
+
+   //the length of the header is always little endian
+   const uint32_t headerLength = headerString.size();
+   output.write(version1 ? "\x93NUMPY\x01\x00" : "\x93NUMPY\x02\x00", 8);
+   for(size_t b = 0; b < prefix - 8; b++)
+      output.put((headerLength >> (8 * b)) & 0xff);
+   output.write(headerString.data(), headerString.size());
+   output.write(reinterpret_cast<const char*>(rankTimes.data()), nRows * nColumns * sizeof(float));
+   return output.good();
+}
+
+//Binary PPM image of rankTimes, ranks from top to bottom and timers from
+//left to right in decreasing order of total time. Each timer is scaled
+//by its own maximum, so that patterns are visible also in timers with
+//little time. Processes are averaged into at most maxImageRows rows.
+bool TimerReport::printHeatmapImage(std::ostream &output) const{
+   const int maxImageRows = 1024;
+   const int cellWidth = 16;
+   const int nColumns = rankTimesRows.size() + 1;
+   const int nRows = rankTimes.size() / nColumns;
+   const int nBins = std::min(nRows, maxImageRows);
+   const int binHeight = nBins > 0 ? std::max(1, 256 / nBins) : 1;
+   const int width = std::max(nColumns - 1, 1) * cellWidth;
+   const int height = std::max(nBins, 1) * binHeight;
+
+   std::vector<double> columnMax(nColumns, 0.0);
+   std::vector<double> binTime(nBins * nColumns, 0.0);
+   std::vector<int> binCount(nBins, 0);
+   for(int r = 0; r < nRows; r++){
+      const int bin = (int64_t)r * nBins / nRows;
+      binCount[bin]++;
+      for(int c = 1; c < nColumns; c++){
+         binTime[bin * nColumns + c] += rankTimes[r * nColumns + c];
+         columnMax[c] = std::max(columnMax[c], (double)rankTimes[r * nColumns + c]);
+      }
+   }
+
+   output << "P6\n" << width << " " << height << "\n255\n";
+   std::vector<unsigned char> line(3 * width, 0);
+   for(int bin = 0; bin < std::max(nBins, 1); bin++){
+      for(int c = 1; c < nColumns; c++){
+         double value = 0.0;
+         if(columnMax[c] > 0.0 && binCount[bin] > 0)
+            value = binTime[bin * nColumns + c] / binCount[bin] / columnMax[c];
+         //black through red and yellow to white
+         const unsigned char rgb[3] = {
+            (unsigned char)(255 * std::min(std::max(3.0 * value, 0.0), 1.0)),
+            (unsigned char)(255 * std::min(std::max(3.0 * value - 1.0, 0.0), 1.0)),
+            (unsigned char)(255 * std::min(std::max(3.0 * value - 2.0, 0.0), 1.0))};
+         for(int x = (c - 1) * cellWidth; x < c * cellWidth; x++){
+            line[3 * x] = rgb[0];
+            line[3 * x + 1] = rgb[1];
+            line[3 * x + 2] = rgb[2];
+         }
+      }
+      for(int y = 0; y < binHeight; y++)
+         output.write(reinterpret_cast<const char*>(line.data()), line.size());
+   }
+   return output.good();
+}
+
+
+//Summary of the clusters, followed by the average time of each timer
+//in each cluster. Clusters are printed in decreasing order of size.
+bool TimerReport::printClusters(double minFraction, std::ostream &output) const{
+   const int nClusters = clusterStats.size.size();
+   const int nRows = stats.id.size();
+   if(nClusters == 0)
+      return false;
+   std::vector<int> clusters;
+   for(int k = 0; k < nClusters; k++){
+      if(clusterStats.size[k] > 0)
+         clusters.push_back(k);
+   }
+   std::stable_sort(clusters.begin(), clusters.end(),
+                    [this](int a, int b){ return clusterStats.size[a] > clusterStats.size[b]; });
+
+   std::stringstream buffer;
+   PrettyPrintTable summary;
+   buffer << "Processes clustered by their time in the " << rankTimesRows.size() << " timers with most time.";
+   summary.addTitle(buffer.str());
+   summary.addHorizontalLine();
+   summary.addElement("Cluster",1);
+   summary.addElement("Processes",1);
+   summary.addElement("%",1);
+   summary.addElement("Representative rank",1);
+   summary.addElement("Total avg (s)",1);
+   summary.addHorizontalLine();
+   for(unsigned int c = 0; c < clusters.size(); c++){
+      const int k = clusters[c];
+      summary.addElement(c + 1);
+      summary.addElement(clusterStats.size[k]);
+      summary.addElement(nProcesses > 0 ? 100.0 * clusterStats.size[k] / nProcesses : 0.0);
+      summary.addElement(clusterStats.representative[k]);
+      summary.addElement(clusterStats.timeSum[k * nRows] / clusterStats.size[k]);
+      summary.addRow();
+   }
+   summary.addHorizontalLine();
+   summary.print(output);
+
+   PrettyPrintTable table;
+   buffer.str("");
+   if(minFraction > 0.0)
+      buffer << "Average time (s) in each cluster of timers with more than " << minFraction * 100 << "% of total time.";
+   else
+      buffer << "Average time (s) in each cluster of all timers.";
+   table.addTitle(buffer.str());
+   table.addHorizontalLine();
+   table.addElement("", 3);
+   table.addElement("Cluster", clusters.size());
+   table.addHorizontalLine();
+   table.addElement("Id",1);
+   table.addElement("Lvl",1);
+   table.addElement("Name",1);
+   for(unsigned int c = 0; c < clusters.size(); c++)
+      table.addElement(c + 1);
+   table.addHorizontalLine();
+   for(unsigned int row = 1; row < order.size(); row++){
+      const int i = order[row];
+      const int id = stats.id[i];
+      if(!isPrinted(i, minFraction))
+         continue;
+      if(id != -1)
+         table.addElement(id);
+      else
+         table.addElement("");
+      table.addElement(stats.level[i]);
+      table.addElement(id != -1 ? dictionary[id].label : "Other", 1, stats.level[i]-1);
+      for(auto k: clusters){
+         const int nRanks = clusterStats.ranksSum[k * nRows + i];
+         if(nRanks > 0)
+            table.addElement(clusterStats.timeSum[k * nRows + i] / nRanks);
+         else
+            table.addElement("");
+      }
+      table.addRow();
+   }
+   table.addHorizontalLine();
+   table.print(output);
+   return true;
+}
+
+
+//Time lost to imbalance. First the cost and efficiency of each timer
+//in the tree, then the timers ranked by cost, and last the path
+//through the hierarchy that always follows the child with the slowest
+//process, with the rank of that process at each level.
+bool TimerReport::printImbalance(double minFraction, std::ostream &output) const{
+   const int maxRanked = getImbalanceTimers();
+   const int nRows = stats.id.size();
+   //sum over processes of the total time
+   const double coreTime = nRows > 0 ? stats.timeSum[0] : 0.0;
+   std::stringstream buffer;
+
+   PrettyPrintTable table;
+   table.addTitle(getTableTitle(minFraction));
+   table.addHorizontalLine();
+   table.addElement("", mergeTrees ? 4 : 3);
+   table.addElement("Time (s)", 3);
+   table.addElement("Imbalance", 3);
+   table.addHorizontalLine();
+   table.addElement("Id",1);
+   table.addElement("Lvl",1);
+   table.addElement("Name",1);
+   if(mergeTrees)
+      table.addElement("Ranks",1);
+   table.addElement("Avg",1);
+   table.addElement("Max time,rank",2);
+   table.addElement("Cost (core-s)",1);
+   table.addElement("% of core-time",1);
+   table.addElement("Efficiency %",1);
+   table.addHorizontalLine();
+   for(unsigned int row = 1; row < order.size(); row++){
+      const int i = order[row];
+      const int id = stats.id[i];
+      if(!isPrinted(i, minFraction))
+         continue;
+      if(id != -1)
+         table.addElement(id);
+      else
+         table.addElement("");
+      table.addElement(stats.level[i]);
+      table.addElement(id != -1 ? dictionary[id].label : "Other", 1, stats.level[i]-1);
+      if(mergeTrees)
+         table.addElement(stats.ranksSum[i]);
+      table.addElement(getAverage(i));
+      table.addElement(stats.timeMax[i].val);
+      table.addElement(stats.timeMax[i].rank);
+      table.addElement(getImbalanceCost(i));
+      table.addElement(coreTime > 0.0 ? 100.0 * getImbalanceCost(i) / coreTime : 0.0);
+      table.addElement(100.0 * getParallelEfficiency(i));
+      table.addRow();
+   }
+   table.addHorizontalLine();
+   table.print(output);
+
+   //costs are inclusive, a parent includes the imbalance of its children
+   std::vector<int> ranked;
+   for(int i = 1; i < nRows; i++){
+      if(stats.ranksSum[i] > 0 && getImbalanceCost(i) > 0.0 && isPrinted(i, minFraction))
+         ranked.push_back(i);
+   }
+   std::stable_sort(ranked.begin(), ranked.end(),
+                    [this](int a, int b){ return getImbalanceCost(a) > getImbalanceCost(b); });
+   if((int)ranked.size() > maxRanked)
+      ranked.resize(maxRanked);
+
+   PrettyPrintTable ranking;
+   buffer << "Timers with most core-time lost to imbalance (inclusive), out of " << coreTime << " core-s in total.";
+   ranking.addTitle(buffer.str());
+   ranking.addHorizontalLine();
+   ranking.addElement("#",1);
+   ranking.addElement("Timer",1);
+   ranking.addElement("Cost (core-s)",1);
+   ranking.addElement("% of core-time",1);
+   ranking.addElement("Efficiency %",1);
+   ranking.addElement("Slowest rank",1);
+   ranking.addHorizontalLine();
+   for(unsigned int r = 0; r < ranked.size(); r++){
+      const int i = ranked[r];
+      ranking.addElement(r + 1);
+      ranking.addElement(getFullLabel(i));
+      ranking.addElement(getImbalanceCost(i));
+      ranking.addElement(coreTime > 0.0 ? 100.0 * getImbalanceCost(i) / coreTime : 0.0);
+      ranking.addElement(100.0 * getParallelEfficiency(i));
+      ranking.addElement(stats.timeMax[i].rank);
+      ranking.addRow();
+   }
+   ranking.addHorizontalLine();
+   ranking.print(output);
+
+   //critical path, the slowest child at each level
+   PrettyPrintTable path;
+   path.addTitle("Chain of slowest processes through the timer hierarchy.");
+   path.addHorizontalLine();
+   path.addElement("Lvl",1);
+   path.addElement("Name",1);
+   path.addElement("Max time,rank",2);
+   path.addElement("Avg (s)",1);
+   path.addElement("Cost (core-s)",1);
+   path.addHorizontalLine();
+   int current = 0;
+   while(current >= 0 && nRows > 0) {
+      path.addElement(stats.level[current]);
+      path.addElement(stats.id[current] != -1 ? dictionary[stats.id[current]].label : "Other",
+                      1, stats.level[current]);
+      path.addElement(stats.timeMax[current].val);
+      path.addElement(stats.timeMax[current].rank);
+      path.addElement(getAverage(current));
+      path.addElement(getImbalanceCost(current));
+      path.addRow();
+      int slowest = -1;
+      for(int i = current + 1; i < nRows; i++){
+         if(stats.parentIndex[i] == current && stats.ranksSum[i] > 0 &&
+            (slowest < 0 || stats.timeMax[i].val > stats.timeMax[slowest].val))
+            slowest = i;
+      }
+      current = slowest;
+   }
+   path.addHorizontalLine();
+   path.print(output);
+   return true;
+}
+
+
+//Timers ranked by exclusive (self) time, the time not spent in their
+//children. Unlike inclusive time, this points at the timers where the
+//time is actually spent, also in deep trees.
+bool TimerReport::printSelf(double minFraction, std::ostream &output) const{
+   const int maxRanked = getSelfTimers();
+   const int nRows = stats.id.size();
+   std::stringstream buffer;
+
+   std::vector<int> ranked;
+   for(int i = 1; i < nRows; i++){
+      if(stats.id[i] != -1 && stats.ranksSum[i] > 0 && isPrinted(i, minFraction))
+         ranked.push_back(i);
+   }
+   std::stable_sort(ranked.begin(), ranked.end(),
+                    [this](int a, int b){ return stats.exclusiveTimeSum[a] > stats.exclusiveTimeSum[b]; });
+   if((int)ranked.size() > maxRanked)
+      ranked.resize(maxRanked);
+
+   PrettyPrintTable table;
+   buffer << "Timers with most exclusive time. " << getTableTitle(minFraction);
+   table.addTitle(buffer.str());
+   table.addHorizontalLine();
+   table.addElement("", mergeTrees ? 3 : 2);
+   table.addElement("Exclusive time (s)", 4);
+   table.addElement("Inclusive",1);
+   table.addElement("Thread imbalances",2);
+   table.addHorizontalLine();
+   table.addElement("#",1);
+   table.addElement("Timer",1);
+   if(mergeTrees)
+      table.addElement("Ranks",1);
+   table.addElement("Avg",1);
+   table.addElement("% of total",1);
+   table.addElement("Max time,rank",2);
+   table.addElement("Avg (s)",1);
+   table.addElement("Avg %",1);
+   table.addElement("Max %",1);
+   table.addHorizontalLine();
+   for(unsigned int r = 0; r < ranked.size(); r++){
+      const int i = ranked[r];
+      const int nRanks = stats.ranksSum[i];
+      table.addElement(r + 1);
+      table.addElement(getFullLabel(i));
+      if(mergeTrees)
+         table.addElement(nRanks);
+      table.addElement(getExclusiveAverage(i));
+      table.addElement(stats.timeSum[0] > 0.0 ? 100.0 * stats.exclusiveTimeSum[i] / stats.timeSum[0] : 0.0);
+      table.addElement(stats.exclusiveTimeMax[i].val);
+      table.addElement(stats.exclusiveTimeMax[i].rank);
+      table.addElement(getAverage(i));
+      if(getAverageThreads(i) > 1.0) {
+         table.addElement(100.0 * stats.exclusiveThreadImbalanceSum[i] / nRanks);
+         table.addElement(100.0 * stats.exclusiveThreadImbalanceMax[i].val);
+      }
+      else {
+         table.addElement("");
+         table.addElement("");
+      }
+      table.addRow();
+   }
+   table.addHorizontalLine();
+   table.print(output);
+   return true;
+}
+
+
+//Flat profile, the timers aggregated by label over all their call
+//paths, ranked by exclusive time. Each label is followed by its
+//callers when it is called from more than one. Computed in one pass
+//over the statistics, so it is also available offline.
+bool TimerReport::printFlat(double minFraction, const std::map<std::string, std::string> &groupIds,
+                            std::ostream &output) const{
+   struct FlatTimer {
+      std::string groups; //group ids of all call paths
+      std::string workUnitLabel;
+      bool hasWorkUnits = true; //same workunits in all call paths
+      int paths = 0;
+      double timeSum = 0.0; //inclusive, not counting recursive calls twice
+      double exclusiveTimeSum = 0.0;
+      double workUnitsSum = 0.0;
+      int64_t countSum = 0;
+      std::map<std::string, double> callerTimeSum; //inclusive time per caller label
+   };
+   struct FlatGroup {
+      double timeSum = 0.0;
+      double exclusiveTimeSum = 0.0;
+   };
+   std::map<std::string, FlatTimer> timers;
+   std::map<std::string, FlatGroup> groups;
+   const int nRows = stats.id.size();
+
+   for(int i = 1; i < nRows; i++){
+      const int id = stats.id[i];
+      if(id == -1 || stats.ranksSum[i] == 0)
+         continue;
+      const std::string &label = dictionary[id].label;
+      FlatTimer &timer = timers[label];
+      const bool first = timer.paths == 0;
+      timer.paths++;
+      timer.exclusiveTimeSum += stats.exclusiveTimeSum[i];
+      timer.countSum += stats.countSum[i];
+      for(auto &group: dictionary[id].groups){
+         const std::string groupId = groupIds.count(group) ? groupIds.find(group)->second : std::string();
+         if(timer.groups.find(groupId) == std::string::npos)
+            timer.groups += groupId;
+         //inclusive time of the groups is in groupStats
+         groups[group].exclusiveTimeSum += stats.exclusiveTimeSum[i];
+      }
+      if(first)
+         timer.workUnitLabel = dictionary[id].workUnitLabel;
+      if(stats.hasWorkUnits[i] && dictionary[id].workUnitLabel == timer.workUnitLabel)
+         timer.workUnitsSum += stats.workUnitsSum[i];
+      else
+         timer.hasWorkUnits = false;
+
+      //inclusive time of recursive calls is already in the outermost
+      //call, and attributed to its caller
+      bool recursive = false;
+      for(int parent = stats.parentIndex[i]; parent > 0 && !recursive; parent = stats.parentIndex[parent])
+         recursive = stats.id[parent] != -1 && dictionary[stats.id[parent]].label == label;
+      if(!recursive) {
+         timer.timeSum += stats.timeSum[i];
+         //parents of timers are always timers
+         timer.callerTimeSum[dictionary[stats.id[stats.parentIndex[i]]].label] += stats.timeSum[i];
+      }
+   }
+   for(unsigned int g = 0; g < groupStats.name.size(); g++){
+      if(groups.count(groupStats.name[g]))
+         groups[groupStats.name[g]].timeSum = groupStats.timeSum[g];
+   }
+
+   std::vector<const std::pair<const std::string, FlatTimer>*> ranked;
+   for(auto &timer: timers)
+      ranked.push_back(&timer);
+   std::stable_sort(ranked.begin(), ranked.end(), [](auto a, auto b){
+         return a->second.exclusiveTimeSum > b->second.exclusiveTimeSum;
+      });
+
+   const double totalTime = nRows > 0 ? stats.timeSum[0] : 0.0;
+   std::stringstream buffer;
+   PrettyPrintTable table;
+   buffer << "Flat profile, timers with the same label summed over all call paths. ";
+   if(minFraction > 0.0)
+      buffer << "Timers with more than " << minFraction * 100 << "% of total time. ";
+   buffer << "Averages are over " << nProcesses << " processes.";
+   table.addTitle(buffer.str());
+   table.addHorizontalLine();
+   table.addElement("", 3);
+   table.addElement("Count", 1);
+   table.addElement("Inclusive time", 2);
+   table.addElement("Exclusive time", 2);
+   table.addElement("Workunits", 1);
+   table.addHorizontalLine();
+   table.addElement("Grp", 1);
+   table.addElement("Name", 1);
+   table.addElement("Paths", 1);
+   table.addElement("Avg", 1);
+   table.addElement("Avg (s)", 1);
+   table.addElement("% of total", 1);
+   table.addElement("Avg (s)", 1);
+   table.addElement("% of total", 1);
+   table.addElement("Avg", 1);
+   table.addHorizontalLine();
+   for(auto entry: ranked){
+      const FlatTimer &timer = entry->second;
+      if(totalTime <= 0.0 || timer.timeSum / totalTime < minFraction)
+         continue;
+      table.addElement(timer.groups);
+      table.addElement(entry->first);
+      table.addElement(timer.paths);
+      table.addElement(nProcesses > 0 ? double(timer.countSum) / nProcesses : 0.0);
+      table.addElement(nProcesses > 0 ? timer.timeSum / nProcesses : 0.0);
+      table.addElement(100.0 * timer.timeSum / totalTime);
+      table.addElement(nProcesses > 0 ? timer.exclusiveTimeSum / nProcesses : 0.0);
+      table.addElement(100.0 * timer.exclusiveTimeSum / totalTime);
+      if(timer.hasWorkUnits && timer.timeSum > 0.0){
+         buffer.str("");
+         buffer << std::setprecision(4) << timer.workUnitsSum / timer.timeSum << " " << timer.workUnitLabel << "/s";
+         table.addElement(buffer.str());
+      }
+      table.addRow();
+
+      //callers in decreasing order of time
+      if(timer.callerTimeSum.size() > 1){
+         std::vector<std::pair<double, std::string>> callers;
+         for(auto &caller: timer.callerTimeSum)
+            callers.push_back({caller.second, caller.first});
+         std::stable_sort(callers.begin(), callers.end(), [](auto &a, auto &b){ return a.first > b.first; });
+         for(auto &caller: callers){
+            table.addElement("");
+            table.addElement("called from " + caller.second, 1, 1);
+            table.addElement("");
+            table.addElement("");
+            table.addElement(nProcesses > 0 ? caller.first / nProcesses : 0.0);
+            table.addElement(100.0 * caller.first / totalTime);
+            table.addRow();
+         }
+      }
+   }
+   table.addHorizontalLine();
+   table.print(output);
+
+   PrettyPrintTable groupTable;
+   groupTable.addTitle("Groups, with the exclusive time of all their timers.");
+   groupTable.addHorizontalLine();
+   groupTable.addElement("", 2);
+   groupTable.addElement("Inclusive time", 2);
+   groupTable.addElement("Exclusive time", 2);
+   groupTable.addHorizontalLine();
+   groupTable.addElement("Grp", 1);
+   groupTable.addElement("Name", 1);
+   groupTable.addElement("Avg (s)", 1);
+   groupTable.addElement("% of total", 1);
+   groupTable.addElement("Avg (s)", 1);
+   groupTable.addElement("% of total", 1);
+   groupTable.addHorizontalLine();
+   for(auto &group: groups){
+      groupTable.addElement(groupIds.count(group.first) ? groupIds.find(group.first)->second : std::string());
+      groupTable.addElement(group.first);
+      groupTable.addElement(nProcesses > 0 ? group.second.timeSum / nProcesses : 0.0);
+      groupTable.addElement(totalTime > 0.0 ? 100.0 * group.second.timeSum / totalTime : 0.0);
+      groupTable.addElement(nProcesses > 0 ? group.second.exclusiveTimeSum / nProcesses : 0.0);
+      groupTable.addElement(totalTime > 0.0 ? 100.0 * group.second.exclusiveTimeSum / totalTime : 0.0);
+      groupTable.addRow();
+   }
+   groupTable.addHorizontalLine();
+   groupTable.print(output);
+   return true;
+}
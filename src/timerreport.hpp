@@ -0,0 +1,320 @@
+/*
+This file is part of the phiprof library
+
+Copyright 2015, 2016 CSC - IT Center for Science
+
+Phiprof is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3 of the
+License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef TIMERREPORT_H
+#define TIMERREPORT_H
+#include <vector>
+#include <string>
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include "timerdictionary.hpp"
+#include "timerdump.hpp"
+#include "quantilesketch.hpp"
+
+/*
+  Statistics of timers and groups over a set of processes, and the
+  tables printed from them. The statistics are filled in by
+  ParallelTimerTree with MPI reductions, or offline from a dump. Does
+  not use MPI.
+*/
+class TimerReport {
+public:
+   //used with MPI reduction operator (MPI_DOUBLE_INT)
+   struct doubleRankPair {
+      double val;
+      int rank;
+   };
+
+   struct TimerStatistics {
+      std::vector<int> id; //dictionary index of the timer at this index in the statistics vectors, -1 for "other" 
+      std::vector<int> level;
+      std::vector<int> parentIndex; //index of the parent in the statistics vectors
+      std::vector<int> ranksSum; //number of processes that have the timer
+      std::vector<double> timeSum;
+      std::vector<doubleRankPair> timeMax;
+      std::vector<doubleRankPair> timeMin;
+      std::vector<QuantileSketch> timeSketch; //distribution of time over processes
+      std::vector<int> nodesSum; //number of nodes that have the timer
+      std::vector<double> nodeTimeSum; //sum over nodes of the average time in node
+      std::vector<doubleRankPair> nodeTimeMax; //slowest node, identified by the rank of its leader
+      std::vector<double> timeTotalFraction;
+      std::vector<double> timeParentFraction;
+      std::vector<bool> pruned; //not printed in the tables, see computeFractions
+      std::vector<bool> hasWorkUnits;
+      std::vector<double> workUnitsSum;
+      std::vector<int64_t> countSum;
+      
+      std::vector<int> threadsSum;
+      std::vector<double> threadImbalanceSum;
+      std::vector<doubleRankPair> threadImbalanceMax;
+      std::vector<doubleRankPair> threadImbalanceMin;
+
+      //exclusive (self) time, not including the children. Not defined
+      //for "other", the max is -1 there
+      std::vector<double> exclusiveTimeSum;
+      std::vector<doubleRankPair> exclusiveTimeMax;
+      std::vector<double> exclusiveThreadImbalanceSum;
+      std::vector<doubleRankPair> exclusiveThreadImbalanceMax;
+   };
+      
+   //processes clustered by their time in the timers of rankTimesRows
+   struct ClusterStatistics {
+      std::vector<int> size; //processes in each cluster
+      std::vector<int> representative; //rank closest to the centroid of each cluster
+      std::vector<double> timeSum; //per cluster, the sum of time over its processes for each row of stats
+      std::vector<int> ranksSum; //per cluster, the processes that have the timer for each row of stats
+   };
+
+   struct GroupStatistics {
+      std::vector<std::string> name; 
+      std::vector<double> timeSum;
+      std::vector<doubleRankPair> timeMax;
+      std::vector<doubleRankPair> timeMin;
+      std::vector<double> timeTotalFraction;
+   };
+
+   TimerReport();
+
+   /**
+    * Compute fractions of total and parent time once the sums are
+    * filled in. Also resets the print order of the timers, and prunes
+    * the timers of instrumented functions (group Functions) where the
+    * slowest process spent less than getFunctionsMinTime(), together
+    * with their subtrees.
+    */
+   void computeFractions();
+
+   /**
+    * Compute the statistics from a dump instead of with MPI reductions.
+    *
+    * @param selectedRanks
+    *   Ranks of the dump that are included in the statistics
+    * @param subtreeIndex
+    *   (optional) Only the subtree starting at this dictionary index is
+    *   included, in addition to the root
+    */
+   void collect(const TimerDump &dump, const std::vector<bool> &selectedRanks, int subtreeIndex=0);
+
+   /**
+    * Select the timers with most time as the columns of rankTimes. Other
+    * rows are never selected.
+    *
+    * @param maxColumns
+    *   Maximum number of timers
+    */
+   void selectRankTimesRows(int maxColumns);
+
+   /**
+    * Fill in rankTimes from a dump, for the ranks that were collected.
+    * Called after collect().
+    */
+   void collectRankTimes(const TimerDump &dump, const std::vector<bool> &selectedRanks);
+
+   /**
+    * Fill in slowestTime from the records of the slowest process in a
+    * dump. Called after collect().
+    */
+   void collectSlowestTimes(const TimerDump &dump);
+
+   /**
+    * Cluster the ranks of a dump by their time in the timers with most
+    * time into clusterStats, as phiprof::print does. Called after
+    * collect().
+    */
+   void collectClusters(const TimerDump &dump, const std::vector<bool> &selectedRanks);
+
+   /**
+    * @return
+    *   Number of timers in the heatmaps, from PHIPROF_HEATMAP_TIMERS
+    *   (default 32)
+    */
+   static int getHeatmapTimers();
+
+   /**
+    * @return
+    *   Number of clusters in the clusters print, from PHIPROF_CLUSTERS
+    *   (default 3)
+    */
+   static int getClusters();
+
+   /**
+    * @return
+    *   Minimum time of the timers of instrumented functions in the
+    *   tables, from PHIPROF_FUNCTIONS_MIN_TIME (default 0.001 s)
+    */
+   static double getFunctionsMinTime();
+
+   /**
+    * @return
+    *   Number of timers in the list of timers with most exclusive
+    *   time, from PHIPROF_SELF_TIMERS (default 20)
+    */
+   static int getSelfTimers();
+
+   /**
+    * @return
+    *   Number of timers in the list of timers with most time lost to
+    *   imbalance, from PHIPROF_IMBALANCE_TIMERS (default 20)
+    */
+   static int getImbalanceTimers();
+
+   /**
+    * Sort the children of each timer in decreasing order.
+    *
+    * @param key
+    *   One of id (original order), time, max, imbalance, count or self
+    * @return
+    *   Returns false if the key is not known
+    */
+   bool sortTimers(const std::string &key);
+
+   /**
+    * Print one table
+    *
+    * @param style
+    *   One of groups, compact, full, detailed, json, csv, flame,
+    *   flame-max, heatmap, heatmap-image, clusters, imbalance, self or
+    *   flat (as in PHIPROF_PRINTS). The heatmaps need rankTimes, clusters
+    *   clusterStats and flame-max slowestTime.
+    * @param minFraction
+    *   Only timers with at least this fraction of total time are
+    *   printed. If negative, the default of the style is used.
+    * @return
+    *   Returns false if the style is not known
+    */
+   bool print(const std::string &style, std::ostream &output, double minFraction=-1.0) const;
+
+   static bool isPrintStyle(const std::string &style);
+
+   /**
+    * @return
+    *   Extension of the file a style is printed into: txt for the
+    *   tables, json or csv for the machine-readable styles, folded
+    *   or max.folded for the flamegraph stacks and npy or ppm for the
+    *   heatmaps
+    */
+   static std::string getFileExtension(const std::string &style);
+
+   /**
+    * @return
+    *   Average time over the processes that have the timer at index i
+    */
+   double getAverage(int i) const;
+
+   /**
+    * @return
+    *   Average exclusive time over the processes that have the timer
+    *   at index i, 0 for "other"
+    */
+   double getExclusiveAverage(int i) const;
+
+   /**
+    * @return
+    *   Average number of threads over the processes that have the
+    *   timer at index i, 0 if no process has it
+    */
+   double getAverageThreads(int i) const;
+
+   /**
+    * @return
+    *   Imbalance of the time at index i between processes, 0 when
+    *   balanced and 1 when all time is spent on one process
+    */
+   double getImbalance(int i) const;
+
+   /**
+    * @return
+    *   Time lost to imbalance in the timer at index i in core-seconds,
+    *   (max - avg) times the number of processes that have the timer
+    */
+   double getImbalanceCost(int i) const;
+
+   /**
+    * @return
+    *   Parallel efficiency of the timer at index i, avg / max
+    */
+   double getParallelEfficiency(int i) const;
+
+   /**
+    * @param q
+    *   Quantile between 0 and 1
+    * @return
+    *   Estimate of the quantile q of the time at index i over the
+    *   processes that have the timer
+    */
+   double getQuantile(int i, double q) const;
+
+   /**
+    * @return
+    *   True if there is a distribution of time at index i, false if
+    *   no process has the timer or the quantiles were left out
+    */
+   bool hasQuantiles(int i) const;
+
+   TimerStatistics stats;
+   GroupStatistics groupStats;
+   ClusterStatistics clusterStats;
+   TimerDictionary dictionary; //timers in the report
+   int nProcesses;  //processes in the report
+   int nNodes;
+   int maxThreads;  //0 if not threaded
+   bool mergeTrees; //report is the union of differing trees
+   std::vector<int> rankTimesRows; //rows of stats in the columns of rankTimes
+   std::vector<float> rankTimes; //one row per process: its rank, then its time in each of rankTimesRows
+   std::vector<double> slowestTime; //time of the slowest process (rank of stats.timeMax[0]) for each row of stats
+
+private:
+   void getGroupIds(std::map<std::string, std::string> &groupIds) const;
+   std::string getTableTitle(double minFraction) const;
+   bool printTimers(double minFraction, 
+                    const std::map<std::string, std::string> &groupIds,                  
+                    std::ostream &output) const;
+   bool printTimersDetailed(double minFraction, 
+                            const std::map<std::string, std::string> &groupIds,                  
+                            std::ostream &output) const;
+   bool printGroupStatistics(double minFraction,
+                             const std::map<std::string, std::string> &groupIds,
+                             std::ostream &output) const;
+   bool printJson(double minFraction,
+                  const std::map<std::string, std::string> &groupIds,
+                  std::ostream &output) const;
+   bool printCsv(double minFraction,
+                 const std::map<std::string, std::string> &groupIds,
+                 std::ostream &output) const;
+   bool printFlame(bool slowest, std::ostream &output) const;
+   bool printHeatmap(std::ostream &output) const;
+   bool printClusters(double minFraction, std::ostream &output) const;
+   bool printImbalance(double minFraction, std::ostream &output) const;
+   bool printSelf(double minFraction, std::ostream &output) const;
+   bool printFlat(double minFraction,
+                  const std::map<std::string, std::string> &groupIds,
+                  std::ostream &output) const;
+   bool printHeatmapImage(std::ostream &output) const;
+   void getRankTimes(const TimerDump &dump, int rank, std::vector<double> &time, std::vector<int> &ranks) const;
+   std::string getFullLabel(int i) const;
+   bool isPrinted(int i, double minFraction) const{
+      return !stats.pruned[i] && stats.timeTotalFraction[i] >= minFraction;
+   }
+
+   std::vector<unsigned int> order; //rows of stats in print order
+};
+
+#endif
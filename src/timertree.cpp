@@ -19,7 +19,6 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <vector>
-#include <unordered_map> //for hasher
 #include <string>
 #include <limits>
 #include <algorithm>
@@ -36,7 +35,6 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 int TimerTree::numThreads = 1;
 int TimerTree::thread = 0;
 bool TimerTree::initialized = false;
-const int maxTimers = 10000;
 
 /*
   initialize timertree. 
@@ -58,9 +56,8 @@ bool TimerTree::initialize(){
       {
          timers.clear();
          //mainId will be 0, parent is -1 (does not exist)
-         timers.push_back(TimerData(NULL, 0, "total", group,""));
+         timers.emplace_back((TimerData*)NULL, 0, "total", group, "");
          timers[0].start();
-         timers.reserve(maxTimers); //up to maxtimers we are guaranteed not to
       }
       setCurrentId(0);
       initialized=true;
@@ -98,7 +95,14 @@ int TimerTree::initializeTimer(const std::string &label, const std::vector<std::
       if(id < 0) {
          //does not exist, let's create it
          id = timers.size(); //id for new timer
-         timers.push_back(TimerData(&(timers[currentId[thread]]), id, label, groups, workUnit));
+         //existing timers do not move, other threads can use them meanwhile
+         timers.emplace_back(&(timers[currentId[thread]]), id, label, groups, workUnit);
+         updateAncestorHashes(id, 0);
+         if(sharedCounters != NULL) {
+            sharedCounters->addTimer(id, timers[id].getParentId(), timers[id].getLevel(), label,
+                                     groups, workUnit);
+            timers[id].setSharedCounters(sharedCounters);
+         }
          
 #ifdef DEBUG_PHIPROF_TIMERS         
          if(timers[id].getLevel() > 10) {
@@ -140,7 +144,7 @@ bool TimerTree::stop (int id,
 #endif
 
 
-   int newId = timers[id].stop(workUnits);
+   int newId = addToParent(id, timers[id].stop(workUnits));
    setCurrentId(newId);   
    return true;
 }
@@ -163,7 +167,9 @@ bool TimerTree::stop (int id,
    roctxRangePop();
 #endif
 
-   int newId = timers[id].stop(workUnits, workUnitLabel);
+   if(timers[id].isNewWorkUnitLabel(workUnitLabel))
+      setWorkUnitLabel(id, workUnitLabel);
+   int newId = addToParent(id, timers[id].stop(workUnits));
    setCurrentId(newId);
    return true;
 }
@@ -187,7 +193,8 @@ bool TimerTree::stop ([[maybe_unused]] const std::string &label)
    roctxRangePop();
 #endif
 
-   setCurrentId(timers[currentId[thread]].stop());
+   const int id = currentId[thread];
+   setCurrentId(addToParent(id, timers[id].stop()));
    return true;
 }
 
@@ -212,66 +219,114 @@ bool TimerTree::stop ([[maybe_unused]] const std::string &label,
    roctxRangePop();
 #endif
 
-   setCurrentId(timers[currentId[thread]].stop(workUnits, workUnitLabel));
+   const int id = currentId[thread];
+   if(timers[id].isNewWorkUnitLabel(workUnitLabel))
+      setWorkUnitLabel(id, workUnitLabel);
+   setCurrentId(addToParent(id, timers[id].stop(workUnits)));
    return true;
 }
       
 //get id number of a timer, return -1 if it does not exist
 int TimerTree::getChildId(const std::string &label) const{
-   //find child with this id
-   for(auto &childId : timers[currentId[thread]].getChildIds() ){  
-      if (timers[childId].getLabel() == label){
-         return childId;
-      } 
-   } 
-   //nothing found
-   return -1;
+   return timers[currentId[thread]].getChildId(label);
 }
 
 double TimerTree::getTime(int id) const{
    return timers[id].getAverageTime();
 }
 
+//Statistics over threads of the exclusive (self) time of a timer, the
+//time not spent in its children. Only the threads that have the timer
+//are included, time of children on other threads is ignored.
+void TimerTree::getExclusiveTimeStatistics(int id, double &ave, double &max, double &min, int &nThreads) const{
+   std::vector<double> activeChildTime(numThreads, 0.0);
+   std::vector<double> exclusiveTime;
+   for(auto &childId : timers[id].getChildIds())
+      timers[childId].addActiveTime(activeChildTime);
+   timers[id].getExclusiveTimes(activeChildTime, exclusiveTime);
+
+   max = 0;
+   min = std::numeric_limits<double>::max();
+   double sum = 0;
+   nThreads = 0;
+   for(auto threadTime : exclusiveTime){
+      if(threadTime >= 0.0) {
+         nThreads++;
+         max = std::max(threadTime, max);
+         min = std::min(threadTime, min);
+         sum += threadTime;
+      }
+   }
+   ave = nThreads > 0 ? sum / nThreads : 0.0;
+}
+
+//same definition as TimerData::getTimeImbalance
+double TimerTree::getExclusiveTimeImbalance(int id) const{
+   double max, min, ave;
+   int nThreads;
+   getExclusiveTimeStatistics(id, ave, max, min, nThreads);
+   if(nThreads > 1 && max > 0.0)
+      return (max - ave) / max * nThreads / (nThreads - 1);
+   return 1.0;
+}
+
 
 
 double TimerTree::getGroupTime(std::string group, int id) const{
+   const uint64_t groupBit = TimerData::getGroupBit(group);
+   //no timer is in a group that has never been used
+   if(groupBit == 0)
+      return 0.0;
+   return getGroupTime(group, groupBit, id);
+}
+
+double TimerTree::getGroupTime(const std::string &group, uint64_t groupBit, int id) const{
    double groupTime=0.0;
-   for(auto &timerGroup : timers[id].getGroups()){
-      if(group == timerGroup){
-         groupTime = timers[id].getAverageTime();
-         return groupTime; // do not collect for children when this is already in group.Avoid double counting
-      }
+   if(timers[id].isInGroup(group, groupBit)){
+      groupTime = timers[id].getAverageTime();
+      return groupTime; // do not collect for children when this is already in group.Avoid double counting
    }
    //recursively collect time data if possibly some children are in
    //group 
    for(auto &childId : timers[id].getChildIds()){
-      groupTime += getGroupTime(group, childId);
+      groupTime += getGroupTime(group, groupBit, childId);
    }
    return groupTime;
 }
          
-//Hash value identifying all labels, groups and workunitlabels.
-int TimerTree::getHash() const{
-   std::string hashString = getHashString(0); //starting from root, construct a
-                                         //string representing the tree.
-   std::hash< std::string> hasher;
-   int hashValue = (int)(hasher(hashString) % std::numeric_limits<int>::max());
-   // MPI_Comm_split needs a non-zero value
-   if (hashValue == 0) {
-      return 1;
-   } else {
-      return hashValue;
+//Hash value identifying all labels, groups and workunitlabels, and
+//the hierarchy. Kept up to date when timers are added or their
+//workunitlabels change.
+uint64_t TimerTree::getHash() const{
+   return timers[0].getHash();
+}
+
+//The hash of timer id has changed, oldContribution is what it
+//contributed to the hash of its parent before the change (0 for a new
+//timer). Propagates the change up to the root.
+void TimerTree::updateAncestorHashes(int id, uint64_t oldContribution){
+   while(timers[id].getParentId() >= 0){
+      const int parentId = timers[id].getParentId();
+      const uint64_t oldParentContribution = timers[parentId].getHashContribution();
+      timers[parentId].updateChildHash(oldContribution, timers[id].getHashContribution());
+      oldContribution = oldParentContribution;
+      id = parentId;
    }
 }
-std::string TimerTree::getHashString(int id) const{
-   std::string hashString;  
-   //add hash values from label, workunitlabel and groups. Everything has to match.
-   hashString = timers[id].getStringForHash();
-   //add hash values from descendants 
-   for(const auto& childId : timers[id].getChildIds() ){
-      hashString += getHashString(childId);
+
+//set a new workunitlabel, changes the hash of the tree
+void TimerTree::setWorkUnitLabel(int id, const std::string &workUnitLabel){
+#pragma omp critical(phiprof)
+   {
+      //another thread may have set it already
+      if(timers[id].getWorkUnitLabel() != workUnitLabel) {
+         const uint64_t oldContribution = timers[id].getHashContribution();
+         timers[id].setWorkUnitLabel(workUnitLabel);
+         updateAncestorHashes(id, oldContribution);
+         if(sharedCounters != NULL)
+            sharedCounters->setWorkUnitLabel(id, workUnitLabel);
+      }
    }
-   return hashString;
 }
 
 //get full hierarchical name for a timer
@@ -320,5 +375,43 @@ void TimerTree::shiftActiveStartTime(double shiftTime, int id){
    timers[id].shiftActiveStartTime(shiftTime);
 }
 
+//Add the running intervals of all active timers to their time and
+//to the child time of their parents, so that the counters are exact
+//at this time, e.g. at a phase boundary. Counts are not changed.
+void TimerTree::closeActiveIntervals(){
+   const double now = TimerData::getTime();
+   std::vector<double> intervals;
+   for(unsigned int id = 0; id < timers.size(); id++){
+      timers[id].closeActiveIntervals(now, intervals);
+      if(timers[id].getParentId() >= 0)
+         timers[timers[id].getParentId()].addChildTimes(intervals);
+   }
+}
 
-      
+//Publish the counters of all timers into shared memory, and of the
+//timers created later. NULL stops publishing. Called outside parallel
+//regions.
+void TimerTree::setSharedCounters(SharedCounters *counters){
+   sharedCounters = counters;
+   for(unsigned int id = 0; id < timers.size(); id++){
+      TimerData &timer = timers[id];
+      if(counters != NULL)
+         counters->addTimer(timer.getId(), timer.getParentId(), timer.getLevel(), timer.getLabel(),
+                            timer.getGroups(), timer.getWorkUnitLabel());
+      timer.setSharedCounters(counters);
+   }
+}
+
+//counters of all timers, indexed by id
+void TimerTree::getCounters(std::vector<TimerData::Counters> &counters) const{
+   counters.resize(timers.size());
+   for(unsigned int id = 0; id < timers.size(); id++)
+      timers[id].getCounters(counters[id]);
+}
+
+//timers created after the counters were taken are set to zero
+void TimerTree::setCounters(const std::vector<TimerData::Counters> &counters){
+   const TimerData::Counters zero;
+   for(unsigned int id = 0; id < timers.size(); id++)
+      timers[id].setCounters(id < counters.size() ? counters[id] : zero);
+}
@@ -23,6 +23,7 @@ License along with this library.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <string>
 #include "timerdata.hpp"
+#include "chunkedvector.hpp"
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -159,7 +160,7 @@ public:
       roctxRangePop();
 #endif
 
-      int newId = timers[id].stop();
+      int newId = addToParent(id, timers[id].stop());
       setCurrentId(newId);
 
       return true;
@@ -188,27 +189,58 @@ public:
    int initializeTimer(const std::string &label, const std::vector<std::string> &groups, std::string workUnit = "");
    void resetTime(double endPrintTime, int id=0);
    void shiftActiveStartTime(double shiftTime, int id = 0);
+   void closeActiveIntervals();
+   void getCounters(std::vector<TimerData::Counters> &counters) const;
+   void setCounters(const std::vector<TimerData::Counters> &counters);
+   void setSharedCounters(SharedCounters *counters);
    
 
    const TimerData& operator[](std::size_t id) const{
       return timers[id];
    }
    
+   int getCurrentId() const{
+      return currentId[thread];
+   }
+
+   int getCurrentId(int threadId) const{
+      return currentId[threadId];
+   }
+
+   int getNumThreads() const{
+      return currentId.size();
+   }
+
+   static bool isInitialized(){
+      return initialized;
+   }
+
    std::size_t size() const{
       return timers.size();
    }
    
    double getTime(int id) const;
+   void getExclusiveTimeStatistics(int id, double &ave, double &max, double &min, int &nThreads) const;
+   double getExclusiveTimeImbalance(int id) const;
    int getChildId(const std::string &label) const;
    double getGroupTime(std::string group, int id) const;
-   int getHash() const;
+   uint64_t getHash() const;
    std::string getFullLabel(int id,bool reverse=false) const;  
 
 
 
 protected:
-   std::string getHashString(int id) const;
-   
+   //add the time of a stopped interval of timer id to the child time
+   //of its parent, returns the parent id
+   int addToParent(int id, double interval){
+      const int parentId = timers[id].getParentId();
+      if(parentId >= 0)
+         timers[parentId].addChildTime(interval);
+      return parentId;
+   }
+   void updateAncestorHashes(int id, uint64_t oldContribution);
+   void setWorkUnitLabel(int id, const std::string &workUnitLabel);
+   double getGroupTime(const std::string &group, uint64_t groupBit, int id) const;
 
    static void setThreadCounts(){
 #ifdef _OPENMP
@@ -235,7 +267,8 @@ protected:
 #pragma omp threadprivate(thread)
 
    std::vector<int> currentId;
-   std::vector<TimerData> timers;
+   ChunkedVector<TimerData> timers; //indexed by id, timers never move
+   SharedCounters *sharedCounters = NULL; //live counters of all timers, NULL if not published
 
 };
 